@@ -0,0 +1,140 @@
+// Compares building a large completion dictionary at startup with mapping
+// one saved by trie_save(), and checks that the mapped trie answers
+// queries exactly like the one it was saved from.
+//
+//   g++ -O2 -I.. dict_bench.cpp ../trie.cpp -o dict_bench
+//   ./dict_bench [--words N]
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+
+#include "trie.h"
+
+#define QUERIES 100000
+
+static unsigned int rng = 12345u;
+
+static unsigned int next_rand() {
+    rng ^= rng << 13;
+    rng ^= rng >> 17;
+    rng ^= rng << 5;
+    return rng;
+}
+
+static const char* modules[] = {
+    "net", "gfx", "io", "mem", "str", "vec", "map", "ui", "db", "log",
+    "cfg", "sys", "fs", "http", "json", "xml", "audio", "input", "task", "sched"
+};
+static const char* verbs[] = {
+    "get", "set", "init", "free", "create", "destroy", "open", "close", "read",
+    "write", "find", "insert", "remove", "update", "parse", "format", "begin", "end"
+};
+static const char* nouns[] = {
+    "buffer", "handle", "context", "entry", "node", "state", "config", "stream",
+    "socket", "frame", "record", "cursor", "table", "queue", "event", "value"
+};
+
+#define COUNT(a) (sizeof(a) / sizeof((a)[0]))
+
+static void make_word(char* out, size_t size) {
+    snprintf(out, size, "%s_%s_%s%u", modules[next_rand() % COUNT(modules)],
+             verbs[next_rand() % COUNT(verbs)], nouns[next_rand() % COUNT(nouns)],
+             next_rand() % 2000);
+}
+
+static double now_ms() {
+    using namespace std::chrono;
+    return duration<double, std::milli>(steady_clock::now().time_since_epoch()).count();
+}
+
+int main(int argc, char** argv) {
+    int words = 500000;
+    for (int i = 1; i + 1 < argc; i++) {
+        if (strcmp(argv[i], "--words") == 0) words = atoi(argv[++i]);
+    }
+    const char* path = "dict_bench.dict";
+
+    char word[128];
+    double t0 = now_ms();
+    Trie* built = create_trie();
+    for (int i = 0; i < words; i++) {
+        make_word(word, sizeof(word));
+        trie_insert_weighted(built, word, next_rand() % 4);
+    }
+    double build_ms = now_ms() - t0;
+    printf("%u words, %u nodes\n", built->entry_count, built->node_count);
+    printf("build from words   %9.2f ms  %6.1f MB\n", build_ms, trie_memory(built) / 1048576.0);
+
+    t0 = now_ms();
+    if (trie_save(built, path) != 0) {
+        fprintf(stderr, "cannot write %s\n", path);
+        return 1;
+    }
+    printf("save               %9.2f ms\n", now_ms() - t0);
+
+    t0 = now_ms();
+    Trie* mapped = trie_map(path);
+    double map_ms = now_ms() - t0;
+    if (!mapped) {
+        fprintf(stderr, "cannot map %s\n", path);
+        return 1;
+    }
+    printf("map                %9.3f ms  %6.1f MB file\n", map_ms, mapped->mapping_size / 1048576.0);
+
+    // The first queries fault in the pages they touch.
+    TrieCursor a, b;
+    const char* got[TRIE_TOP_K];
+    const char* want[TRIE_TOP_K];
+    int mismatches = 0;
+    double first_ms = 0;
+    t0 = now_ms();
+    for (int q = 0; q < QUERIES; q++) {
+        make_word(word, sizeof(word));
+        int length = 1 + (int)(next_rand() % 12);
+        trie_cursor_reset(&a, mapped);
+        for (int i = 0; i < length && word[i]; i++) trie_cursor_push(&a, word[i]);
+        int n = trie_cursor_suggest(&a, got, TRIE_TOP_K);
+        if (q == 0) first_ms = now_ms() - t0;
+
+        trie_cursor_reset(&b, built);
+        for (int i = 0; i < length && word[i]; i++) trie_cursor_push(&b, word[i]);
+        int m = trie_cursor_suggest(&b, want, TRIE_TOP_K);
+        if (n != m) {
+            mismatches++;
+            continue;
+        }
+        for (int i = 0; i < n; i++) {
+            if (strcmp(got[i], want[i]) != 0) {
+                mismatches++;
+                break;
+            }
+        }
+    }
+    printf("first query        %9.3f ms\n", first_ms);
+    printf("%d queries          %s\n", QUERIES, mismatches ? "MISMATCH" : "same as built");
+
+    t0 = now_ms();
+    int ok = trie_verify(mapped) == 0;
+    printf("verify checksum    %9.2f ms  %s\n", now_ms() - t0, ok ? "ok" : "BAD");
+
+    // A flipped byte in the body must fail verification.
+    FILE* f = fopen(path, "r+b");
+    if (f) {
+        fseek(f, -1, SEEK_END);
+        int c = fgetc(f);
+        fseek(f, -1, SEEK_END);
+        fputc(c ^ 1, f);
+        fclose(f);
+        Trie* damaged = trie_map(path);
+        printf("damaged file       %s\n",
+               damaged && trie_verify(damaged) != 0 ? "rejected" : "NOT REJECTED");
+        free_trie(damaged);
+    }
+
+    free_trie(mapped);
+    free_trie(built);
+    remove(path);
+    return mismatches || !ok;
+}
@@ -0,0 +1,154 @@
+// Times fuzzy ranking over 10k, 100k and 1M identifiers with each filter
+// kernel and checks that all kernels rank the same matches.
+//
+//   g++ -O2 -I.. fuzzy_bench.cpp ../fuzzy.cpp -o fuzzy_bench
+//   ./fuzzy_bench [--queries N]
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+
+#include "fuzzy.h"
+
+#define MAX_SUGGESTIONS 15
+
+static unsigned int rng = 12345u;
+
+static unsigned int next_rand() {
+    rng ^= rng << 13;
+    rng ^= rng >> 17;
+    rng ^= rng << 5;
+    return rng;
+}
+
+static const char* modules[] = {
+    "net", "gfx", "io", "mem", "str", "vec", "map", "ui", "db", "log",
+    "cfg", "sys", "fs", "http", "json", "xml", "audio", "input", "task", "sched"
+};
+static const char* verbs[] = {
+    "get", "set", "init", "free", "create", "destroy", "open", "close", "read",
+    "write", "update", "find", "insert", "remove", "parse", "flush", "reset"
+};
+static const char* nouns[] = {
+    "buffer", "node", "entry", "handle", "context", "state", "config", "item",
+    "list", "table", "stream", "socket", "frame", "packet", "token", "window"
+};
+
+#define COUNT(a) (sizeof(a) / sizeof((a)[0]))
+
+static char** make_identifiers(int n) {
+    char** ids = (char**)malloc(n * sizeof(char*));
+    for (int i = 0; i < n; i++) {
+        char tmp[96];
+        const char* m = modules[next_rand() % COUNT(modules)];
+        const char* v = verbs[next_rand() % COUNT(verbs)];
+        const char* o = nouns[next_rand() % COUNT(nouns)];
+        switch (next_rand() % 3) {
+            case 0: snprintf(tmp, sizeof(tmp), "%s_%s_%s_%d", m, v, o, i); break;
+            case 1: snprintf(tmp, sizeof(tmp), "%s%c%s%c%s%x", m, v[0] - 32, v + 1,
+                             o[0] - 32, o + 1, i); break;
+            default: snprintf(tmp, sizeof(tmp), "%s_%s%d", v, o, i); break;
+        }
+        ids[i] = strdup(tmp);
+    }
+    return ids;
+}
+
+// Abbreviates a random identifier the way people type them: a few letters
+// picked left to right, lowercase.
+static char* make_query(char** ids, int n) {
+    const char* id = ids[next_rand() % n];
+    char tmp[FUZZY_MAX_QUERY + 1];
+    int len = 0;
+    int want = 2 + next_rand() % 4;
+    for (int i = 0; id[i] && len < want; i++) {
+        if (next_rand() % 3 == 0 || i == 0) {
+            char c = id[i];
+            tmp[len++] = (c >= 'A' && c <= 'Z') ? (char)(c + 32) : c;
+        }
+    }
+    tmp[len] = '\0';
+    return strdup(tmp);
+}
+
+static double now_ms() {
+    using namespace std::chrono;
+    return duration<double, std::milli>(steady_clock::now().time_since_epoch()).count();
+}
+
+static const char* kernel_names[] = {"scalar", "sse2", "avx2"};
+
+static void run(int n, int query_count) {
+    char** ids = make_identifiers(n);
+    FuzzyIndex* index = fuzzy_create();
+    for (int i = 0; i < n; i++) fuzzy_add(index, ids[i]);
+
+    char** queries = (char**)malloc(query_count * sizeof(char*));
+    for (int i = 0; i < query_count; i++) queries[i] = make_query(ids, n);
+
+    FuzzyMatch reference[MAX_SUGGESTIONS];
+    FuzzyMatch results[MAX_SUGGESTIONS];
+    int best = fuzzy_kernel();
+
+    for (int k = FUZZY_KERNEL_SCALAR; k <= best; k++) {
+        fuzzy_set_kernel(k);
+        double total = 0;
+        double worst = 0;
+        long hits = 0;
+        int mismatches = 0;
+        for (int q = 0; q < query_count; q++) {
+            double t0 = now_ms();
+            int count = fuzzy_match(index, queries[q], results, MAX_SUGGESTIONS);
+            double ms = now_ms() - t0;
+            total += ms;
+            if (ms > worst) worst = ms;
+            hits += count;
+
+            if (k == FUZZY_KERNEL_SCALAR) continue;
+            fuzzy_set_kernel(FUZZY_KERNEL_SCALAR);
+            int expected = fuzzy_match(index, queries[q], reference, MAX_SUGGESTIONS);
+            fuzzy_set_kernel(k);
+            if (expected != count) mismatches++;
+            for (int i = 0; i < count && i < expected; i++) {
+                if (reference[i].word != results[i].word) {
+                    mismatches++;
+                    break;
+                }
+            }
+        }
+        printf("%8d ids  %-6s  avg %7.3f ms  worst %7.3f ms  (%ld hits, %d mismatches)\n",
+               n, kernel_names[k], total / query_count, worst, hits, mismatches);
+    }
+    fuzzy_set_kernel(best);
+
+    fuzzy_free(index);
+    for (int i = 0; i < query_count; i++) free(queries[i]);
+    for (int i = 0; i < n; i++) free(ids[i]);
+    free(queries);
+    free(ids);
+}
+
+int main(int argc, char** argv) {
+    int query_count = 200;
+    for (int i = 1; i + 1 < argc; i++) {
+        if (strcmp(argv[i], "--queries") == 0) query_count = atoi(argv[++i]);
+    }
+
+    FuzzyMatch m[3];
+    FuzzyIndex* demo = fuzzy_create();
+    fuzzy_add(demo, "printf");
+    fuzzy_add(demo, "calloc");
+    fuzzy_add(demo, "sprintf");
+    fuzzy_add(demo, "profile_frame");
+    printf("prf ->");
+    for (int i = 0, n = fuzzy_match(demo, "prf", m, 3); i < n; i++) {
+        printf(" %s(%d)", m[i].word, m[i].score);
+    }
+    printf("\n");
+    fuzzy_free(demo);
+
+    int sizes[] = {10000, 100000, 1000000};
+    for (int i = 0; i < 3; i++) run(sizes[i], query_count);
+    return 0;
+}
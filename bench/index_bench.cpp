@@ -0,0 +1,75 @@
+// Indexes source trees with the symbol index twice: cold, with no cache,
+// and warm, with the cache the cold run wrote, which should lex nothing and
+// map the saved trie instead of merging.
+//
+//   ./index_bench [--threads N] [--query prefix] [dir ...]
+//
+// Without directories it indexes the system include directories.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+#include <thread>
+
+#include "pool.h"
+#include "symbol_index.h"
+#include "trie.h"
+
+#define MAX_DIRS 8
+
+static const char* dirs[MAX_DIRS];
+static int dir_count = 0;
+
+static int run(const char* label, const char* cache, int threads, const char* query) {
+    for (int i = 0; i < dir_count; i++) symbols_add_root(dirs[i], 1);
+    if (dir_count == 0) symbols_add_system_roots();
+    if (symbols_start(cache, threads) != 0) {
+        fprintf(stderr, "cannot start indexing\n");
+        return -1;
+    }
+
+    SymbolProgress p;
+    for (;;) {
+        symbols_progress(&p);
+        if (p.state == SYMBOLS_READY) break;
+        std::this_thread::sleep_for(std::chrono::milliseconds(2));
+    }
+    printf("%-8s %9.1f ms  %6u files  %6u lexed  %7u symbols  %6llu steals\n", label,
+           p.elapsed_ms, p.files_found, p.files_lexed, p.symbols, pool_steals());
+
+    if (query) {
+        TrieCursor cursor;
+        trie_cursor_reset(&cursor, symbols_trie());
+        for (const char* c = query; *c; c++) trie_cursor_push(&cursor, *c);
+        const char* words[TRIE_TOP_K];
+        int n = trie_cursor_suggest(&cursor, words, TRIE_TOP_K);
+        for (int i = 0; i < n; i++) printf("    %s\n", words[i]);
+    }
+    symbols_stop();
+    return 0;
+}
+
+int main(int argc, char** argv) {
+    int threads = 0;
+    const char* query = NULL;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc) {
+            threads = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--query") == 0 && i + 1 < argc) {
+            query = argv[++i];
+        } else if (dir_count < MAX_DIRS) {
+            dirs[dir_count++] = argv[i];
+        }
+    }
+    const char* cache = "index_bench.symbols";
+    const char* trie = "index_bench.symbols.trie";
+    remove(cache);
+    remove(trie);
+
+    if (run("cold", cache, threads, query) != 0) return 1;
+    if (run("warm", cache, threads, NULL) != 0) return 1;
+    remove(cache);
+    remove(trie);
+    return 0;
+}
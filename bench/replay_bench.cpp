@@ -0,0 +1,436 @@
+// Replays keystroke scripts through the editor with a headless screen and
+// reports per-key latency percentiles for editing, suggestions and
+// rendering. The built-in scripts type a 5k-line C file, lean on
+// completion for every statement, paste a large block, and move and type
+// along a 1 MB minified line with UTF-8 strings and tabs in it; --script
+// replays a file recorded with the editor's --record option instead.
+//
+// The document lives in a temporary directory so journaling runs as it
+// would for a real file. Background checks and builds are never started.
+//
+//   g++ -O2 -pthread -I.. replay_bench.cpp ../editor.cpp ../replay.cpp
+//       ../text_buffer.cpp ../trie.cpp ../input.cpp ../screen.cpp ../harvest.cpp
+//       ../fuzzy.cpp ../highlight.cpp ../job.cpp ../build_cache.cpp ../process.cpp
+//       ../check.cpp ../undo.cpp ../journal.cpp ../search.cpp ../profile.cpp
+//       ../dictionary.cpp ../pool.cpp ../symbol_index.cpp ../layout.cpp -o replay_bench
+//   ./replay_bench [--lines N] [--completions N] [--paste-lines N] [--long-line BYTES]
+//                  [--script keys.txt [--file start.c]] [--trace out.json]
+//                  [--dict words.dict]... [--index dir]
+//
+// Before the built-in scripts it checks that a script with UTF-8 text,
+// named keys and a paste reads back as written.
+//
+// --index runs the project symbol indexer over dir and the system headers
+// while the keys replay, to show what indexing costs the input thread.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+#include <unistd.h>
+
+#include "editor.h"
+#include "profile.h"
+#include "replay.h"
+
+// A terminal without bracketed paste hands a paste over in read-sized
+// chunks, each of which arrives as one KEY_PASTE, and the editor draws once
+// per chunk.
+#define PASTE_CHUNK 4096
+
+static unsigned int rng = 12345u;
+
+static unsigned int next_rand() {
+    rng ^= rng << 13;
+    rng ^= rng >> 17;
+    rng ^= rng << 5;
+    return rng;
+}
+
+typedef struct {
+    InputEvent* events;
+    unsigned char* render;
+    int count;
+    int capacity;
+    char* text;
+} Script;
+
+static void add_key(Script* s, int key, int ch, int render) {
+    if (s->count == s->capacity) {
+        s->capacity = s->capacity ? s->capacity * 2 : 4096;
+        s->events = (InputEvent*)realloc(s->events, s->capacity * sizeof(InputEvent));
+        s->render = (unsigned char*)realloc(s->render, s->capacity);
+    }
+    s->events[s->count].key = key;
+    s->events[s->count].ch = ch;
+    s->events[s->count].text = NULL;
+    s->events[s->count].length = 0;
+    s->render[s->count] = (unsigned char)render;
+    s->count++;
+}
+
+// text must outlive the script.
+static void add_paste(Script* s, const char* text, int length, int render) {
+    add_key(s, KEY_PASTE, 0, render);
+    s->events[s->count - 1].text = text;
+    s->events[s->count - 1].length = length;
+}
+
+static void add_text(Script* s, const char* text, int render) {
+    for (; *text; text++) {
+        if (*text == '\n') add_key(s, KEY_ENTER, 0, render);
+        else add_key(s, KEY_CHAR, (unsigned char)*text, render);
+    }
+}
+
+static void free_script(Script* s) {
+    free(s->events);
+    free(s->render);
+    free(s->text);
+    memset(s, 0, sizeof(*s));
+}
+
+// Every line ends in punctuation, so Enter never lands on an open
+// suggestion list and accepts it instead of breaking the line.
+static void make_line(int i, char* line, size_t size) {
+    int n = (int)(next_rand() % 1000);
+    switch (next_rand() % 10) {
+        case 0: snprintf(line, size, "static int step_%d(int x) {\n", i); break;
+        case 1: snprintf(line, size, "    if (x > %d) return x - %d;\n", n, n / 2); break;
+        case 2: snprintf(line, size, "    total += values[i] * scale_%d;\n", n % 50); break;
+        case 3: snprintf(line, size, "    printf(\"%%d items\\n\", count);\n"); break;
+        case 4: snprintf(line, size, "}\n"); break;
+        case 5: snprintf(line, size, "\n"); break;
+        case 6: snprintf(line, size, "// Resets frame %d.\n", n); break;
+        case 7: snprintf(line, size, "int value_%d = %d;\n", i, n); break;
+        case 8: snprintf(line, size, "    for (int i = 0; i < count_%d; i++) {\n", n % 20); break;
+        default: snprintf(line, size, "    memcpy(out, in, sizeof(header_%d));\n", n % 30); break;
+    }
+}
+
+static void typing_script(Script* s, int lines) {
+    char line[256];
+    for (int i = 0; i < lines; i++) {
+        make_line(i, line, sizeof(line));
+        add_text(s, line, 1);
+    }
+}
+
+// Declares identifiers for the harvester, then writes each statement by
+// typing a short prefix, sometimes backing up or moving through the list,
+// and accepting a suggestion with TAB.
+static void completion_script(Script* s, int statements) {
+    static const char* words[] = {
+        "printf", "malloc", "strlen", "sizeof", "memcpy", "return", "while",
+        "value_", "scale_", "count_", "header_", "frame_total", "frame_count"
+    };
+    int word_count = (int)(sizeof(words) / sizeof(words[0]));
+    char line[256];
+    for (int i = 0; i < 100; i++) {
+        snprintf(line, sizeof(line), "int value_%d, scale_%d, count_%d, header_%d;\n", i, i, i, i);
+        add_text(s, line, 1);
+    }
+    add_text(s, "int frame_total, frame_count;\n", 1);
+
+    for (int i = 0; i < statements; i++) {
+        const char* word = words[next_rand() % word_count];
+        int prefix = 2 + (int)(next_rand() % 3);
+        add_text(s, "    ", 1);
+        for (int c = 0; c < prefix && word[c]; c++) add_key(s, KEY_CHAR, word[c], 1);
+        if (i % 5 == 0) {
+            add_key(s, KEY_BACKSPACE, 0, 1);
+            add_key(s, KEY_CHAR, word[prefix - 1], 1);
+        }
+        for (int d = (int)(next_rand() % 3); d > 0; d--) add_key(s, KEY_DOWN, 0, 1);
+        add_key(s, KEY_TAB, 0, 1);
+        add_text(s, "(x);\n", 1);
+    }
+}
+
+static void paste_script(Script* s, int lines) {
+    char line[256];
+    size_t length = 0, capacity = 65536;
+    s->text = (char*)malloc(capacity);
+    for (int i = 0; i < lines && s->text; i++) {
+        make_line(i, line, sizeof(line));
+        size_t n = strlen(line);
+        if (length + n > capacity) {
+            capacity *= 2;
+            s->text = (char*)realloc(s->text, capacity);
+            if (!s->text) return;
+        }
+        memcpy(s->text + length, line, n);
+        length += n;
+    }
+    for (size_t at = 0; at < length; at += PASTE_CHUNK) {
+        size_t n = length - at < PASTE_CHUNK ? length - at : PASTE_CHUNK;
+        add_paste(s, s->text + at, (int)n, 1);
+    }
+}
+
+// One line of bytes bytes, then a short one to move to and from.
+static int write_long_line(const char* path, size_t bytes) {
+    static const char* pieces[] = {
+        "var a=function(b){return b+1};", "if(x>3){y=\"caf\xc3\xa9 \xe6\x97\xa5\xe6\x9c\xac\";}",
+        "\tz=[1,2,3];", "/* \xe2\x86\x92 */", "w.push(\"\xf0\x9f\x99\x82\");", "for(i=0;i<n;i++)s+=i;"
+    };
+    FILE* f = fopen(path, "wb");
+    if (!f) return -1;
+    size_t written = 0;
+    while (written < bytes) {
+        const char* p = pieces[next_rand() % (sizeof(pieces) / sizeof(pieces[0]))];
+        fputs(p, f);
+        written += strlen(p);
+    }
+    fputs("\nint tail;\n", f);
+    return fclose(f) == 0 ? 0 : -1;
+}
+
+// Runs along the long line with End, Home and the arrows, jumps to the
+// short line and back, and types and deletes at both ends of it.
+static void long_line_script(Script* s) {
+    add_key(s, KEY_END, 0, 1);
+    add_text(s, " x=1;", 1);
+    for (int i = 0; i < 50; i++) add_key(s, KEY_LEFT, 0, 1);
+    for (int i = 0; i < 10; i++) {
+        add_key(s, KEY_DOWN, 0, 1);
+        add_key(s, KEY_UP, 0, 1);
+    }
+    for (int i = 0; i < 20; i++) add_key(s, KEY_BACKSPACE, 0, 1);
+    add_key(s, KEY_HOME, 0, 1);
+    for (int i = 0; i < 2000; i++) add_key(s, KEY_RIGHT, 0, 1);
+    add_text(s, "q=2;", 1);
+    add_key(s, KEY_END, 0, 1);
+    add_key(s, KEY_HOME, 0, 1);
+}
+
+typedef struct {
+    double* values;
+    int count;
+} Samples;
+
+// Writes s the way --record does and reads it back, which must give the
+// same events. The script mixes UTF-8 text with named keys and a paste.
+static int check_round_trip(const char* dir) {
+    static const char paste[] = "x = \"\xc3\xa9t\xc3\xa9\";\n\tif (a < b) {}\n";
+    Script s = {NULL, NULL, 0, 0, NULL};
+    add_text(&s, "int caf\xc3\xa9 = 1; // \xe4\xb8\x96\xe7\x95\x8c \xf0\x9f\x99\x82 <>\n\t", 0);
+    add_key(&s, KEY_CHAR, 1, 0);
+    add_key(&s, KEY_HOME, 0, 0);
+    add_key(&s, KEY_F1, 0, 0);
+    add_paste(&s, paste, (int)strlen(paste), 0);
+    add_text(&s, "\xce\xbb", 0);
+
+    char path[1024];
+    snprintf(path, sizeof(path), "%s/round_trip.keys", dir);
+    FILE* f = fopen(path, "wb");
+    if (!f) {
+        free_script(&s);
+        return -1;
+    }
+    for (int i = 0; i < s.count; i++) replay_write(f, &s.events[i]);
+    fclose(f);
+
+    InputEvent* events;
+    int count = replay_load(path, &events);
+    remove(path);
+    int rc = count == s.count ? 0 : -1;
+    int first = -1;
+    for (int i = 0; rc == 0 && i < count; i++) {
+        const InputEvent* a = &s.events[i];
+        const InputEvent* b = &events[i];
+        if (a->key != b->key || a->ch != b->ch || a->length != b->length ||
+            (a->length > 0 && memcmp(a->text, b->text, a->length) != 0)) {
+            first = i;
+            rc = -1;
+        }
+    }
+    if (count < 0) {
+        fprintf(stderr, "round trip: cannot read %s\n", path);
+    } else if (count != s.count) {
+        fprintf(stderr, "round trip: %d events written, %d read\n", s.count, count);
+    } else if (rc != 0) {
+        fprintf(stderr, "round trip: event %d reads back differently\n", first);
+    } else {
+        printf("round trip: %d events\n", count);
+    }
+    if (count >= 0) free(events);
+    free_script(&s);
+    return rc;
+}
+
+static int compare_doubles(const void* a, const void* b) {
+    double x = *(const double*)a, y = *(const double*)b;
+    return (x > y) - (x < y);
+}
+
+static void report(const char* name, Samples* s) {
+    if (s->count == 0) {
+        printf("  %-8s no samples\n", name);
+        return;
+    }
+    qsort(s->values, s->count, sizeof(double), compare_doubles);
+    double sum = 0;
+    for (int i = 0; i < s->count; i++) sum += s->values[i];
+    printf("  %-8s p50 %8.4f ms  p99 %8.4f ms  max %8.3f ms  total %8.1f ms  (%d keys)\n", name,
+           s->values[(s->count - 1) / 2], s->values[(int)((s->count - 1) * 0.99)],
+           s->values[s->count - 1], sum, s->count);
+}
+
+static double now_ms() {
+    using namespace std::chrono;
+    return duration<double, std::milli>(steady_clock::now().time_since_epoch()).count();
+}
+
+static int copy_file(const char* from, const char* to) {
+    FILE* in = fopen(from, "rb");
+    if (!in) return -1;
+    FILE* out = fopen(to, "wb");
+    if (!out) {
+        fclose(in);
+        return -1;
+    }
+    char block[65536];
+    size_t n;
+    while ((n = fread(block, 1, sizeof(block), in)) > 0) fwrite(block, 1, n, out);
+    fclose(in);
+    return fclose(out) == 0 ? 0 : -1;
+}
+
+static const char* dictionaries[8];
+static int dictionary_count = 0;
+static const char* index_dir = NULL;
+
+static int replay(const char* name, const Script* script, const char* dir, const char* start) {
+    char document[1024];
+    snprintf(document, sizeof(document), "%s/replay.c", dir);
+    remove(document);
+    if (start && copy_file(start, document) != 0) {
+        fprintf(stderr, "cannot copy %s\n", start);
+        return -1;
+    }
+    for (int i = 0; i < dictionary_count; i++) {
+        if (editor_add_dictionary(dictionaries[i]) != 0) {
+            fprintf(stderr, "cannot map %s\n", dictionaries[i]);
+            return -1;
+        }
+    }
+    if (index_dir) editor_index_project(index_dir);
+    if (editor_open(document) != 0) {
+        fprintf(stderr, "cannot open %s\n", document);
+        return -1;
+    }
+
+    Samples edit = {(double*)malloc(script->count * sizeof(double) + 1), 0};
+    Samples suggest = {(double*)malloc(script->count * sizeof(double) + 1), 0};
+    Samples render = {(double*)malloc(script->count * sizeof(double) + 1), 0};
+    double t0 = now_ms();
+    editor_render();
+    int framing = 0;
+    for (int i = 0; i < script->count; i++) {
+        if (!framing) profile_frame_begin();
+        framing = 1;
+        int quit = editor_key(&script->events[i]) == EDITOR_QUIT;
+        if (key_timing.edit_ms > 0) edit.values[edit.count++] = key_timing.edit_ms;
+        if (key_timing.suggest_ms > 0) suggest.values[suggest.count++] = key_timing.suggest_ms;
+        if (quit) break;
+        if (script->render[i]) {
+            double r0 = now_ms();
+            editor_render();
+            render.values[render.count++] = now_ms() - r0;
+            profile_frame_end();
+            framing = 0;
+        }
+    }
+    double total = now_ms() - t0;
+    editor_close();
+    remove(document);
+
+    printf("%s: %d keys in %.1f ms\n", name, script->count, total);
+    report("edit", &edit);
+    report("suggest", &suggest);
+    report("render", &render);
+    free(edit.values);
+    free(suggest.values);
+    free(render.values);
+    return 0;
+}
+
+int main(int argc, char** argv) {
+    int lines = 5000;
+    int completions = 2000;
+    int paste_lines = 20000;
+    long long_line = 1 << 20;
+    const char* script_path = NULL;
+    const char* start = NULL;
+    const char* trace = NULL;
+    for (int i = 1; i + 1 < argc; i++) {
+        if (strcmp(argv[i], "--lines") == 0) lines = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--completions") == 0) completions = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--paste-lines") == 0) paste_lines = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--long-line") == 0) long_line = atol(argv[++i]);
+        else if (strcmp(argv[i], "--script") == 0) script_path = argv[++i];
+        else if (strcmp(argv[i], "--file") == 0) start = argv[++i];
+        else if (strcmp(argv[i], "--trace") == 0) trace = argv[++i];
+        else if (strcmp(argv[i], "--index") == 0) index_dir = argv[++i];
+        else if (strcmp(argv[i], "--dict") == 0 && dictionary_count < 8) {
+            dictionaries[dictionary_count++] = argv[++i];
+        }
+    }
+
+    char dir[] = "/tmp/replay_bench.XXXXXX";
+    if (!mkdtemp(dir)) {
+        perror("mkdtemp");
+        return 1;
+    }
+    profile_thread("replay");
+    if (screen_init(&screen, SCREEN_HEADLESS, 120, 30, "replay") != 0) return 1;
+
+    int rc = 0;
+    Script s = {NULL, NULL, 0, 0, NULL};
+    if (script_path) {
+        InputEvent* events;
+        int count = replay_load(script_path, &events);
+        if (count < 0) {
+            fprintf(stderr, "cannot read %s\n", script_path);
+            rc = 1;
+        } else {
+            for (int i = 0; i < count; i++) {
+                if (events[i].key == KEY_PASTE) add_paste(&s, events[i].text, events[i].length, 1);
+                else add_key(&s, events[i].key, events[i].ch, 1);
+            }
+            rc = replay(script_path, &s, dir, start) != 0;
+            free(events);
+        }
+        free_script(&s);
+    } else {
+        rc |= check_round_trip(dir) != 0;
+        typing_script(&s, lines);
+        rc |= replay("typing", &s, dir, NULL) != 0;
+        free_script(&s);
+        completion_script(&s, completions);
+        rc |= replay("completion", &s, dir, NULL) != 0;
+        free_script(&s);
+        paste_script(&s, paste_lines);
+        rc |= replay("paste", &s, dir, NULL) != 0;
+        free_script(&s);
+        char long_path[1024];
+        snprintf(long_path, sizeof(long_path), "%s/long_line.c", dir);
+        if (write_long_line(long_path, (size_t)long_line) == 0) {
+            long_line_script(&s);
+            rc |= replay("long line", &s, dir, long_path) != 0;
+            remove(long_path);
+        } else {
+            rc = 1;
+        }
+        free_script(&s);
+    }
+
+    if (trace && profile_write_trace(trace) != 0) {
+        fprintf(stderr, "cannot write %s\n", trace);
+        rc = 1;
+    }
+    screen_shutdown(&screen);
+    rmdir(dir);
+    return rc;
+}
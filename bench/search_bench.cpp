@@ -0,0 +1,159 @@
+// Times literal search over 100 MB of C-like text with each kernel against
+// a naive strstr loop, then regex search, and checks that all of them find
+// the same matches.
+//
+//   g++ -O2 -I.. search_bench.cpp ../search.cpp ../text_buffer.cpp -o search_bench
+//   ./search_bench [--mb N]
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+
+#include "search.h"
+
+static unsigned int rng = 12345u;
+
+static unsigned int next_rand() {
+    rng ^= rng << 13;
+    rng ^= rng >> 17;
+    rng ^= rng << 5;
+    return rng;
+}
+
+static const char* lines[] = {
+    "    for (int i = 0; i < count; i++) {\n",
+    "        total += values[i] * scale;\n",
+    "    }\n",
+    "    if (buffer == NULL) return -1;\n",
+    "static int parse_header(const char* text, size_t length) {\n",
+    "    memcpy(out, in, sizeof(Header));\n",
+    "    printf(\"%d items\\n\", count);\n",
+    "}\n",
+    "\n",
+    "// Resets the state before the next frame.\n",
+    "    state->frame_count = 0;\n",
+    "#include <stdio.h>\n"
+};
+
+#define COUNT(a) (sizeof(a) / sizeof((a)[0]))
+
+static char* make_text(size_t size) {
+    char* text = (char*)malloc(size + 1);
+    size_t used = 0;
+    while (used < size) {
+        const char* line = lines[next_rand() % COUNT(lines)];
+        size_t n = strlen(line);
+        if (used + n > size) n = size - used;
+        memcpy(text + used, line, n);
+        used += n;
+    }
+    text[size] = '\0';
+    return text;
+}
+
+static double now_ms() {
+    using namespace std::chrono;
+    return duration<double, std::milli>(steady_clock::now().time_since_epoch()).count();
+}
+
+typedef struct {
+    long count;
+    unsigned long long sum;
+} Tally;
+
+static int tally(size_t start, size_t end, void* ctx) {
+    Tally* t = (Tally*)ctx;
+    t->count++;
+    t->sum += start * 31 + end;
+    return 0;
+}
+
+static Tally naive(const char* text, const char* needle) {
+    Tally t = {0, 0};
+    size_t n = strlen(needle);
+    const char* p = text;
+    while ((p = strstr(p, needle)) != NULL) {
+        tally((size_t)(p - text), (size_t)(p - text) + n, &t);
+        p += n;
+    }
+    return t;
+}
+
+static const char* kernel_names[] = {"scalar", "sse2", "avx2"};
+
+static void run_literal(const char* text, size_t size, const TextBuffer* tb, const char* needle) {
+    double t0 = now_ms();
+    Tally expected = naive(text, needle);
+    printf("%-22s strstr  %8.2f ms  %ld matches\n", needle, now_ms() - t0, expected.count);
+
+    Search s;
+    search_compile(&s, needle, strlen(needle), SEARCH_LITERAL);
+    int best = search_kernel();
+    for (int k = SEARCH_KERNEL_SCALAR; k <= best; k++) {
+        search_set_kernel(k);
+        Tally t = {0, 0};
+        t0 = now_ms();
+        search_text(&s, text, size, tally, &t);
+        double ms = now_ms() - t0;
+        Tally b = {0, 0};
+        double t1 = now_ms();
+        search_buffer(&s, tb, tally, &b);
+        double buffer_ms = now_ms() - t1;
+        int same = t.count == expected.count && t.sum == expected.sum &&
+                   b.count == expected.count && b.sum == expected.sum;
+        printf("%-22s %-6s  %8.2f ms  buffer %8.2f ms  %s\n", "", kernel_names[k], ms,
+               buffer_ms, same ? "ok" : "MISMATCH");
+    }
+    search_set_kernel(best);
+    search_free(&s);
+}
+
+static void run_regex(const char* text, size_t size, const TextBuffer* tb, const char* pattern) {
+    Search s;
+    if (search_compile(&s, pattern, strlen(pattern), SEARCH_REGEX) != 0) {
+        printf("%-22s %s\n", pattern, s.error);
+        return;
+    }
+    Tally t = {0, 0};
+    double t0 = now_ms();
+    search_text(&s, text, size, tally, &t);
+    double ms = now_ms() - t0;
+    Tally b = {0, 0};
+    double t1 = now_ms();
+    search_buffer(&s, tb, tally, &b);
+    double buffer_ms = now_ms() - t1;
+    printf("%-22s regex   %8.2f ms  buffer %8.2f ms  %ld matches %s\n", pattern, ms, buffer_ms,
+           t.count, t.count == b.count && t.sum == b.sum ? "ok" : "MISMATCH");
+    search_free(&s);
+}
+
+int main(int argc, char** argv) {
+    size_t mb = 100;
+    for (int i = 1; i + 1 < argc; i++) {
+        if (strcmp(argv[i], "--mb") == 0) mb = (size_t)atoi(argv[++i]);
+    }
+    size_t size = mb * 1024 * 1024;
+    char* text = make_text(size);
+
+    // The same text as a buffer made of many pieces.
+    TextBuffer tb;
+    tb_init(&tb);
+    for (size_t at = 0; at < size; at += 1 << 20) {
+        size_t n = size - at < (1 << 20) ? size - at : 1 << 20;
+        tb_insert(&tb, at, text + at, n);
+    }
+    printf("%zu MB, %d lines\n\n", mb, tb_line_count(&tb));
+
+    const char* literals[] = {"frame_count", "memcpy(out", "x", "parse_header(const char*"};
+    for (size_t i = 0; i < COUNT(literals); i++) run_literal(text, size, &tb, literals[i]);
+    printf("\n");
+
+    const char* patterns[] = {"frame_count", "[a-z_]+\\(", "^static int", "values\\[i\\]|scale;$",
+                              "\\d+ items"};
+    for (size_t i = 0; i < COUNT(patterns); i++) run_regex(text, size, &tb, patterns[i]);
+
+    tb_free(&tb);
+    free(text);
+    return 0;
+}
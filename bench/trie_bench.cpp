@@ -0,0 +1,208 @@
+// Compares the compact radix trie against the original 256-pointer layout.
+//
+//   g++ -O2 -I.. trie_bench.cpp ../trie.cpp -o trie_bench
+//   ./trie_bench [--legacy-limit-mb N]
+//
+// The legacy trie is only built when its projected size fits the limit
+// (default 1024 MB); otherwise the projection is printed instead.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+
+#include "trie.h"
+
+#define ALPHABET_SIZE 256
+#define MAX_SUGGESTIONS 15
+#define QUERIES 200000
+
+typedef struct LegacyNode {
+    struct LegacyNode* children[ALPHABET_SIZE];
+    int is_end_of_word;
+} LegacyNode;
+
+static size_t legacy_nodes = 0;
+
+static LegacyNode* legacy_create() {
+    LegacyNode* node = (LegacyNode*)calloc(1, sizeof(LegacyNode));
+    if (node) legacy_nodes++;
+    return node;
+}
+
+static void legacy_insert(LegacyNode* root, const char* key) {
+    LegacyNode* current = root;
+    for (int i = 0; key[i]; i++) {
+        int index = (unsigned char)key[i];
+        if (!current->children[index]) {
+            current->children[index] = legacy_create();
+            if (!current->children[index]) return;
+        }
+        current = current->children[index];
+    }
+    current->is_end_of_word = 1;
+}
+
+static void legacy_free(LegacyNode* root) {
+    for (int i = 0; i < ALPHABET_SIZE; i++) {
+        if (root->children[i]) legacy_free(root->children[i]);
+    }
+    free(root);
+}
+
+static char legacy_results[MAX_SUGGESTIONS][512];
+static int legacy_count;
+
+static void legacy_walk(LegacyNode* node, char* buffer, int level) {
+    if (node->is_end_of_word && legacy_count < MAX_SUGGESTIONS) {
+        buffer[level] = '\0';
+        strcpy(legacy_results[legacy_count++], buffer);
+    }
+    for (int i = 0; i < ALPHABET_SIZE && legacy_count < MAX_SUGGESTIONS; i++) {
+        if (node->children[i]) {
+            buffer[level] = (char)i;
+            legacy_walk(node->children[i], buffer, level + 1);
+        }
+    }
+}
+
+static void legacy_complete(LegacyNode* root, const char* prefix) {
+    legacy_count = 0;
+    memset(legacy_results, 0, sizeof(legacy_results));
+    LegacyNode* node = root;
+    for (int i = 0; prefix[i]; i++) {
+        node = node->children[(unsigned char)prefix[i]];
+        if (!node) return;
+    }
+    char buffer[512];
+    strcpy(buffer, prefix);
+    legacy_walk(node, buffer, (int)strlen(prefix));
+}
+
+static char compact_results[MAX_SUGGESTIONS][512];
+static int compact_count;
+
+static int compact_collect(const char* word, void* ctx) {
+    (void)ctx;
+    strcpy(compact_results[compact_count++], word);
+    return compact_count >= MAX_SUGGESTIONS;
+}
+
+static unsigned int rng = 12345u;
+
+static unsigned int next_rand() {
+    rng ^= rng << 13;
+    rng ^= rng >> 17;
+    rng ^= rng << 5;
+    return rng;
+}
+
+static const char* modules[] = {
+    "net", "gfx", "io", "mem", "str", "vec", "map", "ui", "db", "log",
+    "cfg", "sys", "fs", "http", "json", "xml", "audio", "input", "task", "sched"
+};
+static const char* verbs[] = {
+    "get", "set", "init", "free", "create", "destroy", "open", "close", "read",
+    "write", "update", "find", "insert", "remove", "parse", "flush", "reset"
+};
+static const char* nouns[] = {
+    "buffer", "node", "entry", "handle", "context", "state", "config", "item",
+    "list", "table", "stream", "socket", "frame", "packet", "token", "window"
+};
+
+#define COUNT(a) (sizeof(a) / sizeof((a)[0]))
+
+static char** make_identifiers(int n) {
+    char** ids = (char**)malloc(n * sizeof(char*));
+    for (int i = 0; i < n; i++) {
+        char tmp[96];
+        const char* m = modules[next_rand() % COUNT(modules)];
+        const char* v = verbs[next_rand() % COUNT(verbs)];
+        const char* o = nouns[next_rand() % COUNT(nouns)];
+        switch (next_rand() % 3) {
+            case 0: snprintf(tmp, sizeof(tmp), "%s_%s_%s_%d", m, v, o, i); break;
+            case 1: snprintf(tmp, sizeof(tmp), "%s%c%s%c%s%x", m, v[0] - 32, v + 1,
+                             o[0] - 32, o + 1, i); break;
+            default: snprintf(tmp, sizeof(tmp), "%s_%s%d", v, o, i); break;
+        }
+        ids[i] = strdup(tmp);
+    }
+    return ids;
+}
+
+static double now_ms() {
+    using namespace std::chrono;
+    return duration<double, std::milli>(steady_clock::now().time_since_epoch()).count();
+}
+
+static void run(int n, double legacy_limit_mb) {
+    char** ids = make_identifiers(n);
+    char** queries = (char**)malloc(QUERIES * sizeof(char*));
+    for (int i = 0; i < QUERIES; i++) {
+        const char* id = ids[next_rand() % n];
+        size_t len = 1 + next_rand() % 5;
+        if (len > strlen(id)) len = strlen(id);
+        queries[i] = strndup(id, len);
+    }
+
+    double t0 = now_ms();
+    Trie* trie = create_trie();
+    for (int i = 0; i < n; i++) trie_insert(trie, ids[i]);
+    double build_ms = now_ms() - t0;
+
+    t0 = now_ms();
+    long total = 0;
+    for (int i = 0; i < QUERIES; i++) {
+        compact_count = 0;
+        trie_complete(trie, queries[i], compact_collect, NULL);
+        total += compact_count;
+    }
+    double lookup_ns = (now_ms() - t0) * 1e6 / QUERIES;
+
+    size_t prefixes = 1;
+    for (unsigned int i = 1; i < trie->node_count; i++) prefixes += trie->nodes[i].label_len;
+    double legacy_mb = prefixes * (double)sizeof(LegacyNode) / (1024.0 * 1024.0);
+
+    printf("%8d ids  compact: %4u KB nodes=%-8u build %8.1f ms  lookup %7.0f ns  (%ld hits)\n",
+           n, (unsigned)(trie_memory(trie) / 1024), trie->node_count, build_ms, lookup_ns, total);
+
+    if (legacy_mb > legacy_limit_mb) {
+        printf("%8d ids  legacy:  projected %.0f MB for %zu nodes, skipped\n", n, legacy_mb, prefixes);
+    } else {
+        legacy_nodes = 0;
+        t0 = now_ms();
+        LegacyNode* root = legacy_create();
+        for (int i = 0; i < n; i++) legacy_insert(root, ids[i]);
+        double legacy_build = now_ms() - t0;
+
+        t0 = now_ms();
+        long legacy_total = 0;
+        for (int i = 0; i < QUERIES; i++) {
+            legacy_complete(root, queries[i]);
+            legacy_total += legacy_count;
+        }
+        double legacy_lookup = (now_ms() - t0) * 1e6 / QUERIES;
+
+        printf("%8d ids  legacy:  %4.0f MB nodes=%-8zu build %8.1f ms  lookup %7.0f ns  (%ld hits)\n",
+               n, legacy_nodes * (double)sizeof(LegacyNode) / (1024.0 * 1024.0), legacy_nodes,
+               legacy_build, legacy_lookup, legacy_total);
+        legacy_free(root);
+    }
+
+    free_trie(trie);
+    for (int i = 0; i < QUERIES; i++) free(queries[i]);
+    for (int i = 0; i < n; i++) free(ids[i]);
+    free(queries);
+    free(ids);
+}
+
+int main(int argc, char** argv) {
+    double legacy_limit_mb = 1024;
+    for (int i = 1; i + 1 < argc; i++) {
+        if (strcmp(argv[i], "--legacy-limit-mb") == 0) legacy_limit_mb = atof(argv[++i]);
+    }
+
+    int sizes[] = {10000, 100000, 1000000};
+    for (int i = 0; i < 3; i++) run(sizes[i], legacy_limit_mb);
+    return 0;
+}
@@ -0,0 +1,138 @@
+#include "build_cache.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#ifdef _WIN32
+#include <direct.h>
+#define CACHE_EXT ".exe"
+#else
+#include <sys/stat.h>
+#define CACHE_EXT ""
+#endif
+
+#define CACHE_READ_BLOCK 65536
+
+static void index_path(char* out, size_t out_size) {
+    snprintf(out, out_size, "%s/index", CACHE_DIR);
+}
+
+static void save_index(const BuildCache* c) {
+    char path[64];
+    index_path(path, sizeof(path));
+    FILE* f = fopen(path, "w");
+    if (!f) return;
+    for (int i = 0; i < c->count; i++) {
+        fprintf(f, "%016llx %llu %.0f\n", c->entries[i].key,
+                c->entries[i].last_used, c->entries[i].build_ms);
+    }
+    fclose(f);
+}
+
+int cache_init(BuildCache* c) {
+    memset(c, 0, sizeof(*c));
+#ifdef _WIN32
+    _mkdir(CACHE_DIR);
+#else
+    mkdir(CACHE_DIR, 0755);
+#endif
+
+    char path[64];
+    index_path(path, sizeof(path));
+    FILE* f = fopen(path, "r");
+    if (!f) return 0;
+    CacheEntry e;
+    while (c->count < CACHE_MAX_ENTRIES &&
+           fscanf(f, "%llx %llu %lf", &e.key, &e.last_used, &e.build_ms) == 3) {
+        c->entries[c->count++] = e;
+        if (e.last_used > c->tick) c->tick = e.last_used;
+    }
+    fclose(f);
+    return 0;
+}
+
+// FNV-1a over the command, a separator and the text.
+static unsigned long long hash_string(unsigned long long h, const char* s) {
+    for (; *s; s++) {
+        h ^= (unsigned char)*s;
+        h *= 1099511628211ull;
+    }
+    return h * 1099511628211ull;
+}
+
+unsigned long long cache_key(const TextBuffer* tb, const char* path, const char* command) {
+    unsigned long long h = 14695981039346656037ull;
+    h = hash_string(h, command);
+    h = hash_string(h, path);
+
+    char block[CACHE_READ_BLOCK];
+    size_t length = tb_length(tb);
+    for (size_t offset = 0; offset < length; ) {
+        size_t n = tb_read(tb, offset, CACHE_READ_BLOCK, block);
+        if (n == 0) break;
+        for (size_t i = 0; i < n; i++) {
+            h ^= (unsigned char)block[i];
+            h *= 1099511628211ull;
+        }
+        offset += n;
+    }
+    return h;
+}
+
+void cache_path(unsigned long long key, char* out, size_t out_size) {
+    snprintf(out, out_size, "%s/%016llx%s", CACHE_DIR, key, CACHE_EXT);
+}
+
+static int find(const BuildCache* c, unsigned long long key) {
+    for (int i = 0; i < c->count; i++) {
+        if (c->entries[i].key == key) return i;
+    }
+    return -1;
+}
+
+static void remove_entry(BuildCache* c, int i) {
+    c->entries[i] = c->entries[--c->count];
+}
+
+int cache_lookup(BuildCache* c, unsigned long long key) {
+    int i = find(c, key);
+    if (i >= 0) {
+        // The executable may have been deleted behind our back.
+        char path[64];
+        cache_path(key, path, sizeof(path));
+        FILE* f = fopen(path, "rb");
+        if (f) {
+            fclose(f);
+            c->entries[i].last_used = ++c->tick;
+            c->hits++;
+            c->saved_ms += c->entries[i].build_ms;
+            save_index(c);
+            return 1;
+        }
+        remove_entry(c, i);
+        save_index(c);
+    }
+    c->misses++;
+    return 0;
+}
+
+void cache_store(BuildCache* c, unsigned long long key, double build_ms) {
+    int i = find(c, key);
+    if (i < 0) {
+        if (c->count == CACHE_MAX_ENTRIES) {
+            int oldest = 0;
+            for (int j = 1; j < c->count; j++) {
+                if (c->entries[j].last_used < c->entries[oldest].last_used) oldest = j;
+            }
+            char path[64];
+            cache_path(c->entries[oldest].key, path, sizeof(path));
+            remove(path);
+            remove_entry(c, oldest);
+        }
+        i = c->count++;
+        c->entries[i].key = key;
+    }
+    c->entries[i].last_used = ++c->tick;
+    c->entries[i].build_ms = build_ms;
+    save_index(c);
+}
@@ -0,0 +1,44 @@
+#ifndef BUILD_CACHE_H
+#define BUILD_CACHE_H
+
+#include <stddef.h>
+
+#include "text_buffer.h"
+
+// Executables built from earlier buffers, named by a hash of the source text,
+// its path and the compiler command; the path matters because quoted
+// includes are looked up next to the source. The index survives restarts in
+// CACHE_DIR/index; past CACHE_MAX_ENTRIES the least recently run executable
+// is deleted.
+
+#define CACHE_DIR ".mintmind-cache"
+#define CACHE_MAX_ENTRIES 16
+
+typedef struct {
+    unsigned long long key;
+    unsigned long long last_used;
+    double build_ms;
+} CacheEntry;
+
+typedef struct {
+    CacheEntry entries[CACHE_MAX_ENTRIES];
+    int count;
+    unsigned long long tick;
+    int hits;
+    int misses;
+    double saved_ms;
+} BuildCache;
+
+int cache_init(BuildCache* c);
+
+unsigned long long cache_key(const TextBuffer* tb, const char* path, const char* command);
+void cache_path(unsigned long long key, char* out, size_t out_size);
+
+// Returns 1 and marks the entry used when key was built before, 0 otherwise.
+// Counts a hit or a miss either way.
+int cache_lookup(BuildCache* c, unsigned long long key);
+
+// Records that key was just built into cache_path(key).
+void cache_store(BuildCache* c, unsigned long long key, double build_ms);
+
+#endif
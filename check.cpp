@@ -0,0 +1,328 @@
+#include "check.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+#include "build_cache.h"
+#include "input.h"
+#include "job.h"
+#include "process.h"
+
+#define CHECK_SOURCE CACHE_DIR "/check.c"
+#define CHECK_OUTPUT_LIMIT (256 * 1024)
+#define CHECK_PATH_MAX 1024
+
+typedef std::chrono::steady_clock Clock;
+
+// Piece of the buffer as it was when the check was queued. Chunk text never
+// moves or changes once written, so the worker can read it while the
+// editor goes on editing.
+typedef struct {
+    const char* text;
+    size_t length;
+} CheckSpan;
+
+typedef struct {
+    CheckSpan* spans;
+    int count;
+    int capacity;
+} CheckSnapshot;
+
+static std::mutex check_mutex;
+static std::condition_variable check_ready;
+static std::thread worker;
+static int running = 0;
+static int stopping = 0;
+static std::atomic<unsigned int> version(0);
+
+// The check file lives in CACHE_DIR, so quoted includes are looked up in the
+// document's own directory instead.
+static char document_dir[CHECK_PATH_MAX];
+
+// Guarded by check_mutex. generation counts edits; a check whose snapshot
+// is older than the current generation is stale.
+static unsigned int generation = 0;
+static int waiting = 0;
+static Clock::time_point edited_at;
+static CheckSnapshot* pending = NULL;
+static unsigned int pending_generation = 0;
+static Clock::time_point pending_edited;
+static Process child;
+static Diagnostic results[CHECK_MAX_DIAGNOSTICS];
+static int result_count = 0;
+static Clock::time_point result_edited;
+static unsigned int measured_version = 0;
+static double latency_ms = -1;
+
+// Worker-private.
+static Diagnostic parsed[CHECK_MAX_DIAGNOSTICS];
+static int parsed_count = 0;
+
+static double elapsed_ms(Clock::time_point since) {
+    return std::chrono::duration<double, std::milli>(Clock::now() - since).count();
+}
+
+// Parses "check.c:LINE[:COLUMN]: error|warning: message". Notes and
+// context lines are skipped.
+static void parse_line(const char* line) {
+    size_t prefix = strlen(CHECK_SOURCE);
+    if (strncmp(line, CHECK_SOURCE, prefix) != 0 || line[prefix] != ':') return;
+    if (parsed_count == CHECK_MAX_DIAGNOSTICS) return;
+
+    char* end;
+    const char* p = line + prefix + 1;
+    long number = strtol(p, &end, 10);
+    if (end == p || *end != ':') return;
+    long column = 0;
+    p = end + 1;
+    if (*p >= '0' && *p <= '9') {
+        column = strtol(p, &end, 10);
+        if (*end != ':') return;
+        p = end + 1;
+    }
+    while (*p == ' ') p++;
+
+    int severity;
+    if (strncmp(p, "error:", 6) == 0) {
+        severity = CHECK_ERROR;
+        p += 6;
+    } else if (strncmp(p, "fatal error:", 12) == 0) {
+        severity = CHECK_ERROR;
+        p += 12;
+    } else if (strncmp(p, "warning:", 8) == 0) {
+        severity = CHECK_WARNING;
+        p += 8;
+    } else {
+        return;
+    }
+    while (*p == ' ') p++;
+
+    Diagnostic* d = &parsed[parsed_count++];
+    d->line = number > 0 ? (int)number - 1 : 0;
+    d->column = column > 0 ? (int)column - 1 : 0;
+    d->severity = severity;
+
+    // gcc quotes with U+2018/U+2019 outside the C locale; the screen is ASCII.
+    size_t n = 0;
+    while (*p && n < sizeof(d->message) - 1) {
+        if ((unsigned char)p[0] == 0xE2 && (unsigned char)p[1] == 0x80 &&
+            ((unsigned char)p[2] == 0x98 || (unsigned char)p[2] == 0x99)) {
+            d->message[n++] = '\'';
+            p += 3;
+        } else {
+            d->message[n++] = *p++;
+        }
+    }
+    d->message[n] = '\0';
+}
+
+static void parse(char* output, size_t length) {
+    parsed_count = 0;
+    size_t start = 0;
+    for (size_t i = 0; i <= length; i++) {
+        if (i == length || output[i] == '\n') {
+            output[i] = '\0';
+            if (i > start && output[i - 1] == '\r') output[i - 1] = '\0';
+            parse_line(output + start);
+            start = i + 1;
+        }
+    }
+}
+
+static void free_snapshot(CheckSnapshot* snapshot) {
+    if (!snapshot) return;
+    free(snapshot->spans);
+    free(snapshot);
+}
+
+static void run_check(const CheckSnapshot* snapshot, unsigned int gen, Clock::time_point edited) {
+    FILE* f = fopen(CHECK_SOURCE, "wb");
+    if (!f) return;
+    int failed = 0;
+    for (int i = 0; i < snapshot->count; i++) {
+        const CheckSpan* span = &snapshot->spans[i];
+        if (fwrite(span->text, 1, span->length, f) != span->length) failed = 1;
+    }
+    if (fclose(f) != 0 || failed) return;
+
+    const char* argv[] = {JOB_COMPILER, "-fsyntax-only", "-iquote", document_dir, "-I.",
+                          CHECK_SOURCE, NULL};
+    ProcessStream err;
+    {
+        std::lock_guard<std::mutex> lock(check_mutex);
+        if (gen != generation || process_spawn(&child, argv, NULL, &err) != 0) return;
+    }
+
+    // Output past the limit is drained but dropped.
+    char* output = (char*)malloc(CHECK_OUTPUT_LIMIT + 1);
+    size_t used = 0;
+    char buf[4096];
+    int n;
+    while ((n = process_read(err, buf, sizeof(buf))) > 0) {
+        if (output && used < CHECK_OUTPUT_LIMIT) {
+            size_t take = (size_t)n < CHECK_OUTPUT_LIMIT - used ? (size_t)n : CHECK_OUTPUT_LIMIT - used;
+            memcpy(output + used, buf, take);
+            used += take;
+        }
+    }
+    process_close(err);
+    process_wait(&child);
+    {
+        std::lock_guard<std::mutex> lock(check_mutex);
+        process_reap(&child);
+        process_release(&child);
+    }
+    if (!output) return;
+
+    parse(output, used);
+    free(output);
+
+    {
+        std::lock_guard<std::mutex> lock(check_mutex);
+        if (gen != generation) return;
+        memcpy(results, parsed, parsed_count * sizeof(Diagnostic));
+        result_count = parsed_count;
+        result_edited = edited;
+        version++;
+    }
+    input_wake();
+}
+
+static void check_main() {
+    std::unique_lock<std::mutex> lock(check_mutex);
+    for (;;) {
+        while (!pending && !stopping) check_ready.wait(lock);
+        if (stopping) break;
+
+        CheckSnapshot* snapshot = pending;
+        unsigned int gen = pending_generation;
+        Clock::time_point edited = pending_edited;
+        pending = NULL;
+        lock.unlock();
+
+        run_check(snapshot, gen, edited);
+        free_snapshot(snapshot);
+
+        lock.lock();
+    }
+}
+
+int check_start(const char* document) {
+    if (running) return 0;
+    const char* slash = strrchr(document, '/');
+#ifdef _WIN32
+    const char* backslash = strrchr(document, '\\');
+    if (backslash && (!slash || backslash > slash)) slash = backslash;
+#endif
+    size_t length = slash ? (size_t)(slash - document) : 0;
+    if (length >= sizeof(document_dir)) return -1;
+    if (slash && length == 0) length = 1;
+    if (length == 0) {
+        strcpy(document_dir, ".");
+    } else {
+        memcpy(document_dir, document, length);
+        document_dir[length] = '\0';
+    }
+    stopping = 0;
+    worker = std::thread(check_main);
+    running = 1;
+    return 0;
+}
+
+void check_stop() {
+    if (!running) return;
+    {
+        std::lock_guard<std::mutex> lock(check_mutex);
+        stopping = 1;
+        process_kill(&child);
+    }
+    check_ready.notify_one();
+    worker.join();
+    running = 0;
+
+    free_snapshot(pending);
+    pending = NULL;
+    waiting = 0;
+}
+
+void check_edit() {
+    std::lock_guard<std::mutex> lock(check_mutex);
+    generation++;
+    waiting = 1;
+    edited_at = Clock::now();
+    free_snapshot(pending);
+    pending = NULL;
+    process_kill(&child);
+}
+
+int check_due_in() {
+    std::lock_guard<std::mutex> lock(check_mutex);
+    if (!waiting) return -1;
+    double left = CHECK_DEBOUNCE_MS - elapsed_ms(edited_at);
+    return left > 0 ? (int)left + 1 : 0;
+}
+
+static int add_span(const char* text, size_t length, void* ctx) {
+    CheckSnapshot* snapshot = (CheckSnapshot*)ctx;
+    if (snapshot->count == snapshot->capacity) {
+        int cap = snapshot->capacity ? snapshot->capacity * 2 : 64;
+        CheckSpan* grown = (CheckSpan*)realloc(snapshot->spans, cap * sizeof(CheckSpan));
+        if (!grown) return -1;
+        snapshot->spans = grown;
+        snapshot->capacity = cap;
+    }
+    snapshot->spans[snapshot->count].text = text;
+    snapshot->spans[snapshot->count].length = length;
+    snapshot->count++;
+    return 0;
+}
+
+// Costs one span per piece, whatever the size of the text.
+void check_poll(const TextBuffer* tb) {
+    if (!running || !tb_is_complete(tb) || check_due_in() != 0) return;
+
+    CheckSnapshot* snapshot = (CheckSnapshot*)calloc(1, sizeof(CheckSnapshot));
+    if (!snapshot) return;
+    if (tb_for_each_span(tb, 0, tb_length(tb), add_span, snapshot) != 0) {
+        free_snapshot(snapshot);
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(check_mutex);
+        waiting = 0;
+        free_snapshot(pending);
+        pending = snapshot;
+        pending_generation = generation;
+        pending_edited = edited_at;
+    }
+    check_ready.notify_one();
+}
+
+int check_diagnostics(Diagnostic* out, int max) {
+    std::lock_guard<std::mutex> lock(check_mutex);
+    unsigned int v = version.load();
+    if (v != measured_version) {
+        measured_version = v;
+        latency_ms = elapsed_ms(result_edited);
+    }
+    int count = result_count < max ? result_count : max;
+    memcpy(out, results, count * sizeof(Diagnostic));
+    return count;
+}
+
+double check_latency() {
+    std::lock_guard<std::mutex> lock(check_mutex);
+    return latency_ms;
+}
+
+unsigned int check_version() {
+    return version.load();
+}
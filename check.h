@@ -0,0 +1,54 @@
+#ifndef CHECK_H
+#define CHECK_H
+
+#include "text_buffer.h"
+
+// Background syntax checking. Every edit restarts a debounce timer and
+// kills a check of older text still running. Once the timer expires the
+// pieces of the buffer are recorded, and a worker thread writes them out and
+// runs the compiler over the file with -fsyntax-only, one check at a time,
+// and publishes the parsed diagnostics unless the text changed again
+// meanwhile.
+
+#define CHECK_DEBOUNCE_MS 400
+#define CHECK_MAX_DIAGNOSTICS 256
+#define CHECK_MESSAGE_MAX 160
+
+enum {
+    CHECK_ERROR,
+    CHECK_WARNING
+};
+
+typedef struct {
+    int line;
+    int column;
+    int severity;
+    char message[CHECK_MESSAGE_MAX];
+} Diagnostic;
+
+// Quoted includes of the check resolve next to document, as in its build.
+int check_start(const char* document);
+void check_stop();
+
+// Reports that the buffer changed.
+void check_edit();
+
+// Milliseconds until the next check is due, -1 when none is waiting.
+int check_due_in();
+
+// Starts the check on the current pieces of tb once it is due. The worker
+// reads tb's chunk text, so tb must outlive check_stop().
+void check_poll(const TextBuffer* tb);
+
+// Copies the diagnostics of the latest published check and returns their
+// count. The first copy of a check measures its latency.
+int check_diagnostics(Diagnostic* out, int max);
+
+// Milliseconds from the last edit to its diagnostics being read, -1 before
+// the first check.
+double check_latency();
+
+// Changes whenever new diagnostics are published.
+unsigned int check_version();
+
+#endif
@@ -0,0 +1,70 @@
+#include "dictionary.h"
+
+#include <atomic>
+#include <thread>
+
+#include "input.h"
+
+static Trie* tries[DICTIONARY_MAX];
+static std::atomic<int> states[DICTIONARY_MAX];
+static std::atomic<unsigned int> version(0);
+static int count = 0;
+static std::thread worker;
+static int running = 0;
+static std::atomic<int> stopping(0);
+
+static void verify_main() {
+    for (int i = 0; i < count && !stopping.load(); i++) {
+        int state = trie_verify(tries[i]) == 0 ? DICTIONARY_READY : DICTIONARY_BAD;
+        states[i].store(state, std::memory_order_release);
+        version.fetch_add(1);
+        input_wake();
+    }
+}
+
+int dictionary_add(const char* path) {
+    if (running || count == DICTIONARY_MAX) return -1;
+    Trie* trie = trie_map(path);
+    if (!trie) return -1;
+    tries[count] = trie;
+    states[count].store(DICTIONARY_PENDING);
+    count++;
+    return 0;
+}
+
+void dictionary_start() {
+    if (running || count == 0) return;
+    stopping = 0;
+    worker = std::thread(verify_main);
+    running = 1;
+}
+
+void dictionary_stop() {
+    if (running) {
+        stopping = 1;
+        worker.join();
+        running = 0;
+    }
+    for (int i = 0; i < count; i++) {
+        free_trie(tries[i]);
+        tries[i] = NULL;
+    }
+    count = 0;
+    version.fetch_add(1);
+}
+
+int dictionary_count() {
+    return count;
+}
+
+int dictionary_state(int i) {
+    return states[i].load(std::memory_order_acquire);
+}
+
+Trie* dictionary_trie(int i) {
+    return dictionary_state(i) == DICTIONARY_READY ? tries[i] : NULL;
+}
+
+unsigned int dictionary_version() {
+    return version.load();
+}
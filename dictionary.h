@@ -0,0 +1,36 @@
+#ifndef DICTIONARY_H
+#define DICTIONARY_H
+
+#include "trie.h"
+
+// Completion dictionaries compiled by tools/dictc. Each is mapped at once
+// with only its header checked, then a worker thread checksums the bodies
+// one by one; a dictionary is offered for completion only after its body
+// checked out, so startup never waits for the whole file to be read.
+
+#define DICTIONARY_MAX 8
+
+enum {
+    DICTIONARY_PENDING,
+    DICTIONARY_READY,
+    DICTIONARY_BAD
+};
+
+// Returns -1 when the file can't be mapped or its header is wrong.
+int dictionary_add(const char* path);
+
+void dictionary_start();
+
+// Unmaps every dictionary.
+void dictionary_stop();
+
+int dictionary_count();
+int dictionary_state(int i);
+
+// NULL until the dictionary is ready.
+Trie* dictionary_trie(int i);
+
+// Changes whenever a dictionary becomes ready or bad.
+unsigned int dictionary_version();
+
+#endif
@@ -0,0 +1,1489 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <chrono>
+
+#ifdef _WIN32
+#include <windows.h>
+#endif
+
+#include "build_cache.h"
+#include "check.h"
+#include "dictionary.h"
+#include "editor.h"
+#include "fuzzy.h"
+#include "harvest.h"
+#include "highlight.h"
+#include "job.h"
+#include "input.h"
+#include "journal.h"
+#include "layout.h"
+#include "profile.h"
+#include "screen.h"
+#include "search.h"
+#include "symbol_index.h"
+#include "text_buffer.h"
+#include "trie.h"
+#include "undo.h"
+
+#define MAX_SUGGESTIONS 15
+#define MAX_CODE_SIZE 16384
+#define MAX_LINE_SIZE 512
+#define IDLE_TIMEOUT_MS 500
+#define FUZZY_MIN_QUERY 2
+#define OUTPUT_ROWS 9
+// Bytes lexed past the right edge, so a name there still sees its '('.
+#define VIEW_LOOKAHEAD 64
+#define UNDO_BUDGET (8 * 1024 * 1024)
+#define CTRL_F 6
+#define CTRL_R 18
+#define CTRL_Y 25
+#define CTRL_Z 26
+#define PROFILE_TRACE_PATH "profile.json"
+#define SYMBOLS_CACHE_PATH CACHE_DIR "/symbols"
+
+enum {
+    FIND_OFF,
+    FIND_QUERY,
+    FIND_REPLACE
+};
+
+TextBuffer text;
+const char* file_path = NULL;
+const char* document_path = "program.c";
+int recovered = 0;
+int current_line = 0;
+int cursor_pos = 0;
+Trie* knowledge_base;
+FuzzyIndex* knowledge_fuzzy;
+int show_suggestions = 0;
+const char* suggestions[MAX_SUGGESTIONS];
+int suggestion_count = 0;
+int selected_suggestion = -1;
+TrieCursor completion;
+TrieCursor harvested;
+TrieCursor dictionary_cursors[DICTIONARY_MAX];
+unsigned int dictionaries_version = 0;
+TrieCursor project_symbols;
+unsigned int project_symbols_version = 0;
+int index_project = 0;
+SymbolProgress shown_progress;
+const HarvestSnapshot* harvest_view = NULL;
+unsigned int harvested_version = 0;
+size_t harvested_indexed = 0;
+int completion_line = -1;
+int completion_start = 0;
+
+Screen screen;
+Highlighter highlight;
+LayoutCache layout;
+size_t scroll_column = 0;
+char* view_text = NULL;
+unsigned char* view_classes = NULL;
+unsigned short* view_attrs = NULL;
+size_t view_capacity = 0;
+UndoLog undo_log;
+int show_output = 0;
+int output_scroll = -1;
+unsigned int shown_job_version = 0;
+BuildCache build_cache;
+unsigned long long pending_build = 0;
+int build_pending = 0;
+Diagnostic diagnostics[CHECK_MAX_DIAGNOSTICS];
+int diagnostic_count = 0;
+unsigned int shown_check_version = 0;
+int find_mode = FIND_OFF;
+int find_regex = 0;
+char find_query[SEARCH_MAX_PATTERN + 1];
+int find_length = 0;
+char replace_text[MAX_LINE_SIZE];
+int replace_length = 0;
+Search find;
+SearchResults find_results;
+int find_current = -1;
+size_t find_origin = 0;
+double find_ms = 0;
+int show_help = 0;
+EditorTiming key_timing;
+int show_profile = 0;
+int trace_written = 0;
+
+typedef std::chrono::steady_clock Clock;
+
+// Indexed by HL_* class.
+const unsigned short hl_colors[] = {
+    ATTR_FG_RED | ATTR_FG_GREEN | ATTR_FG_BLUE,
+    ATTR_FG_RED | ATTR_FG_GREEN | ATTR_FG_INTENSITY,
+    ATTR_FG_GREEN | ATTR_FG_BLUE | ATTR_FG_INTENSITY,
+    ATTR_FG_BLUE | ATTR_FG_INTENSITY,
+    ATTR_FG_GREEN | ATTR_FG_INTENSITY,
+    ATTR_FG_RED | ATTR_FG_BLUE | ATTR_FG_INTENSITY,
+    ATTR_FG_RED | ATTR_FG_INTENSITY,
+    ATTR_FG_GREEN
+};
+
+double ms_since(Clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+void clear_buffer() {
+    screen_clear(&screen);
+}
+
+void write_buffer() {
+    screen_present(&screen);
+}
+
+void set_buffer_char(int x, int y, char c, unsigned short attr) {
+    screen_put(&screen, x, y, (unsigned char)c, attr);
+}
+
+void set_buffer_text(int x, int y, const char* text, unsigned short attr) {
+    screen_text(&screen, x, y, text, attr);
+}
+
+int add_suggestion(int count, const char* word, const char* prefix) {
+    // The word being typed is itself harvested; offering it back is noise.
+    if (strcmp(word, prefix) == 0) return count;
+    for (int j = 0; j < count; j++) {
+        if (strcmp(suggestions[j], word) == 0) return count;
+    }
+    suggestions[count++] = word;
+    return count;
+}
+
+// Tops up short prefix results with fuzzy matches from both sources, best
+// score first.
+int add_fuzzy_suggestions(int count, const char* prefix) {
+    if ((int)strlen(prefix) < FUZZY_MIN_QUERY) return count;
+    
+    FuzzyMatch known[MAX_SUGGESTIONS];
+    FuzzyMatch found[MAX_SUGGESTIONS];
+    int known_count = fuzzy_match(knowledge_fuzzy, prefix, known, MAX_SUGGESTIONS);
+    int found_count = harvest_view ? 
+        fuzzy_match(harvest_view->fuzzy, prefix, found, MAX_SUGGESTIONS) : 0;
+    
+    int k = 0, f = 0;
+    while (count < MAX_SUGGESTIONS && (k < known_count || f < found_count)) {
+        if (f >= found_count || (k < known_count && known[k].score >= found[f].score)) {
+            count = add_suggestion(count, known[k++].word, prefix);
+        } else {
+            count = add_suggestion(count, found[f++].word, prefix);
+        }
+    }
+    return count;
+}
+
+// Interleaves the built-in words, identifiers harvested from the buffer,
+// the project's symbols and each dictionary, dropping duplicates, so no
+// source can crowd out the rest.
+int collect_suggestions(const char* prefix) {
+    const char* lists[3 + DICTIONARY_MAX][MAX_SUGGESTIONS];
+    int counts[3 + DICTIONARY_MAX];
+    int sources = 0;
+    counts[sources] = trie_cursor_suggest(&completion, lists[sources], MAX_SUGGESTIONS);
+    sources++;
+    counts[sources] = trie_cursor_suggest(&harvested, lists[sources], MAX_SUGGESTIONS);
+    sources++;
+    counts[sources] = trie_cursor_suggest(&project_symbols, lists[sources], MAX_SUGGESTIONS);
+    sources++;
+    for (int d = 0; d < dictionary_count(); d++, sources++) {
+        counts[sources] = trie_cursor_suggest(&dictionary_cursors[d], lists[sources],
+                                              MAX_SUGGESTIONS);
+    }
+    
+    int count = 0;
+    for (int i = 0; i < MAX_SUGGESTIONS && count < MAX_SUGGESTIONS; i++) {
+        for (int source = 0; source < sources && count < MAX_SUGGESTIONS; source++) {
+            if (i < counts[source]) count = add_suggestion(count, lists[source][i], prefix);
+        }
+    }
+    return add_fuzzy_suggestions(count, prefix);
+}
+
+void get_suggestions_at_pos(Trie* root, const char* prefix) {
+    trie_cursor_reset(&completion, root);
+    harvested_version = harvest_version();
+    harvest_view = harvest_acquire();
+    trie_cursor_reset(&harvested, harvest_view ? harvest_view->trie : NULL);
+    project_symbols_version = symbols_version();
+    trie_cursor_reset(&project_symbols, symbols_trie());
+    dictionaries_version = dictionary_version();
+    for (int d = 0; d < dictionary_count(); d++) {
+        trie_cursor_reset(&dictionary_cursors[d], dictionary_trie(d));
+    }
+    for (int i = 0; prefix[i]; i++) {
+        trie_cursor_push(&completion, prefix[i]);
+        trie_cursor_push(&harvested, prefix[i]);
+        trie_cursor_push(&project_symbols, prefix[i]);
+        for (int d = 0; d < dictionary_count(); d++) {
+            trie_cursor_push(&dictionary_cursors[d], prefix[i]);
+        }
+    }
+    suggestion_count = collect_suggestions(prefix);
+    selected_suggestion = -1;
+}
+
+void init_c_knowledge() {
+    knowledge_base = create_trie();
+    knowledge_fuzzy = fuzzy_create();
+    if (!knowledge_base || !knowledge_fuzzy) return;
+
+    const char* knowledge[] = {
+        "stdio.h", "stdlib.h", "string.h", "math.h", "time.h", 
+        "ctype.h", "stdbool.h", "limits.h", "float.h",
+        "#include", "#define", "#ifdef", "#ifndef", "#endif",
+        "#pragma", "#if", "#else", "#elif",
+        "printf", "scanf", "fopen", "fclose", "malloc", "free",
+        "calloc", "realloc", "exit", "atoi", "atof", "rand", "srand",
+        "system", "abs", "strcpy", "strcat", "strcmp", "strlen",
+        "memcpy", "memset", "sin", "cos", "tan", "sqrt", "pow", "log",
+        "time", "clock", "sizeof", "main",
+        "auto", "break", "case", "char", "const", "continue", "default",
+        "do", "double", "else", "enum", "extern", "float", "for", "goto",
+        "if", "int", "long", "register", "return", "short", "signed",
+        "sizeof", "static", "struct", "switch", "typedef", "union",
+        "unsigned", "void", "volatile", "while",
+        "for(int i=0; i<n; i++)", "while(1)", "if()", "else if()", 
+        "switch()", "case", "break;", "continue;", "return 0;", 
+        "NULL", "FILE*", "size_t", "typedef struct", "void*", "int main()",
+        NULL
+    };
+
+    // Ranked above the rest until usage takes over.
+    const char* frequent[] = {
+        "#include", "#define", "stdio.h", "stdlib.h", "string.h",
+        "printf", "scanf", "malloc", "free", "strlen", "sizeof",
+        "int", "char", "void", "return", "if", "else", "for", "while",
+        "struct", "const", "NULL", "int main()", "return 0;",
+        NULL
+    };
+
+    for (int i = 0; knowledge[i] != NULL; i++) {
+        trie_insert(knowledge_base, knowledge[i]);
+        fuzzy_add(knowledge_fuzzy, knowledge[i]);
+    }
+    for (int i = 0; frequent[i] != NULL; i++) {
+        trie_insert_weighted(knowledge_base, frequent[i], 1);
+    }
+}
+
+// Queues lines [first, last] for the identifier harvester; delta is -1 before
+// they change and +1 after.
+void harvest_lines(int first, int last, int delta) {
+    size_t start = tb_line_start(&text, first);
+    size_t end = (last + 1 < tb_line_count(&text)) ? tb_line_start(&text, last + 1) 
+                                                    : tb_length(&text);
+    harvest_text(&text, start, end - start, delta);
+}
+
+// Lazily indexed file text is appended at the end of the buffer.
+void harvest_indexed() {
+    if (text.pending > harvested_indexed) {
+        size_t added = text.pending - harvested_indexed;
+        harvest_text(&text, tb_length(&text) - added, added, 1);
+        harvested_indexed = text.pending;
+    }
+}
+
+void ensure_line(int line) {
+    tb_ensure_line(&text, line);
+    harvest_indexed();
+}
+
+// The pane header shows the job state, the rows below follow the end of the
+// output unless scrolled back with PgUp.
+void display_output(int y) {
+    JobStatus status;
+    job_status(&status);
+
+    char header[120];
+    switch (status.state) {
+        case JOB_BUILDING:
+            sprintf(header, "Output - building %.1fs  (F5 stops)", status.build_ms / 1000);
+            break;
+        case JOB_RUNNING:
+            sprintf(header, "Output - running %.1fs  (F5 stops)", status.run_ms / 1000);
+            break;
+        case JOB_FINISHED:
+            if (status.cached) {
+                sprintf(header, "Output - exit %d  build cached  run %.0f ms",
+                        status.exit_code, status.run_ms);
+            } else {
+                sprintf(header, "Output - exit %d  build %.0f ms  run %.0f ms",
+                        status.exit_code, status.build_ms, status.run_ms);
+            }
+            break;
+        case JOB_BUILD_FAILED:
+            sprintf(header, "Output - build failed  %.0f ms", status.build_ms);
+            break;
+        case JOB_CANCELLED:
+            sprintf(header, "Output - stopped");
+            break;
+        case JOB_FAILED:
+            sprintf(header, "Output - could not start");
+            break;
+        default:
+            sprintf(header, "Output");
+            break;
+    }
+    for (int x = 0; x < screen.width; x++) {
+        set_buffer_char(x, y, '-', ATTR_FG_RED | ATTR_FG_GREEN | ATTR_FG_BLUE);
+    }
+    set_buffer_text(0, y, header, ATTR_FG_GREEN | ATTR_FG_INTENSITY);
+
+    char stats[80];
+    sprintf(stats, " cache: %d hits, %d misses, %.1fs saved ",
+            build_cache.hits, build_cache.misses, build_cache.saved_ms / 1000);
+    set_buffer_text(screen.width - (int)strlen(stats) - 2, y, stats,
+                    ATTR_FG_RED | ATTR_FG_GREEN | ATTR_FG_BLUE);
+
+    int last = status.line_count > OUTPUT_ROWS ? status.line_count - OUTPUT_ROWS : 0;
+    int first = (output_scroll < 0 || output_scroll > last) ? last : output_scroll;
+    char line[MAX_LINE_SIZE];
+    for (int row = 0; row < OUTPUT_ROWS; row++) {
+        int stream = job_line(first + row, line, sizeof(line));
+        if (stream < 0) break;
+        unsigned short attr = ATTR_FG_RED | ATTR_FG_GREEN | ATTR_FG_BLUE;
+        if (stream == JOB_STDERR) attr = ATTR_FG_RED | ATTR_FG_INTENSITY;
+        if (stream == JOB_INFO) attr = ATTR_FG_GREEN;
+        set_buffer_text(0, y + 1 + row, line, attr);
+    }
+}
+
+// Errors outrank warnings. Returns the diagnostic to mark line with, or NULL.
+const Diagnostic* line_diagnostic(int line) {
+    const Diagnostic* found = NULL;
+    for (int i = 0; i < diagnostic_count; i++) {
+        if (diagnostics[i].line != line) continue;
+        if (!found || diagnostics[i].severity < found->severity) found = &diagnostics[i];
+    }
+    return found;
+}
+
+void display_diagnostics() {
+    int errors = 0;
+    for (int i = 0; i < diagnostic_count; i++) {
+        if (diagnostics[i].severity == CHECK_ERROR) errors++;
+    }
+
+    char summary[80];
+    double latency = check_latency();
+    if (latency < 0) {
+        summary[0] = '\0';
+    } else {
+        sprintf(summary, "%d errors, %d warnings  (checked %.0f ms after edit)",
+                errors, diagnostic_count - errors, latency);
+    }
+    int summary_x = screen.width - (int)strlen(summary) - 1;
+    set_buffer_text(summary_x, screen.height - 1, summary,
+                   ATTR_FG_RED | ATTR_FG_GREEN | ATTR_FG_BLUE);
+
+    const Diagnostic* d = line_diagnostic(current_line);
+    if (d) {
+        char message[CHECK_MESSAGE_MAX + 16];
+        int room = summary_x - 22;
+        snprintf(message, sizeof(message), "%s: %.*s",
+                 d->severity == CHECK_ERROR ? "error" : "warning",
+                 room > 9 ? room - 9 : 0, d->message);
+        set_buffer_text(20, screen.height - 1, message,
+                       d->severity == CHECK_ERROR ? ATTR_FG_RED | ATTR_FG_INTENSITY
+                                                  : ATTR_FG_RED | ATTR_FG_GREEN | ATTR_FG_INTENSITY);
+    }
+}
+
+// Paints the matches on length bytes of a line from offset over their
+// highlighting, the current one brighter.
+void mark_matches(int line, size_t offset, size_t length, unsigned short* attrs) {
+    size_t view_start = tb_line_start(&text, line) + offset;
+    size_t view_end = view_start + length;
+    for (int m = search_first_after(&find_results, view_start); m < find_results.count; m++) {
+        const SearchMatch* match = &find_results.matches[m];
+        if (match->start >= view_end) break;
+        size_t from = match->start > view_start ? match->start - view_start : 0;
+        size_t to = match->end < view_end ? match->end - view_start : length;
+        unsigned short attr = m == find_current ? ATTR_BG_RED | ATTR_BG_GREEN | ATTR_BG_INTENSITY
+                                                : ATTR_BG_RED | ATTR_BG_GREEN | ATTR_FG_RED |
+                                                  ATTR_FG_GREEN | ATTR_FG_BLUE | ATTR_FG_INTENSITY;
+        for (size_t x = from; x < to; x++) attrs[x] = attr;
+    }
+}
+
+void display_find(int y) {
+    unsigned short normal = ATTR_FG_RED | ATTR_FG_GREEN | ATTR_FG_BLUE;
+    char info[120];
+    if (find_mode == FIND_QUERY) {
+        set_buffer_text(0, y, "Find:", ATTR_FG_GREEN | ATTR_FG_INTENSITY);
+        set_buffer_text(6, y, find_query, normal);
+    } else {
+        set_buffer_text(0, y, "Replace with:", ATTR_FG_GREEN | ATTR_FG_INTENSITY);
+        set_buffer_text(14, y, replace_text, normal);
+    }
+
+    if (find_length == 0) {
+        info[0] = '\0';
+    } else if (find.error) {
+        snprintf(info, sizeof(info), "%s", find.error);
+    } else if (find_results.count == 0) {
+        snprintf(info, sizeof(info), "no matches (%.1f ms)", find_ms);
+    } else {
+        snprintf(info, sizeof(info), "%d/%d%s (%.1f ms)", find_current + 1, find_results.count,
+                 find_results.truncated ? "+" : "", find_ms);
+    }
+    int x = screen.width - 62;
+    set_buffer_text(x, y, find_regex ? "[regex]" : "[text]", ATTR_FG_GREEN | ATTR_FG_BLUE | ATTR_FG_INTENSITY);
+    set_buffer_text(x + 8, y, info, find.error ? ATTR_FG_RED | ATTR_FG_INTENSITY : normal);
+    set_buffer_text(screen.width - 32, y,
+                   find_mode == FIND_QUERY ? "Enter:Next TAB:Regex ^R:Replace" : "Enter:All ^R:Find ESC:Close",
+                   normal);
+}
+
+const LineLayout* line_layout(int line) {
+    return layout_line(&layout, &text, line);
+}
+
+size_t cursor_column() {
+    const LineLayout* l = line_layout(current_line);
+    if (!l) return cursor_pos;
+    return layout_column(l, &text, tb_line_start(&text, current_line), cursor_pos);
+}
+
+int reserve_view(size_t n) {
+    if (n <= view_capacity) return 0;
+    size_t cap = view_capacity ? view_capacity : 4096;
+    while (cap < n) cap *= 2;
+    char* t = (char*)realloc(view_text, cap);
+    if (t) view_text = t;
+    unsigned char* c = (unsigned char*)realloc(view_classes, cap);
+    if (c) view_classes = c;
+    unsigned short* a = (unsigned short*)realloc(view_attrs, cap * sizeof(unsigned short));
+    if (a) view_attrs = a;
+    if (!t || !c || !a) return -1;
+    view_capacity = cap;
+    return 0;
+}
+
+void put_view_cell(int x, int y, unsigned int ch, unsigned short attr) {
+    if (x >= 0 && x < screen.width - 2) screen_put(&screen, x + 2, y, ch, attr);
+}
+
+// Draws the columns of a line from scroll_column to the right edge. Only
+// those bytes are read, and lexing starts from the highlighter's last
+// restart point before them.
+void display_text_line(int line, int y) {
+    const LineLayout* l = layout_line(&layout, &text, line);
+    if (!l) return;
+    size_t line_start = tb_line_start(&text, line);
+    int width = screen.width - 2;
+    size_t column, end_column;
+    size_t first = layout_byte(l, &text, line_start, scroll_column, &column);
+    size_t last = layout_byte(l, &text, line_start, scroll_column + width, &end_column);
+
+    size_t from;
+    int state = hl_restart(&highlight, &text, line, first, &from);
+    size_t to = last + VIEW_LOOKAHEAD < l->length ? last + VIEW_LOOKAHEAD : l->length;
+    size_t n = to - from;
+    if (n == 0 || reserve_view(n) != 0) return;
+
+    tb_read(&text, line_start + from, n, view_text);
+    hl_lex(view_text, n, state, view_classes);
+    for (size_t b = 0; b < n; b++) {
+        view_attrs[b] = hl_colors[view_classes[b]];
+    }
+    if (find_mode != FIND_OFF) mark_matches(line, from, n, view_attrs);
+
+    int x = (int)(column - scroll_column);
+    for (size_t b = first - from; b < n && x < width;) {
+        unsigned char c = (unsigned char)view_text[b];
+        unsigned short attr = view_attrs[b];
+        if (c == '\t') {
+            int w = LAYOUT_TAB_WIDTH - (int)(column % LAYOUT_TAB_WIDTH);
+            for (int k = 0; k < w; k++) put_view_cell(x + k, y, ' ', attr);
+            x += w;
+            column += w;
+            b++;
+            continue;
+        }
+        unsigned int cp = c;
+        int bytes = c < 0x80 ? 1 : layout_decode(view_text + b, n - b, &cp);
+        int w = c < 0x80 ? 1 : layout_width(cp);
+        if (w == 2 && x >= 0 && x + 1 < width) {
+            put_view_cell(x, y, cp, attr);
+            put_view_cell(x + 1, y, CELL_CONTINUATION, attr);
+        } else if (w == 2) {
+            // Half of it is off the edge.
+            put_view_cell(x, y, ' ', attr);
+            put_view_cell(x + 1, y, ' ', attr);
+        } else if (w == 1) {
+            put_view_cell(x, y, cp, attr);
+        }
+        x += w;
+        column += w;
+        b += bytes;
+    }
+}
+
+void display_editor() {
+    clear_buffer();
+    
+    set_buffer_text(0, 0, " MintMind C Editor ", 
+                   ATTR_FG_GREEN | ATTR_FG_INTENSITY);
+    
+    ensure_line(current_line + 6);
+    
+    char lineInfo[40];
+    sprintf(lineInfo, "(Line %d/%d%s)", current_line + 1, tb_line_count(&text),
+            tb_is_complete(&text) ? "" : "+");
+    set_buffer_text(20, 0, lineInfo, 
+                   ATTR_FG_GREEN | ATTR_FG_INTENSITY);
+    if (file_path) {
+        set_buffer_text(42, 0, file_path, ATTR_FG_RED | ATTR_FG_GREEN | ATTR_FG_BLUE);
+    }
+    int tag_x = 42 + (file_path ? (int)strlen(file_path) + 1 : 0);
+    if (recovered) {
+        set_buffer_text(tag_x, 0, "[recovered]", ATTR_FG_RED | ATTR_FG_GREEN | ATTR_FG_INTENSITY);
+        tag_x += 12;
+    }
+    for (int d = 0; d < dictionary_count(); d++) {
+        if (dictionary_state(d) == DICTIONARY_BAD) {
+            set_buffer_text(tag_x, 0, "[bad dictionary]", ATTR_FG_RED | ATTR_FG_INTENSITY);
+            tag_x += 17;
+            break;
+        }
+    }
+    char indexing[48];
+    indexing[0] = '\0';
+    if (shown_progress.state == SYMBOLS_SCANNING) {
+        snprintf(indexing, sizeof(indexing), "[indexing %u/%u files]",
+                 shown_progress.files_done, shown_progress.files_found);
+    } else if (shown_progress.state == SYMBOLS_MERGING) {
+        snprintf(indexing, sizeof(indexing), "[merging symbols]");
+    }
+    set_buffer_text(tag_x, 0, indexing, ATTR_FG_GREEN | ATTR_FG_BLUE);
+    
+    set_buffer_text(0, 1, "================================",
+                   ATTR_FG_RED | ATTR_FG_GREEN | ATTR_FG_BLUE);
+
+    int total_lines = tb_line_count(&text);
+    int start = (current_line > 5) ? current_line - 5 : 0;
+    int end = (current_line + 6 < total_lines) ? current_line + 6 : total_lines;
+    int display_line = 2;
+
+    // Scrolls sideways just far enough to show the cursor.
+    size_t column = cursor_column();
+    size_t text_width = screen.width > 3 ? screen.width - 3 : 1;
+    if (column < scroll_column) scroll_column = column;
+    else if (column > scroll_column + text_width) scroll_column = column - text_width;
+
+    for (int i = start; i < end; i++, display_line++) {
+        if (i == current_line) {
+            set_buffer_text(0, display_line, ">", 
+                          ATTR_BG_BLUE | ATTR_BG_INTENSITY);
+        } else {
+            set_buffer_text(0, display_line, " ", 
+                          ATTR_FG_RED | ATTR_FG_GREEN | ATTR_FG_BLUE);
+        }
+        const Diagnostic* d = line_diagnostic(i);
+        if (d && d->severity == CHECK_ERROR) {
+            set_buffer_char(1, display_line, 'E', ATTR_FG_RED | ATTR_FG_INTENSITY);
+        } else if (d) {
+            set_buffer_char(1, display_line, 'W', ATTR_FG_RED | ATTR_FG_GREEN | ATTR_FG_INTENSITY);
+        }
+        display_text_line(i, display_line);
+    }
+
+    int output_y = screen.height - 3 - OUTPUT_ROWS;
+    if (show_output) display_output(output_y);
+    int suggestion_end = show_output ? output_y : screen.height - 2;
+
+    if (show_suggestions && suggestion_count > 0) {
+        int suggestion_y = display_line + 1;
+        set_buffer_text(0, suggestion_y, "Suggestions:", 
+                       ATTR_FG_RED | ATTR_FG_GREEN | ATTR_FG_BLUE);
+        suggestion_y++;
+        
+        for (int i = 0; i < suggestion_count && suggestion_y < suggestion_end; i++, suggestion_y++) {
+            unsigned short attr = ATTR_FG_RED | ATTR_FG_GREEN | ATTR_FG_BLUE;
+            if (i == selected_suggestion) {
+                attr = ATTR_BG_GREEN | ATTR_BG_INTENSITY;
+            }
+            set_buffer_text(2, suggestion_y, suggestions[i], attr);
+        }
+    }
+
+    int status_y = screen.height - 2;
+    if (find_mode != FIND_OFF) {
+        display_find(status_y);
+    } else {
+        set_buffer_text(0, status_y, 
+                       "F1:Save/Run  F2:NewLine  F3:Help  F4:Output  F5:Stop  F6:Profile  ^Z/^Y:Undo/Redo  ^F:Find  TAB:Suggestions  ESC:Exit",
+                       ATTR_FG_RED | ATTR_FG_GREEN | ATTR_FG_BLUE);
+    }
+    
+    char posInfo[40];
+    sprintf(posInfo, "Line %d, Col %d", current_line + 1, (int)column + 1);
+    set_buffer_text(0, screen.height - 1, posInfo,
+                   ATTR_FG_RED | ATTR_FG_GREEN | ATTR_FG_BLUE);
+    display_diagnostics();
+
+    if (find_mode == FIND_QUERY) {
+        screen_set_cursor(&screen, 6 + find_length, status_y);
+    } else if (find_mode == FIND_REPLACE) {
+        screen_set_cursor(&screen, 14 + replace_length, status_y);
+    } else {
+        screen_set_cursor(&screen, (int)(column - scroll_column) + 2, current_line - start + 2);
+    }
+}
+
+size_t cursor_offset() {
+    return tb_line_start(&text, current_line) + cursor_pos;
+}
+
+int line_length(int line) {
+    return (int)tb_line_length(&text, line);
+}
+
+// Columns of the character at pos on the current line; stores its length.
+int char_width(int pos, int* bytes) {
+    char s[4];
+    int left = line_length(current_line) - pos;
+    size_t n = tb_read(&text, tb_line_start(&text, current_line) + pos, left < 4 ? left : 4, s);
+    unsigned int cp;
+    *bytes = layout_decode(s, n, &cp);
+    return cp < 32 ? 1 : layout_width(cp);
+}
+
+// The cursor steps over whole UTF-8 characters and the combining marks
+// after them.
+int next_char(int pos) {
+    int length = line_length(current_line);
+    int bytes;
+    if (pos >= length) return pos;
+    char_width(pos, &bytes);
+    pos += bytes;
+    while (pos < length && char_width(pos, &bytes) == 0) pos += bytes;
+    return pos;
+}
+
+int prev_char(int pos) {
+    size_t line_start = tb_line_start(&text, current_line);
+    while (pos > 0) {
+        int back = pos - 1;
+        for (int k = 0; k < 3 && back > 0 && (tb_char_at(&text, line_start + back) & 0xC0) == 0x80; k++) {
+            back--;
+        }
+        int bytes;
+        int width = char_width(back, &bytes);
+        // Stray continuation bytes are characters of their own.
+        if (back + bytes != pos) {
+            back = pos - 1;
+            width = 1;
+        }
+        pos = back;
+        if (width != 0) break;
+    }
+    return pos;
+}
+
+// The character on line at or covering column.
+int pos_at_column(int line, size_t column) {
+    const LineLayout* l = line_layout(line);
+    if (!l) return 0;
+    size_t at;
+    return (int)layout_byte(l, &text, tb_line_start(&text, line), column, &at);
+}
+
+int find_word_start(int pos) {
+    size_t line_start = tb_line_start(&text, current_line);
+    int word_start = pos;
+    while (word_start > 0 && pos - word_start < MAX_LINE_SIZE - 1) {
+        char c = tb_char_at(&text, line_start + word_start - 1);
+        if (c == ' ' || c == '\t' || c == '\n') break;
+        word_start--;
+    }
+    return word_start;
+}
+
+void copy_word(int word_start, int word_end, char* out) {
+    size_t n = tb_read(&text, tb_line_start(&text, current_line) + word_start,
+                       word_end - word_start, out);
+    out[n] = '\0';
+}
+
+void reset_completion() {
+    completion_line = -1;
+}
+
+int completion_attached() {
+    // A newer harvest means the cursor's identifiers are stale, and a
+    // dictionary that finished checking or a finished project index has no
+    // cursor yet.
+    return completion_line == current_line && harvested_version == harvest_version() &&
+           dictionaries_version == dictionary_version() &&
+           project_symbols_version == symbols_version() &&
+           completion_start + trie_cursor_length(&completion) == cursor_pos;
+}
+
+void seek_completion() {
+    PROFILE_SCOPE(PROFILE_SUGGEST);
+    int word_start = find_word_start(cursor_pos);
+    char current_word[MAX_LINE_SIZE];
+    copy_word(word_start, cursor_pos, current_word);
+
+    get_suggestions_at_pos(knowledge_base, current_word);
+    completion_line = current_line;
+    completion_start = word_start;
+}
+
+void push_completion(char c) {
+    PROFILE_SCOPE(PROFILE_SUGGEST);
+    trie_cursor_push(&completion, c);
+    trie_cursor_push(&harvested, c);
+    trie_cursor_push(&project_symbols, c);
+    for (int d = 0; d < dictionary_count(); d++) trie_cursor_push(&dictionary_cursors[d], c);
+}
+
+void pop_completion() {
+    PROFILE_SCOPE(PROFILE_SUGGEST);
+    trie_cursor_pop(&completion);
+    trie_cursor_pop(&harvested);
+    trie_cursor_pop(&project_symbols);
+    for (int d = 0; d < dictionary_count(); d++) trie_cursor_pop(&dictionary_cursors[d]);
+}
+
+void show_completion() {
+    PROFILE_SCOPE(PROFILE_SUGGEST);
+    char prefix[MAX_LINE_SIZE];
+    copy_word(completion_start, cursor_pos, prefix);
+    suggestion_count = collect_suggestions(prefix);
+    show_suggestions = 1;
+    selected_suggestion = (suggestion_count > 0) ? 0 : -1;
+}
+
+int count_newlines(const char* s, size_t length) {
+    int count = 0;
+    for (size_t i = 0; i < length; i++) {
+        if (s[i] == '\n') count++;
+    }
+    return count;
+}
+
+// Changes the buffer, journals the edit and tells the harvester, the
+// highlighter and the checker which lines changed. Nothing is recorded for undo.
+int buffer_insert(size_t offset, const char* s, size_t length) {
+    int line = tb_line_of_offset(&text, offset);
+    size_t column = offset - tb_line_start(&text, line);
+    int added = count_newlines(s, length);
+    harvest_lines(line, line, -1);
+    int rc = tb_insert(&text, offset, s, length);
+    if (rc == 0) {
+        hl_edit(&highlight, line, column, 0, added);
+        layout_edit(&layout, line, column, 0, added);
+        check_edit();
+        journal_insert(offset, s, length);
+    } else {
+        added = 0;
+    }
+    harvest_lines(line, line + added, 1);
+    return rc;
+}
+
+// removed is the text at offset, needed for its line count.
+void buffer_delete(size_t offset, const char* removed, size_t length) {
+    int line = tb_line_of_offset(&text, offset);
+    size_t column = offset - tb_line_start(&text, line);
+    int lines = count_newlines(removed, length);
+    harvest_lines(line, line + lines, -1);
+    tb_delete(&text, offset, length);
+    hl_edit(&highlight, line, column, lines, 0);
+    layout_edit(&layout, line, column, lines, 0);
+    check_edit();
+    journal_delete(offset, length);
+    harvest_lines(line, line, 1);
+}
+
+int edit_insert(size_t offset, const char* s, size_t length) {
+    PROFILE_SCOPE(PROFILE_EDIT);
+    if (buffer_insert(offset, s, length) != 0) return -1;
+    undo_record(&undo_log, UNDO_INSERT, offset, s, length);
+    return 0;
+}
+
+void edit_delete(size_t offset, size_t length) {
+    if (length == 0) return;
+    PROFILE_SCOPE(PROFILE_EDIT);
+    char small[256];
+    char* removed = length <= sizeof(small) ? small : (char*)malloc(length);
+    if (!removed) return;
+    length = tb_read(&text, offset, length, removed);
+    undo_record(&undo_log, UNDO_DELETE, offset, removed, length);
+    buffer_delete(offset, removed, length);
+    if (removed != small) free(removed);
+}
+
+void apply_undo(int type, size_t offset, const char* s, size_t length, void* ctx) {
+    size_t* cursor = (size_t*)ctx;
+    if (type == UNDO_INSERT) {
+        buffer_insert(offset, s, length);
+        *cursor = offset + length;
+    } else {
+        buffer_delete(offset, s, length);
+        *cursor = offset;
+    }
+}
+
+void undo_step(int redo) {
+    PROFILE_SCOPE(PROFILE_EDIT);
+    size_t cursor = 0;
+    int applied = redo ? undo_redo(&undo_log, apply_undo, &cursor)
+                       : undo_undo(&undo_log, apply_undo, &cursor);
+    if (!applied) return;
+    reset_completion();
+    show_suggestions = 0;
+    current_line = tb_line_of_offset(&text, cursor);
+    cursor_pos = (int)(cursor - tb_line_start(&text, current_line));
+}
+
+void insert_char(char ch) {
+    if (edit_insert(cursor_offset(), &ch, 1) == 0) {
+        cursor_pos++;
+    }
+}
+
+void delete_char() {
+    if (cursor_pos > 0) {
+        int pos = prev_char(cursor_pos);
+        edit_delete(tb_line_start(&text, current_line) + pos, cursor_pos - pos);
+        cursor_pos = pos;
+    }
+}
+
+void new_line() {
+    reset_completion();
+    if (edit_insert(cursor_offset(), "\n", 1) == 0) {
+        current_line++;
+        cursor_pos = 0;
+    }
+}
+
+// A paste goes in as a single edit and undo step; completion waits for the
+// next key typed after it.
+void paste_text(const char* s, int length) {
+    reset_completion();
+    show_suggestions = 0;
+    if (length <= 0) return;
+    undo_seal(&undo_log);
+    if (edit_insert(cursor_offset(), s, length) == 0) {
+        int lines = count_newlines(s, length);
+        if (lines > 0) {
+            int last = length;
+            while (s[last - 1] != '\n') last--;
+            current_line += lines;
+            cursor_pos = length - last;
+        } else {
+            cursor_pos += length;
+        }
+    }
+    undo_seal(&undo_log);
+}
+
+void apply_suggestion() {
+    if (selected_suggestion >= 0 && selected_suggestion < suggestion_count) {
+        int word_start = find_word_start(cursor_pos);
+        int suggestion_len = strlen(suggestions[selected_suggestion]);
+        size_t start = tb_line_start(&text, current_line) + word_start;
+        
+        undo_begin(&undo_log);
+        edit_delete(start, cursor_pos - word_start);
+        if (edit_insert(start, suggestions[selected_suggestion], suggestion_len) == 0) {
+            cursor_pos = word_start + suggestion_len;
+            trie_touch(knowledge_base, suggestions[selected_suggestion]);
+            trie_touch(symbols_trie(), suggestions[selected_suggestion]);
+            for (int d = 0; d < dictionary_count(); d++) {
+                trie_touch(dictionary_trie(d), suggestions[selected_suggestion]);
+            }
+        } else {
+            cursor_pos = word_start;
+        }
+        undo_end(&undo_log);
+    }
+    reset_completion();
+    show_suggestions = 0;
+}
+
+void jump_to_match(int m) {
+    find_current = m;
+    if (m < 0 || m >= find_results.count) return;
+    size_t offset = find_results.matches[m].start;
+    current_line = tb_line_of_offset(&text, offset);
+    cursor_pos = (int)(offset - tb_line_start(&text, current_line));
+}
+
+// Searches the whole buffer again and shows the first match after where
+// the search started.
+void update_find() {
+    search_free(&find);
+    find_results.count = 0;
+    find_results.truncated = 0;
+    find_current = -1;
+    if (search_compile(&find, find_query, find_length, find_regex ? SEARCH_REGEX : SEARCH_LITERAL) != 0) {
+        return;
+    }
+
+    Clock::time_point t0 = Clock::now();
+    search_collect(&find, &text, &find_results);
+    find_ms = ms_since(t0);
+
+    int m = search_first_after(&find_results, find_origin);
+    if (m == find_results.count) m = 0;
+    jump_to_match(m);
+}
+
+void open_find() {
+    reset_completion();
+    show_suggestions = 0;
+    undo_seal(&undo_log);
+    // Search needs every line of an opened file.
+    tb_index_all(&text);
+    harvest_indexed();
+    find_origin = cursor_offset();
+    find_mode = FIND_QUERY;
+    if (find_length > 0) update_find();
+}
+
+void close_find() {
+    find_mode = FIND_OFF;
+    search_free(&find);
+    search_results_free(&find_results);
+    find_current = -1;
+}
+
+void step_match(int delta) {
+    if (find_results.count == 0) return;
+    int m = find_current + delta;
+    if (m < 0) m = find_results.count - 1;
+    if (m >= find_results.count) m = 0;
+    jump_to_match(m);
+    find_origin = find_results.matches[m].start;
+}
+
+// Swaps every match for the replacement as one edit over the text from the
+// first match to the last, which is also a single undo step.
+void replace_all() {
+    if (find_results.count == 0) return;
+    size_t length;
+    char* replaced = search_replacement(&text, &find_results, replace_text, replace_length, &length);
+    if (!replaced) return;
+    size_t first = find_results.matches[0].start;
+    size_t last = find_results.matches[find_results.count - 1].end;
+
+    undo_begin(&undo_log);
+    edit_delete(first, last - first);
+    edit_insert(first, replaced, length);
+    undo_end(&undo_log);
+    free(replaced);
+
+    find_origin = first;
+    find_mode = FIND_QUERY;
+    update_find();
+}
+
+void find_key(const InputEvent* ev) {
+    char* field = find_mode == FIND_QUERY ? find_query : replace_text;
+    int* length = find_mode == FIND_QUERY ? &find_length : &replace_length;
+    int capacity = find_mode == FIND_QUERY ? SEARCH_MAX_PATTERN : MAX_LINE_SIZE - 1;
+
+    switch (ev->key) {
+        case KEY_ESCAPE:
+            close_find();
+            return;
+        case KEY_ENTER:
+            if (find_mode == FIND_REPLACE) replace_all();
+            else step_match(1);
+            return;
+        case KEY_DOWN:
+            step_match(1);
+            return;
+        case KEY_UP:
+            step_match(-1);
+            return;
+        case KEY_TAB:
+            find_regex = !find_regex;
+            update_find();
+            return;
+        case KEY_BACKSPACE:
+            if (*length == 0) return;
+            field[--*length] = '\0';
+            if (find_mode == FIND_QUERY) update_find();
+            return;
+        case KEY_CHAR:
+            if (ev->ch == CTRL_R) {
+                find_mode = find_mode == FIND_QUERY ? FIND_REPLACE : FIND_QUERY;
+                return;
+            }
+            if (ev->ch < 32 || ev->ch > 126 || *length >= capacity) return;
+            field[(*length)++] = (char)ev->ch;
+            field[*length] = '\0';
+            if (find_mode == FIND_QUERY) update_find();
+            return;
+        case KEY_PASTE:
+            // The field holds one line; the paste stops at its first break.
+            for (int i = 0; i < ev->length && ev->text[i] != '\n' && *length < capacity; i++) {
+                unsigned char c = (unsigned char)ev->text[i];
+                if (c >= 32 && c <= 126) field[(*length)++] = (char)c;
+            }
+            field[*length] = '\0';
+            if (find_mode == FIND_QUERY) update_find();
+            return;
+    }
+}
+
+// Writes to a temporary file and renames it over path, so a file that is
+// still mapped as the buffer's original text is never truncated in place.
+// A missing final newline is added to the buffer as an edit of its own, so
+// the journal's replica and the file written stay the same text.
+int save_buffer(const char* path) {
+    char tmp_path[1024];
+    snprintf(tmp_path, sizeof(tmp_path), "%s.tmp", path);
+    
+    FILE* f = fopen(tmp_path, "wb");
+    if (!f) return -1;
+    
+    tb_index_all(&text);
+    harvest_indexed();
+    size_t length = tb_length(&text);
+    if (length > 0 && tb_char_at(&text, length - 1) != '\n') {
+        undo_seal(&undo_log);
+        edit_insert(length, "\n", 1);
+        undo_seal(&undo_log);
+    }
+    int rc = tb_write(&text, f);
+    if (fclose(f) != 0) rc = -1;
+    
+#ifdef _WIN32
+    if (rc == 0 && !MoveFileExA(tmp_path, path, MOVEFILE_REPLACE_EXISTING)) rc = -1;
+#else
+    if (rc == 0 && rename(tmp_path, path) != 0) rc = -1;
+#endif
+    if (rc != 0) remove(tmp_path);
+    if (rc == 0 && strcmp(path, document_path) == 0) journal_saved();
+    return rc;
+}
+
+// An unchanged buffer runs the executable built from it before. A fresh
+// build only enters the cache once the job reports it succeeded.
+void execute_program() {
+    if (save_buffer(document_path) != 0) return;
+
+    unsigned long long key = cache_key(&text, document_path, JOB_COMPILER);
+    char program[64];
+    cache_path(key, program, sizeof(program));
+    if (cache_lookup(&build_cache, key)) {
+        build_pending = 0;
+        job_run(program);
+    } else if (job_start(document_path, program) == 0) {
+        pending_build = key;
+        build_pending = 1;
+    }
+    show_output = 1;
+    output_scroll = -1;
+}
+
+void record_build() {
+    if (!build_pending) return;
+    JobStatus status;
+    job_status(&status);
+    if (status.built) {
+        cache_store(&build_cache, pending_build, status.build_ms);
+        build_pending = 0;
+    } else if (!job_active()) {
+        build_pending = 0;
+    }
+}
+
+void scroll_output(int delta) {
+    JobStatus status;
+    job_status(&status);
+    int last = status.line_count > OUTPUT_ROWS ? status.line_count - OUTPUT_ROWS : 0;
+    int first = output_scroll < 0 ? last : output_scroll;
+    first += delta;
+    if (first < 0) first = 0;
+    output_scroll = first >= last ? -1 : first;
+}
+
+// The last finished frame by stage, boxed in the top right corner. The
+// stages of the frame being drawn are still running, so this always lags
+// one frame behind.
+void display_profile() {
+    unsigned short normal = ATTR_FG_RED | ATTR_FG_GREEN | ATTR_FG_BLUE | ATTR_BG_BLUE;
+    unsigned short title = ATTR_FG_RED | ATTR_FG_GREEN | ATTR_FG_INTENSITY | ATTR_BG_BLUE;
+    int width = 30;
+    int x = screen.width - width;
+    int y = 2;
+    char row[64];
+
+    ProfileFrame frame;
+    if (!profile_last_frame(&frame)) memset(&frame, 0, sizeof(frame));
+    snprintf(row, sizeof(row), " frame %-6llu %9.3f ms    ", frame.number, frame.total_ns / 1e6);
+    set_buffer_text(x, y++, row, title);
+    for (int i = PROFILE_INPUT; i <= PROFILE_OUTPUT; i++) {
+        snprintf(row, sizeof(row), "   %-10s %9.3f ms    ", profile_stage_names[i],
+                 frame.stage_ns[i] / 1e6);
+        set_buffer_text(x, y++, row, normal);
+    }
+    if (trace_written) {
+        snprintf(row, sizeof(row), " %-29s", trace_written > 0 ? "trace: " PROFILE_TRACE_PATH
+                                                                : "trace: write failed");
+    } else {
+        snprintf(row, sizeof(row), " %-29s", "F7 writes a trace");
+    }
+    set_buffer_text(x, y, row, normal);
+}
+
+// Shown until the next key.
+void display_help() {
+    unsigned short normal = ATTR_FG_RED | ATTR_FG_GREEN | ATTR_FG_BLUE;
+    clear_buffer();
+    set_buffer_text(0, 0, "MintMind C Editor Help", ATTR_FG_GREEN | ATTR_FG_INTENSITY);
+    set_buffer_text(0, 1, "=====================", normal);
+    set_buffer_text(0, 3, "Arrow Keys: Navigate", normal);
+    set_buffer_text(0, 4, "Enter:     New Line", normal);
+    set_buffer_text(0, 5, "F1:        Save & Run", normal);
+    set_buffer_text(0, 6, "F2:        New Line", normal);
+    set_buffer_text(0, 7, "F4:        Show/Hide Output", normal);
+    set_buffer_text(0, 8, "F5:        Stop Program", normal);
+    set_buffer_text(0, 9, "PgUp/PgDn: Scroll Output", normal);
+    set_buffer_text(0, 10, "Ctrl-Z:    Undo", normal);
+    set_buffer_text(0, 11, "Ctrl-Y:    Redo", normal);
+    set_buffer_text(0, 12, "Ctrl-F:    Find (TAB: regex, Ctrl-R: replace)", normal);
+    set_buffer_text(0, 13, "TAB:       Suggestions", normal);
+    set_buffer_text(0, 14, "F6:        Show/Hide Profile", normal);
+    set_buffer_text(0, 15, "F7:        Write Profile Trace (" PROFILE_TRACE_PATH ")", normal);
+    set_buffer_text(0, 16, "ESC:       Exit", normal);
+    set_buffer_text(0, 18, "Press any key to continue...", normal);
+}
+
+int editor_add_dictionary(const char* path) {
+    return dictionary_add(path);
+}
+
+int editor_index_project(const char* dir) {
+    if (symbols_add_root(dir, 0) != 0) return -1;
+    symbols_add_system_roots();
+    index_project = 1;
+    return 0;
+}
+
+int editor_open(const char* path) {
+    if (path) {
+        file_path = path;
+        document_path = path;
+    }
+    int base = JOURNAL_RESUME;
+    if (journal_recover(document_path, &text)) {
+        recovered = 1;
+    } else if (file_path && tb_open(&text, file_path) == 0) {
+        base = JOURNAL_BASE_FILE;
+    } else if (tb_init(&text) == 0) {
+        base = JOURNAL_BASE_EMPTY;
+    } else {
+        return -1;
+    }
+    init_c_knowledge();
+    hl_init(&highlight);
+    layout_init(&layout);
+    cache_init(&build_cache);
+    undo_init(&undo_log, UNDO_BUDGET);
+    check_start(document_path);
+    check_edit();
+    dictionary_start();
+    if (index_project) symbols_start(SYMBOLS_CACHE_PATH, 0);
+    journal_start(document_path, base);
+    harvest_start();
+    harvest_indexed();
+    return 0;
+}
+
+void editor_close() {
+    job_shutdown();
+    check_stop();
+    dictionary_stop();
+    symbols_stop();
+    journal_stop();
+    harvest_release();
+    harvest_stop();
+    free_trie(knowledge_base);
+    fuzzy_free(knowledge_fuzzy);
+    hl_free(&highlight);
+    layout_free(&layout);
+    undo_free(&undo_log);
+    close_find();
+    tb_free(&text);
+
+    // Leaves the editor ready for the next editor_open().
+    harvest_view = NULL;
+    harvested_version = 0;
+    harvested_indexed = 0;
+    reset_completion();
+    current_line = cursor_pos = 0;
+    scroll_column = 0;
+    show_suggestions = suggestion_count = 0;
+    selected_suggestion = -1;
+    show_output = show_help = 0;
+    output_scroll = -1;
+    diagnostic_count = 0;
+    recovered = 0;
+    index_project = 0;
+    memset(&shown_progress, 0, sizeof(shown_progress));
+}
+
+void editor_render() {
+    {
+        PROFILE_SCOPE(PROFILE_LAYOUT);
+        if (show_help) {
+            display_help();
+        } else {
+            display_editor();
+        }
+        if (show_profile) display_profile();
+    }
+    PROFILE_SCOPE(PROFILE_OUTPUT);
+    write_buffer();
+}
+
+int editor_update() {
+    int stale = 0;
+    if (job_version() != shown_job_version) {
+        shown_job_version = job_version();
+        record_build();
+        if (show_output) stale = 1;
+    }
+    if (check_version() != shown_check_version) {
+        shown_check_version = check_version();
+        diagnostic_count = check_diagnostics(diagnostics, CHECK_MAX_DIAGNOSTICS);
+        stale = 1;
+    }
+    check_poll(&text);
+
+    SymbolProgress progress;
+    symbols_progress(&progress);
+    if (progress.state != shown_progress.state ||
+        progress.files_done != shown_progress.files_done ||
+        progress.files_found != shown_progress.files_found) {
+        shown_progress = progress;
+        stale = 1;
+    }
+    return stale;
+}
+
+int editor_timeout() {
+    // Index the rest of an opened file while the user is idle.
+    int timeout = tb_is_complete(&text) ? IDLE_TIMEOUT_MS : 0;
+    int check_due = check_due_in();
+    if (check_due >= 0 && check_due < timeout) timeout = check_due;
+    return timeout;
+}
+
+int editor_idle() {
+    int stale = show_output && job_active();
+    if (!tb_is_complete(&text)) {
+        tb_index_more(&text, TB_INDEX_STEP);
+        harvest_indexed();
+        stale = 1;
+    }
+    return stale;
+}
+
+int handle_key(const InputEvent* ev) {
+    if (show_help) {
+        show_help = 0;
+        return EDITOR_CONTINUE;
+    }
+    if (find_mode != FIND_OFF) {
+        find_key(ev);
+        return EDITOR_CONTINUE;
+    }
+    switch (ev->key) {
+        case KEY_F1:
+            execute_program();
+            break;
+            
+        case KEY_F2:
+            new_line();
+            break;
+            
+        case KEY_F3:
+            show_help = 1;
+            break;
+            
+        case KEY_F4:
+            show_output = !show_output;
+            break;
+            
+        case KEY_F5:
+            job_cancel();
+            break;
+            
+        case KEY_F6:
+            show_profile = !show_profile;
+            break;
+            
+        case KEY_F7:
+            trace_written = profile_write_trace(PROFILE_TRACE_PATH) == 0 ? 1 : -1;
+            show_profile = 1;
+            break;
+            
+        case KEY_PAGE_UP:
+            if (show_output) scroll_output(-OUTPUT_ROWS);
+            break;
+            
+        case KEY_PAGE_DOWN:
+            if (show_output) scroll_output(OUTPUT_ROWS);
+            break;
+            
+        case KEY_UP:
+            if (show_suggestions && suggestion_count > 0) {
+                selected_suggestion = (selected_suggestion > 0) ? 
+                    selected_suggestion - 1 : suggestion_count - 1;
+            } else if (current_line > 0) {
+                reset_completion();
+                undo_seal(&undo_log);
+                size_t column = cursor_column();
+                current_line--;
+                cursor_pos = pos_at_column(current_line, column);
+            }
+            break;
+            
+        case KEY_DOWN:
+            if (show_suggestions && suggestion_count > 0) {
+                selected_suggestion = (selected_suggestion < suggestion_count - 1) ? 
+                    selected_suggestion + 1 : 0;
+            } else if (ensure_line(current_line + 1), 
+                       current_line < tb_line_count(&text) - 1) {
+                reset_completion();
+                undo_seal(&undo_log);
+                size_t column = cursor_column();
+                current_line++;
+                cursor_pos = pos_at_column(current_line, column);
+            }
+            break;
+            
+        case KEY_LEFT:
+            reset_completion();
+            undo_seal(&undo_log);
+            cursor_pos = prev_char(cursor_pos);
+            break;
+            
+        case KEY_RIGHT:
+            reset_completion();
+            undo_seal(&undo_log);
+            cursor_pos = next_char(cursor_pos);
+            break;
+            
+        case KEY_HOME:
+            reset_completion();
+            undo_seal(&undo_log);
+            cursor_pos = 0;
+            break;
+            
+        case KEY_END:
+            reset_completion();
+            undo_seal(&undo_log);
+            cursor_pos = line_length(current_line);
+            break;
+            
+        case KEY_ESCAPE:
+            return EDITOR_QUIT;
+            
+        case KEY_PASTE:
+            paste_text(ev->text, ev->length);
+            break;
+            
+        case KEY_ENTER:
+            if (show_suggestions && selected_suggestion >= 0) {
+                apply_suggestion();
+            } else {
+                new_line();
+            }
+            break;
+            
+        case KEY_TAB:
+            if (!show_suggestions) {
+                if (!completion_attached()) seek_completion();
+                show_completion();
+            } else if (suggestion_count > 0) {
+                apply_suggestion();
+            }
+            break;
+            
+        case KEY_BACKSPACE:
+            if (cursor_pos > 0 && completion_attached() && 
+                cursor_pos > completion_start) {
+                delete_char();
+                pop_completion();
+                if (cursor_pos > completion_start) {
+                    show_completion();
+                } else {
+                    show_suggestions = 0;
+                }
+            } else {
+                delete_char();
+                reset_completion();
+                show_suggestions = 0;
+            }
+            break;
+            
+        case KEY_CHAR: {
+            int ch = ev->ch;
+            if (ch == CTRL_Z || ch == CTRL_Y) {
+                undo_step(ch == CTRL_Y);
+                break;
+            }
+            if (ch == CTRL_F) {
+                open_find();
+                break;
+            }
+            if (ch < 32 || ch == 127) break;
+            if (ch > 127) {
+                // A byte of a UTF-8 character; never part of a name.
+                insert_char((char)ch);
+                reset_completion();
+                show_suggestions = 0;
+                break;
+            }
+            
+            int attached = completion_attached();
+            insert_char(ch);
+            
+            if (ch == ' ') {
+                reset_completion();
+                show_suggestions = 0;
+                break;
+            }
+            
+            if (attached) {
+                push_completion((char)ch);
+            } else {
+                seek_completion();
+            }
+            
+            if (isalpha(ch) || ch == '#' || ch == '_') {
+                show_completion();
+            } else {
+                show_suggestions = 0;
+            }
+            break;
+        }
+    }
+    return EDITOR_CONTINUE;
+}
+
+int editor_key(const InputEvent* ev) {
+    unsigned long long edit = profile_stage_total(PROFILE_EDIT);
+    unsigned long long suggest = profile_stage_total(PROFILE_SUGGEST);
+    int rc = handle_key(ev);
+    key_timing.edit_ms = (profile_stage_total(PROFILE_EDIT) - edit) / 1e6;
+    key_timing.suggest_ms = (profile_stage_total(PROFILE_SUGGEST) - suggest) / 1e6;
+    return rc;
+}
@@ -0,0 +1,54 @@
+#ifndef EDITOR_H
+#define EDITOR_H
+
+#include "input.h"
+#include "screen.h"
+
+// The editor without a terminal: it takes key events and draws into
+// `screen`, which the caller sets up with whatever backend it wants. The
+// console loop in Project_Takakatsu.cpp and the replay benchmark both drive
+// it through these calls.
+
+enum {
+    EDITOR_CONTINUE,
+    EDITOR_QUIT
+};
+
+// Where the last editor_key() spent its time: changing the buffer (with
+// everything an edit notifies) and finding completions.
+typedef struct {
+    double edit_ms;
+    double suggest_ms;
+} EditorTiming;
+
+extern Screen screen;
+extern EditorTiming key_timing;
+
+// Maps a dictionary compiled by tools/dictc for completion; call before
+// editor_open(). Returns -1 if the file isn't one.
+int editor_add_dictionary(const char* path);
+
+// Offers the symbols declared under dir and in the system headers for
+// completion, indexed in the background; call before editor_open().
+int editor_index_project(const char* dir);
+
+// Opens path, or program.c when path is NULL, recovering it from its
+// journal if the last session crashed. Returns -1 if there is no buffer.
+int editor_open(const char* path);
+void editor_close();
+
+// Returns EDITOR_QUIT once the user asks to leave.
+int editor_key(const InputEvent* ev);
+void editor_render();
+
+// Picks up finished builds and checks; returns 1 if the screen is stale.
+int editor_update();
+
+// How long the caller may wait for input before calling editor_idle().
+int editor_timeout();
+
+// Background work for when no key arrived in time; returns 1 if the
+// screen is stale.
+int editor_idle();
+
+#endif
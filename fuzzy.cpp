@@ -0,0 +1,492 @@
+#include "fuzzy.h"
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define FUZZY_SSE2 1
+#endif
+
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+#include <immintrin.h>
+#define FUZZY_AVX2 1
+#ifdef _MSC_VER
+#include <intrin.h>
+#define FUZZY_TARGET_AVX2
+#else
+#define FUZZY_TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+#endif
+
+// Candidates are filtered this many at a time, so the survivor list stays
+// on the stack and in L1.
+#define FUZZY_BLOCK 4096
+
+#define SCORE_MATCH 16
+#define SCORE_GAP_START -3
+#define SCORE_GAP_EXTENSION -1
+#define BONUS_BOUNDARY 8
+#define BONUS_CAMEL 7
+#define BONUS_CONSECUTIVE 4
+#define BONUS_FIRST_CHAR_MULTIPLIER 2
+#define SCORE_NONE (-(1 << 20))
+
+enum {
+    CLASS_OTHER,
+    CLASS_LOWER,
+    CLASS_UPPER,
+    CLASS_DIGIT
+};
+
+static int active_kernel = -1;
+
+static int lowest_bit(unsigned int mask) {
+#ifdef _MSC_VER
+    unsigned long index;
+    _BitScanForward(&index, mask);
+    return (int)index;
+#else
+    return __builtin_ctz(mask);
+#endif
+}
+
+// Letters fold to one bit each; the rarer classes share bits, which only
+// lets a few extra candidates through to the exact check.
+static unsigned int char_bit(unsigned char c) {
+    if (c >= 'A' && c <= 'Z') c += 'a' - 'A';
+    if (c >= 'a' && c <= 'z') return 1u << (c - 'a');
+    if (c >= '0' && c <= '9') return 1u << (26 + (c - '0') % 3);
+    if (c == '_') return 1u << 29;
+    if (c < 128) return 1u << 30;
+    return 1u << 31;
+}
+
+static unsigned int mask_of(const char* s, int length) {
+    unsigned int mask = 0;
+    for (int i = 0; i < length; i++) mask |= char_bit((unsigned char)s[i]);
+    return mask;
+}
+
+static int char_class(char c) {
+    if (c >= 'a' && c <= 'z') return CLASS_LOWER;
+    if (c >= 'A' && c <= 'Z') return CLASS_UPPER;
+    if (c >= '0' && c <= '9') return CLASS_DIGIT;
+    return CLASS_OTHER;
+}
+
+static int bonus_at(const char* word, int i) {
+    if (i == 0) return BONUS_BOUNDARY;
+    int prev = char_class(word[i - 1]);
+    int cur = char_class(word[i]);
+    if (prev == CLASS_OTHER && cur != CLASS_OTHER) return BONUS_BOUNDARY;
+    if (prev == CLASS_LOWER && cur == CLASS_UPPER) return BONUS_CAMEL;
+    if (prev != CLASS_DIGIT && cur == CLASS_DIGIT) return BONUS_CAMEL;
+    return 0;
+}
+
+// Characters that earn a position bonus somewhere in word.
+static unsigned int bonus_mask_of(const char* word, int length) {
+    unsigned int mask = 0;
+    for (int i = 0; i < length; i++) {
+        if (bonus_at(word, i)) mask |= char_bit((unsigned char)word[i]);
+    }
+    return mask;
+}
+
+static int max_int(int a, int b) {
+    return a > b ? a : b;
+}
+
+// A compiled query: for every byte, the set of query positions it matches.
+// Case-insensitive queries list both cases of each letter.
+typedef struct {
+    unsigned int positions[256];
+    int length;
+} Pattern;
+
+static void compile(Pattern* p, const char* query, int length) {
+    int exact = 0;
+    for (int j = 0; j < length; j++) {
+        if (query[j] >= 'A' && query[j] <= 'Z') exact = 1;
+    }
+
+    memset(p->positions, 0, sizeof(p->positions));
+    p->length = length;
+    for (int j = 0; j < length; j++) {
+        unsigned char c = (unsigned char)query[j];
+        p->positions[c] |= 1u << j;
+        if (!exact && c >= 'a' && c <= 'z') p->positions[c - 'a' + 'A'] |= 1u << j;
+    }
+}
+
+// Best alignment score by dynamic programming over the positions where a
+// query character matches. cur[j]/prev[j] hold the score with query[j]
+// matched at this/the previous position; reach[j] the best earlier match
+// of query[j] normalized so the gap penalty up to any later position is a
+// single addition. Only matching cells are visited.
+static int score_pattern(const Pattern* p, const char* word, int length) {
+    int m = p->length;
+    unsigned int done = 1u << (m - 1);
+    int first = -1;
+    int j = 0;
+    for (int i = 0; i < length && j < m; i++) {
+        if (p->positions[(unsigned char)word[i]] & (1u << j)) {
+            if (j == 0) first = i;
+            j++;
+        }
+    }
+    if (j < m) return -1;
+
+    int rows[2][FUZZY_MAX_QUERY];
+    int reach[FUZZY_MAX_QUERY];
+    unsigned int reach_mask = 0;
+    int* prev = rows[0];
+    int* cur = rows[1];
+    unsigned int prev_mask = 0;
+    int best = SCORE_NONE;
+
+    for (int i = first; i < length; i++) {
+        unsigned int js = p->positions[(unsigned char)word[i]];
+        unsigned int cur_mask = 0;
+        if (js) {
+            int bonus = bonus_at(word, i);
+            while (js) {
+                j = lowest_bit(js);
+                js &= js - 1;
+                int score;
+                if (j == 0) {
+                    score = SCORE_MATCH + bonus * BONUS_FIRST_CHAR_MULTIPLIER;
+                } else {
+                    unsigned int need = 1u << (j - 1);
+                    int from = SCORE_NONE;
+                    if (prev_mask & need) from = prev[j - 1] + BONUS_CONSECUTIVE;
+                    if (reach_mask & need) {
+                        from = max_int(from, reach[j - 1] + SCORE_GAP_START +
+                                             SCORE_GAP_EXTENSION * (i - 2));
+                    }
+                    if (from == SCORE_NONE) continue;
+                    score = from + SCORE_MATCH + bonus;
+                }
+                cur[j] = score;
+                cur_mask |= 1u << j;
+            }
+            if ((cur_mask & done) && cur[m - 1] > best) best = cur[m - 1];
+        }
+
+        // Matches at i - 1 become gap starts from i + 1 on.
+        for (unsigned int bits = prev_mask; bits; bits &= bits - 1) {
+            j = lowest_bit(bits);
+            int normalized = prev[j] - SCORE_GAP_EXTENSION * (i - 1);
+            if (!(reach_mask & (1u << j)) || normalized > reach[j]) reach[j] = normalized;
+            reach_mask |= 1u << j;
+        }
+        int* swap = prev;
+        prev = cur;
+        cur = swap;
+        prev_mask = cur_mask;
+    }
+    return best > SCORE_NONE / 2 ? best : -1;
+}
+
+int fuzzy_score(const char* word, int length, const char* query, int query_length) {
+    if (query_length <= 0) return 0;
+    if (query_length > FUZZY_MAX_QUERY || query_length > length) return -1;
+
+    Pattern p;
+    compile(&p, query, query_length);
+    return score_pattern(&p, word, length);
+}
+
+// What a candidate must have to be worth scoring: every character class of
+// the query, and once the result list is full, enough of the query's
+// characters at word starts to beat its last entry. weights[k] is the bonus
+// a candidate gains when its bonus mask has bits[k].
+typedef struct {
+    unsigned int mask;
+    int bit_count;
+    unsigned int bits[32];
+    int weights[32];
+    int needed;
+} Filter;
+
+static int filter_weight(const Filter* f, unsigned int bonus_mask) {
+    int sum = 0;
+    for (int k = 0; k < f->bit_count; k++) {
+        if (bonus_mask & f->bits[k]) sum += f->weights[k];
+    }
+    return sum;
+}
+
+// Each filter writes the indexes in [from, to) that pass f.
+
+static unsigned int filter_scalar(const FuzzyIndex* index, unsigned int from,
+                                  unsigned int to, const Filter* f, unsigned int* out) {
+    unsigned int n = 0;
+    for (unsigned int i = from; i < to; i++) {
+        if ((index->masks[i] & f->mask) != f->mask) continue;
+        if (f->needed > 0 && filter_weight(f, index->bonus_masks[i]) < f->needed) continue;
+        out[n++] = i;
+    }
+    return n;
+}
+
+#ifdef FUZZY_SSE2
+static unsigned int filter_sse2(const FuzzyIndex* index, unsigned int from,
+                                unsigned int to, const Filter* f, unsigned int* out) {
+    unsigned int n = 0;
+    unsigned int i = from;
+    const __m128i q = _mm_set1_epi32((int)f->mask);
+    const __m128i floor = _mm_set1_epi32(f->needed - 1);
+    for (; i + 4 <= to; i += 4) {
+        __m128i m = _mm_load_si128((const __m128i*)(index->masks + i));
+        __m128i hit = _mm_cmpeq_epi32(_mm_and_si128(m, q), q);
+        if (_mm_movemask_epi8(hit) == 0) continue;
+
+        if (f->needed > 0) {
+            __m128i bonus = _mm_loadu_si128((const __m128i*)(index->bonus_masks + i));
+            __m128i sum = _mm_setzero_si128();
+            for (int k = 0; k < f->bit_count; k++) {
+                __m128i bit = _mm_set1_epi32((int)f->bits[k]);
+                __m128i has = _mm_cmpeq_epi32(_mm_and_si128(bonus, bit), bit);
+                sum = _mm_add_epi32(sum, _mm_and_si128(has, _mm_set1_epi32(f->weights[k])));
+            }
+            hit = _mm_and_si128(hit, _mm_cmpgt_epi32(sum, floor));
+        }
+
+        unsigned int bits = (unsigned int)_mm_movemask_ps(_mm_castsi128_ps(hit));
+        while (bits) {
+            out[n++] = i + lowest_bit(bits);
+            bits &= bits - 1;
+        }
+    }
+    return n + filter_scalar(index, i, to, f, out + n);
+}
+#endif
+
+#ifdef FUZZY_AVX2
+FUZZY_TARGET_AVX2
+static unsigned int filter_avx2(const FuzzyIndex* index, unsigned int from,
+                                unsigned int to, const Filter* f, unsigned int* out) {
+    unsigned int n = 0;
+    unsigned int i = from;
+    const __m256i q = _mm256_set1_epi32((int)f->mask);
+    const __m256i floor = _mm256_set1_epi32(f->needed - 1);
+    for (; i + 8 <= to; i += 8) {
+        __m256i m = _mm256_load_si256((const __m256i*)(index->masks + i));
+        __m256i hit = _mm256_cmpeq_epi32(_mm256_and_si256(m, q), q);
+        if (_mm256_testz_si256(hit, hit)) continue;
+
+        if (f->needed > 0) {
+            __m256i bonus = _mm256_loadu_si256((const __m256i*)(index->bonus_masks + i));
+            __m256i sum = _mm256_setzero_si256();
+            for (int k = 0; k < f->bit_count; k++) {
+                __m256i bit = _mm256_set1_epi32((int)f->bits[k]);
+                __m256i has = _mm256_cmpeq_epi32(_mm256_and_si256(bonus, bit), bit);
+                sum = _mm256_add_epi32(sum, _mm256_and_si256(has, _mm256_set1_epi32(f->weights[k])));
+            }
+            hit = _mm256_and_si256(hit, _mm256_cmpgt_epi32(sum, floor));
+        }
+
+        unsigned int bits = (unsigned int)_mm256_movemask_ps(_mm256_castsi256_ps(hit));
+        while (bits) {
+            out[n++] = i + lowest_bit(bits);
+            bits &= bits - 1;
+        }
+    }
+    return n + filter_scalar(index, i, to, f, out + n);
+}
+#endif
+
+static int detect_kernel() {
+#ifdef FUZZY_AVX2
+#ifdef _MSC_VER
+    int info[4];
+    __cpuid(info, 0);
+    if (info[0] >= 7) {
+        __cpuid(info, 1);
+        int osxsave = (info[2] >> 27) & 1;
+        int avx = (info[2] >> 28) & 1;
+        if (osxsave && avx && (_xgetbv(0) & 6) == 6) {
+            __cpuidex(info, 7, 0);
+            if (info[1] & (1 << 5)) return FUZZY_KERNEL_AVX2;
+        }
+    }
+#else
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) return FUZZY_KERNEL_AVX2;
+#endif
+#endif
+#ifdef FUZZY_SSE2
+    return FUZZY_KERNEL_SSE2;
+#else
+    return FUZZY_KERNEL_SCALAR;
+#endif
+}
+
+int fuzzy_kernel() {
+    if (active_kernel < 0) active_kernel = detect_kernel();
+    return active_kernel;
+}
+
+void fuzzy_set_kernel(int kernel) {
+    int supported = detect_kernel();
+    active_kernel = kernel < supported ? kernel : supported;
+}
+
+static unsigned int filter(const FuzzyIndex* index, unsigned int from, unsigned int to,
+                           const Filter* f, unsigned int* out) {
+    switch (fuzzy_kernel()) {
+#ifdef FUZZY_AVX2
+        case FUZZY_KERNEL_AVX2: return filter_avx2(index, from, to, f, out);
+#endif
+#ifdef FUZZY_SSE2
+        case FUZZY_KERNEL_SSE2: return filter_sse2(index, from, to, f, out);
+#endif
+    }
+    return filter_scalar(index, from, to, f, out);
+}
+
+FuzzyIndex* fuzzy_create() {
+    return (FuzzyIndex*)calloc(1, sizeof(FuzzyIndex));
+}
+
+void fuzzy_free(FuzzyIndex* index) {
+    if (!index) return;
+    free(index->mask_block);
+    free(index->bonus_masks);
+    free(index->lengths);
+    free(index->offsets);
+    free(index->text);
+    free(index);
+}
+
+// The mask array is the one the kernels stream, so it is kept 64-byte aligned
+// and moved by hand rather than with realloc.
+static int grow_candidates(FuzzyIndex* f, unsigned int capacity) {
+    void* block = malloc((size_t)capacity * sizeof(unsigned int) + 63);
+    if (!block) return -1;
+    unsigned int* masks = (unsigned int*)(((uintptr_t)block + 63) & ~(uintptr_t)63);
+    if (f->count) memcpy(masks, f->masks, f->count * sizeof(unsigned int));
+
+    unsigned char* lengths = (unsigned char*)realloc(f->lengths, capacity);
+    if (lengths) f->lengths = lengths;
+    unsigned int* offsets = (unsigned int*)realloc(f->offsets, capacity * sizeof(unsigned int));
+    if (offsets) f->offsets = offsets;
+    unsigned int* bonus_masks = (unsigned int*)realloc(f->bonus_masks,
+                                                       capacity * sizeof(unsigned int));
+    if (bonus_masks) f->bonus_masks = bonus_masks;
+    if (!lengths || !offsets || !bonus_masks) {
+        free(block);
+        return -1;
+    }
+
+    free(f->mask_block);
+    f->mask_block = block;
+    f->masks = masks;
+    f->capacity = capacity;
+    return 0;
+}
+
+int fuzzy_add(FuzzyIndex* index, const char* word) {
+    size_t length = strlen(word);
+    if (length == 0 || length > FUZZY_MAX_WORD) return -1;
+
+    if (index->count == index->capacity &&
+        grow_candidates(index, index->capacity ? index->capacity * 2 : 1024) != 0) {
+        return -1;
+    }
+    if (index->text_length + length + 1 > index->text_capacity) {
+        unsigned int cap = index->text_capacity ? index->text_capacity : 16384;
+        while (cap < index->text_length + length + 1) cap *= 2;
+        char* grown = (char*)realloc(index->text, cap);
+        if (!grown) return -1;
+        index->text = grown;
+        index->text_capacity = cap;
+    }
+
+    memcpy(index->text + index->text_length, word, length + 1);
+    index->masks[index->count] = mask_of(word, (int)length);
+    index->bonus_masks[index->count] = bonus_mask_of(word, (int)length);
+    index->lengths[index->count] = (unsigned char)length;
+    index->offsets[index->count] = index->text_length;
+    index->text_length += (unsigned int)length + 1;
+    index->count++;
+    return 0;
+}
+
+static int match_before(const FuzzyMatch* a, const FuzzyMatch* b) {
+    if (a->score != b->score) return a->score > b->score;
+    if (a->length != b->length) return a->length < b->length;
+    return strcmp(a->word, b->word) < 0;
+}
+
+int fuzzy_match(const FuzzyIndex* index, const char* query, FuzzyMatch* out, int max) {
+    int query_length = (int)strlen(query);
+    if (!index || max <= 0 || query_length == 0 || query_length > FUZZY_MAX_QUERY) return 0;
+
+    Pattern pattern;
+    compile(&pattern, query, query_length);
+    unsigned int survivors[FUZZY_BLOCK];
+    int count = 0;
+
+    // Best conceivable score: every character matched consecutively, plus
+    // the position bonus of each query character the candidate has at a
+    // word start.
+    int base = query_length * SCORE_MATCH + (query_length - 1) * BONUS_CONSECUTIVE;
+    int weights[32];
+    memset(weights, 0, sizeof(weights));
+    for (int j = 0; j < query_length; j++) {
+        int bit = lowest_bit(char_bit((unsigned char)query[j]));
+        weights[bit] += BONUS_BOUNDARY * (j == 0 ? BONUS_FIRST_CHAR_MULTIPLIER : 1);
+    }
+
+    Filter f;
+    f.mask = mask_of(query, query_length);
+    f.bit_count = 0;
+    f.needed = 0;
+    for (int bit = 0; bit < 32; bit++) {
+        if (!weights[bit]) continue;
+        f.bits[f.bit_count] = 1u << bit;
+        f.weights[f.bit_count++] = weights[bit];
+    }
+
+    for (unsigned int from = 0; from < index->count; from += FUZZY_BLOCK) {
+        unsigned int to = index->count - from > FUZZY_BLOCK ? from + FUZZY_BLOCK : index->count;
+        if (count == max) f.needed = out[max - 1].score - base;
+        unsigned int n = filter(index, from, to, &f, survivors);
+
+        for (unsigned int k = 0; k < n; k++) {
+            unsigned int i = survivors[k];
+            if (index->lengths[i] < query_length) continue;
+
+            if (count == max) {
+                int bound = base + filter_weight(&f, index->bonus_masks[i]);
+                const FuzzyMatch* last = &out[max - 1];
+                if (bound < last->score) continue;
+                if (bound == last->score && index->lengths[i] > last->length) continue;
+            }
+
+            FuzzyMatch m;
+            m.word = index->text + index->offsets[i];
+            m.length = index->lengths[i];
+            m.score = score_pattern(&pattern, m.word, m.length);
+            if (m.score < 0) continue;
+
+            int pos = count;
+            if (count == max) {
+                if (!match_before(&m, &out[max - 1])) continue;
+                pos--;
+            } else {
+                count++;
+            }
+            while (pos > 0 && match_before(&m, &out[pos - 1])) {
+                out[pos] = out[pos - 1];
+                pos--;
+            }
+            out[pos] = m;
+        }
+    }
+    return count;
+}
@@ -0,0 +1,60 @@
+#ifndef FUZZY_H
+#define FUZZY_H
+
+#include <stddef.h>
+
+// Subsequence matcher in the style of fzf: "prf" matches "printf", with
+// bonuses for matches at word starts, after '_' and on camelCase humps.
+//
+// Candidates are kept column-wise. Each one has a 32-bit mask of the
+// character classes it contains, stored in a 64-byte aligned array, so a
+// query first rejects candidates missing any of its characters eight (AVX2)
+// or four (SSE2) at a time. A second mask of the characters that start a
+// word bounds the best score a survivor could reach, and only survivors
+// that could still enter the current top list are scored.
+
+#define FUZZY_MAX_QUERY 32
+#define FUZZY_MAX_WORD 255
+
+enum {
+    FUZZY_KERNEL_SCALAR,
+    FUZZY_KERNEL_SSE2,
+    FUZZY_KERNEL_AVX2
+};
+
+typedef struct {
+    unsigned int* masks;
+    void* mask_block;
+    unsigned int* bonus_masks;
+    unsigned char* lengths;
+    unsigned int* offsets;
+    char* text;
+    unsigned int count;
+    unsigned int capacity;
+    unsigned int text_length;
+    unsigned int text_capacity;
+} FuzzyIndex;
+
+typedef struct {
+    const char* word;
+    int score;
+    int length;
+} FuzzyMatch;
+
+FuzzyIndex* fuzzy_create();
+void fuzzy_free(FuzzyIndex* index);
+int fuzzy_add(FuzzyIndex* index, const char* word);
+
+// Scores word against query, or returns -1 when query is not a subsequence.
+// Matching ignores case unless query contains an uppercase letter.
+int fuzzy_score(const char* word, int length, const char* query, int query_length);
+
+// Fills out with the best max matches, highest score first, ties going to
+// the shorter word. Returns the number of matches written.
+int fuzzy_match(const FuzzyIndex* index, const char* query, FuzzyMatch* out, int max);
+
+// The best kernel the CPU supports is used by default.
+int fuzzy_kernel();
+void fuzzy_set_kernel(int kernel);
+
+#endif
@@ -0,0 +1,404 @@
+#include "harvest.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+#include "input.h"
+#include "profile.h"
+
+// Rebuild the private trie once removed words leave this many dead entries.
+#define HARVEST_COMPACT_SLACK 4096
+#define HARVEST_MAX_RANK 16
+#define HARVEST_RETIRED 4
+// A snapshot copies every live identifier, so changes are published at most
+// this often however fast the batches arrive.
+#define HARVEST_PUBLISH_MS 200
+
+typedef struct HarvestMessage {
+    struct HarvestMessage* next;
+    int delta;
+    size_t length;
+    char* text;
+} HarvestMessage;
+
+// One identifier. count is the number of occurrences in the buffer, rank the
+// priority it currently has in the private trie (0 when absent).
+typedef struct {
+    unsigned int name;
+    unsigned int hash;
+    int count;
+    unsigned char rank;
+    unsigned char dirty;
+    unsigned char used;
+} HarvestSlot;
+
+static std::mutex queue_mutex;
+static std::condition_variable queue_ready;
+static HarvestMessage* queue_head = NULL;
+static HarvestMessage* queue_tail = NULL;
+static int stopping = 0;
+static std::thread worker;
+static int running = 0;
+
+static std::atomic<HarvestSnapshot*> published(NULL);
+static std::atomic<HarvestSnapshot*> hazard(NULL);
+static std::atomic<unsigned int> version(0);
+
+// Worker-private state.
+static HarvestSlot* slots = NULL;
+static unsigned int slot_capacity = 0;
+static unsigned int slot_used = 0;
+static char* names = NULL;
+static unsigned int name_length = 0;
+static unsigned int name_capacity = 0;
+static unsigned int* dirty = NULL;
+static unsigned int dirty_count = 0;
+static unsigned int dirty_capacity = 0;
+static unsigned int live = 0;
+static Trie* master = NULL;
+static HarvestSnapshot* retired[HARVEST_RETIRED];
+static int retired_count = 0;
+
+static unsigned int hash_name(const char* s, int len) {
+    unsigned int h = 2166136261u;
+    for (int i = 0; i < len; i++) {
+        h ^= (unsigned char)s[i];
+        h *= 16777619u;
+    }
+    return h;
+}
+
+static int push_dirty(unsigned int slot) {
+    if (dirty_count == dirty_capacity) {
+        unsigned int cap = dirty_capacity ? dirty_capacity * 2 : 256;
+        unsigned int* grown = (unsigned int*)realloc(dirty, cap * sizeof(unsigned int));
+        if (!grown) return -1;
+        dirty = grown;
+        dirty_capacity = cap;
+    }
+    dirty[dirty_count++] = slot;
+    return 0;
+}
+
+static int rehash(unsigned int capacity) {
+    HarvestSlot* fresh = (HarvestSlot*)calloc(capacity, sizeof(HarvestSlot));
+    if (!fresh) return -1;
+
+    dirty_count = 0;
+    for (unsigned int i = 0; i < slot_capacity; i++) {
+        if (!slots[i].used) continue;
+        unsigned int j = slots[i].hash & (capacity - 1);
+        while (fresh[j].used) j = (j + 1) & (capacity - 1);
+        fresh[j] = slots[i];
+        if (fresh[j].dirty) push_dirty(j);
+    }
+    free(slots);
+    slots = fresh;
+    slot_capacity = capacity;
+    return 0;
+}
+
+static int find_slot(const char* s, int len) {
+    if ((slot_used + 1) * 2 > slot_capacity &&
+        rehash(slot_capacity ? slot_capacity * 2 : 1024) != 0) {
+        return -1;
+    }
+
+    unsigned int h = hash_name(s, len);
+    unsigned int i = h & (slot_capacity - 1);
+    while (slots[i].used) {
+        if (slots[i].hash == h && strncmp(names + slots[i].name, s, len) == 0 &&
+            names[slots[i].name + len] == '\0') {
+            return (int)i;
+        }
+        i = (i + 1) & (slot_capacity - 1);
+    }
+
+    if (name_length + len + 1 > name_capacity) {
+        unsigned int cap = name_capacity ? name_capacity : 65536;
+        while (cap < name_length + len + 1) cap *= 2;
+        char* grown = (char*)realloc(names, cap);
+        if (!grown) return -1;
+        names = grown;
+        name_capacity = cap;
+    }
+    memcpy(names + name_length, s, len);
+    names[name_length + len] = '\0';
+
+    HarvestSlot* slot = &slots[i];
+    memset(slot, 0, sizeof(*slot));
+    slot->name = name_length;
+    slot->hash = h;
+    slot->used = 1;
+    name_length += len + 1;
+    slot_used++;
+    return (int)i;
+}
+
+static void count_identifier(const char* s, int len, int delta) {
+    if (len < HARVEST_MIN_LENGTH || len > HARVEST_MAX_LENGTH) return;
+    int i = find_slot(s, len);
+    if (i < 0) return;
+    slots[i].count += delta;
+    if (!slots[i].dirty && push_dirty((unsigned int)i) == 0) slots[i].dirty = 1;
+}
+
+static int ident_start(char c) {
+    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c == '_';
+}
+
+static int ident_char(char c) {
+    return ident_start(c) || (c >= '0' && c <= '9');
+}
+
+// Counts the identifiers of text, skipping literals, numbers and comments.
+// All state ends at a newline so a line counts the same however the lines
+// around it were batched.
+static void scan(const char* text, size_t length, int delta) {
+    size_t i = 0;
+    while (i < length) {
+        char c = text[i];
+        if (ident_start(c)) {
+            size_t start = i;
+            while (i < length && ident_char(text[i])) i++;
+            count_identifier(text + start, (int)(i - start), delta);
+        } else if (c >= '0' && c <= '9') {
+            while (i < length && ident_char(text[i])) i++;
+        } else if (c == '"' || c == '\'') {
+            i++;
+            while (i < length && text[i] != c && text[i] != '\n') {
+                if (text[i] == '\\' && i + 1 < length && text[i + 1] != '\n') i++;
+                i++;
+            }
+            if (i < length && text[i] == c) i++;
+        } else if (c == '/' && i + 1 < length && text[i + 1] == '/') {
+            while (i < length && text[i] != '\n') i++;
+        } else if (c == '/' && i + 1 < length && text[i + 1] == '*') {
+            i += 2;
+            while (i < length && text[i] != '\n' &&
+                   !(text[i] == '*' && i + 1 < length && text[i + 1] == '/')) {
+                i++;
+            }
+            if (i < length && text[i] == '*') i += 2;
+        } else {
+            i++;
+        }
+    }
+}
+
+static int rank_of(int count) {
+    if (count <= 0) return 0;
+    int rank = 1;
+    while (count > 1 && rank < HARVEST_MAX_RANK) {
+        count >>= 1;
+        rank++;
+    }
+    return rank;
+}
+
+static void compact() {
+    Trie* fresh = create_trie();
+    if (!fresh) return;
+    for (unsigned int i = 0; i < slot_capacity; i++) {
+        if (slots[i].used && slots[i].rank > 0) {
+            trie_insert_weighted(fresh, names + slots[i].name, slots[i].rank);
+        }
+    }
+    free_trie(master);
+    master = fresh;
+}
+
+// Brings the private trie in line with the counts changed since the last
+// flush. Returns nonzero when the trie changed.
+static int flush() {
+    int changed = 0;
+    for (unsigned int d = 0; d < dirty_count; d++) {
+        HarvestSlot* slot = &slots[dirty[d]];
+        slot->dirty = 0;
+        int rank = rank_of(slot->count);
+        if (rank == slot->rank) continue;
+
+        const char* name = names + slot->name;
+        if (slot->rank > 0 && rank < slot->rank) trie_remove(master, name);
+        if (rank > 0) trie_insert_weighted(master, name, rank);
+        if (slot->rank == 0) live++;
+        if (rank == 0) live--;
+        slot->rank = (unsigned char)rank;
+        changed = 1;
+    }
+    dirty_count = 0;
+
+    if (master->entry_count > live * 2 + HARVEST_COMPACT_SLACK) compact();
+    return changed;
+}
+
+static void free_snapshot(HarvestSnapshot* snapshot) {
+    if (!snapshot) return;
+    free_trie(snapshot->trie);
+    fuzzy_free(snapshot->fuzzy);
+    free(snapshot);
+}
+
+static void reclaim() {
+    HarvestSnapshot* pinned = hazard.load();
+    int kept = 0;
+    for (int i = 0; i < retired_count; i++) {
+        if (retired[i] == pinned) retired[kept++] = retired[i];
+        else free_snapshot(retired[i]);
+    }
+    retired_count = kept;
+}
+
+static HarvestSnapshot* make_snapshot() {
+    HarvestSnapshot* snapshot = (HarvestSnapshot*)calloc(1, sizeof(HarvestSnapshot));
+    if (!snapshot) return NULL;
+    snapshot->trie = trie_clone(master);
+    snapshot->fuzzy = fuzzy_create();
+    if (!snapshot->trie || !snapshot->fuzzy) {
+        free_snapshot(snapshot);
+        return NULL;
+    }
+    for (unsigned int i = 0; i < slot_capacity; i++) {
+        if (slots[i].used && slots[i].rank > 0) fuzzy_add(snapshot->fuzzy, names + slots[i].name);
+    }
+    return snapshot;
+}
+
+// The reader pins at most one snapshot, so once reclaimed the retired list
+// never holds more than that one plus the snapshot just replaced.
+static void publish() {
+    HarvestSnapshot* snapshot = make_snapshot();
+    if (!snapshot) return;
+    HarvestSnapshot* old = published.exchange(snapshot);
+    if (old) retired[retired_count++] = old;
+    reclaim();
+    version++;
+    input_wake();
+}
+
+static void free_messages(HarvestMessage* m) {
+    while (m) {
+        HarvestMessage* next = m->next;
+        free(m);
+        m = next;
+    }
+}
+
+// Changes that arrive within HARVEST_PUBLISH_MS of the last publish are
+// held back and go out together once the interval is over.
+static void harvest_main() {
+    profile_thread("harvest");
+    std::chrono::steady_clock::time_point due = std::chrono::steady_clock::now();
+    int unpublished = 0;
+    std::unique_lock<std::mutex> lock(queue_mutex);
+    for (;;) {
+        while (!queue_head && !stopping) {
+            if (!unpublished) queue_ready.wait(lock);
+            else if (queue_ready.wait_until(lock, due) == std::cv_status::timeout) break;
+        }
+        if (stopping) break;
+
+        HarvestMessage* batch = queue_head;
+        queue_head = queue_tail = NULL;
+        lock.unlock();
+
+        {
+            PROFILE_SCOPE(PROFILE_HARVEST);
+            for (HarvestMessage* m = batch; m; m = m->next) {
+                scan(m->text, m->length, m->delta);
+            }
+            free_messages(batch);
+            if (flush()) unpublished = 1;
+
+            std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+            if (unpublished && now >= due) {
+                publish();
+                unpublished = 0;
+                due = now + std::chrono::milliseconds(HARVEST_PUBLISH_MS);
+            }
+        }
+
+        lock.lock();
+    }
+}
+
+int harvest_start() {
+    if (running) return 0;
+    master = create_trie();
+    if (!master) return -1;
+    stopping = 0;
+    worker = std::thread(harvest_main);
+    running = 1;
+    return 0;
+}
+
+void harvest_stop() {
+    if (!running) return;
+    {
+        std::lock_guard<std::mutex> lock(queue_mutex);
+        stopping = 1;
+    }
+    queue_ready.notify_one();
+    worker.join();
+    running = 0;
+
+    free_messages(queue_head);
+    queue_head = queue_tail = NULL;
+    hazard.store(NULL);
+    reclaim();
+    free_snapshot(published.exchange(NULL));
+    free_trie(master);
+    master = NULL;
+    free(slots);
+    free(names);
+    free(dirty);
+    slots = NULL;
+    names = NULL;
+    dirty = NULL;
+    slot_capacity = slot_used = name_length = name_capacity = 0;
+    dirty_count = dirty_capacity = live = 0;
+}
+
+void harvest_text(const TextBuffer* tb, size_t offset, size_t length, int delta) {
+    if (!running || length == 0) return;
+
+    HarvestMessage* m = (HarvestMessage*)malloc(sizeof(HarvestMessage) + length);
+    if (!m) return;
+    m->next = NULL;
+    m->delta = delta;
+    m->text = (char*)(m + 1);
+    m->length = tb_read(tb, offset, length, m->text);
+
+    {
+        std::lock_guard<std::mutex> lock(queue_mutex);
+        if (queue_tail) queue_tail->next = m;
+        else queue_head = m;
+        queue_tail = m;
+    }
+    queue_ready.notify_one();
+}
+
+// Classic hazard pointer handshake: the pin only counts once the snapshot is
+// seen still published after it was set, so the worker cannot have missed it.
+const HarvestSnapshot* harvest_acquire() {
+    HarvestSnapshot* t;
+    do {
+        t = published.load();
+        hazard.store(t);
+    } while (published.load() != t);
+    return t;
+}
+
+void harvest_release() {
+    hazard.store(NULL);
+}
+
+unsigned int harvest_version() {
+    return version.load();
+}
@@ -0,0 +1,43 @@
+#ifndef HARVEST_H
+#define HARVEST_H
+
+#include <stddef.h>
+
+#include "fuzzy.h"
+#include "text_buffer.h"
+#include "trie.h"
+
+// Background identifier index. The editor reports every line region it is
+// about to change (counted out) and the same region once changed (counted
+// in); a worker thread tokenizes them, keeps a reference count per
+// identifier and publishes an immutable completion trie of the identifiers
+// still in use, together with a fuzzy index of the same words. Snapshots go
+// out at most a few times a second, since each copies every identifier. The
+// input thread never waits on the worker: it reads the latest published
+// snapshot through a single hazard pointer.
+
+#define HARVEST_MIN_LENGTH 3
+#define HARVEST_MAX_LENGTH 64
+
+typedef struct {
+    Trie* trie;
+    FuzzyIndex* fuzzy;
+} HarvestSnapshot;
+
+int harvest_start();
+void harvest_stop();
+
+// Queues a copy of the text in [offset, offset + length) with delta +1 when
+// the lines were added and -1 when they are about to be removed.
+void harvest_text(const TextBuffer* tb, size_t offset, size_t length, int delta);
+
+// Returns the latest published snapshot, or NULL before the first publish.
+// It stays valid until the next harvest_acquire() or harvest_release().
+// Only one thread may act as the reader.
+const HarvestSnapshot* harvest_acquire();
+void harvest_release();
+
+// Number of snapshots published so far, for noticing that a newer one exists.
+unsigned int harvest_version();
+
+#endif
@@ -0,0 +1,416 @@
+#include "highlight.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+static const char* keywords[] = {
+    "auto", "break", "case", "const", "continue", "default", "do", "else",
+    "enum", "extern", "for", "goto", "if", "inline", "register", "restrict",
+    "return", "sizeof", "static", "struct", "switch", "typedef", "union",
+    "volatile", "while", NULL
+};
+
+static const char* types[] = {
+    "FILE", "_Bool", "bool", "char", "double", "float", "int", "long",
+    "short", "signed", "unsigned", "void", NULL
+};
+
+static const char* constants[] = {
+    "EOF", "NULL", "false", "true", NULL
+};
+
+// Entry states live in a gap array: states[0, gap_start) are lines before
+// the gap, states[gap_end, capacity) the lines after it. Edits cluster, so
+// moving the gap is usually short.
+
+static int line_count(const Highlighter* h) {
+    return h->capacity - (h->gap_end - h->gap_start);
+}
+
+static unsigned char* state_at(Highlighter* h, int line) {
+    return &h->states[line < h->gap_start ? line : line + (h->gap_end - h->gap_start)];
+}
+
+static void move_gap(Highlighter* h, int pos) {
+    int gap = h->gap_end - h->gap_start;
+    if (pos < h->gap_start) {
+        memmove(h->states + pos + gap, h->states + pos, h->gap_start - pos);
+    } else if (pos > h->gap_start) {
+        memmove(h->states + h->gap_start, h->states + h->gap_end, pos - h->gap_start);
+    }
+    h->gap_start = pos;
+    h->gap_end = pos + gap;
+}
+
+static int insert_states(Highlighter* h, int pos, int count) {
+    move_gap(h, pos);
+    if (h->gap_end - h->gap_start < count) {
+        int tail = h->capacity - h->gap_end;
+        int cap = h->capacity ? h->capacity : 1024;
+        while (cap - tail - h->gap_start < count) cap *= 2;
+        unsigned char* grown = (unsigned char*)realloc(h->states, cap);
+        if (!grown) return -1;
+        memmove(grown + cap - tail, grown + h->gap_end, tail);
+        h->states = grown;
+        h->gap_end = cap - tail;
+        h->capacity = cap;
+    }
+    memset(h->states + h->gap_start, LEX_NORMAL, count);
+    h->gap_start += count;
+    return 0;
+}
+
+static void remove_states(Highlighter* h, int pos, int count) {
+    move_gap(h, pos);
+    h->gap_end += count;
+}
+
+int hl_init(Highlighter* h) {
+    memset(h, 0, sizeof(*h));
+    for (int i = 0; i < HL_RESTART_SLOTS; i++) h->restarts[i].line = -1;
+    if (insert_states(h, 0, 1) != 0) return -1;
+    h->lexed = 1;
+    return 0;
+}
+
+void hl_free(Highlighter* h) {
+    for (int i = 0; i < HL_RESTART_SLOTS; i++) free(h->restarts[i].offsets);
+    free(h->states);
+    free(h->scratch);
+    memset(h, 0, sizeof(*h));
+}
+
+// Lines in [dirty_from, dirty_to) changed since they were lexed; the entry
+// state of dirty_from is still right. Past dirty_to the text is unchanged,
+// so relexing can stop at the first line whose cached entry state matches.
+void hl_edit(Highlighter* h, int first, size_t offset, int removed, int inserted) {
+    int count = line_count(h);
+    if (first < 0 || first >= count) return;
+    if (removed > count - 1 - first) removed = count - 1 - first;
+
+    for (int i = 0; i < HL_RESTART_SLOTS; i++) {
+        HlRestarts* r = &h->restarts[i];
+        if (r->line < first) continue;
+        if (r->line == first) {
+            // A token start before the first changed byte depends only on
+            // the bytes before it.
+            if (r->valid_to > offset) r->valid_to = offset;
+            r->complete = 0;
+        } else if (r->line <= first + removed) {
+            r->line = -1;
+        } else {
+            r->line += inserted - removed;
+        }
+    }
+
+    remove_states(h, first + 1, removed);
+    insert_states(h, first + 1, inserted);
+
+    int delta = inserted - removed;
+    if (h->lexed > first + 1) {
+        h->lexed = h->lexed + delta > first + 1 ? h->lexed + delta : first + 1;
+    }
+    if (first >= h->lexed) return;
+
+    int to = first + inserted + 1;
+    if (h->dirty_from < h->dirty_to) {
+        int old_to = h->dirty_to > first + removed + 1 ? h->dirty_to + delta : h->dirty_to;
+        if (h->dirty_from > first) h->dirty_from = first;
+        h->dirty_to = old_to > to ? old_to : to;
+    } else {
+        h->dirty_from = first;
+        h->dirty_to = to;
+    }
+}
+
+static int lex(const char* text, size_t length, int state, unsigned char* classes,
+               HlRestarts* r, size_t base);
+
+static int read_scratch(Highlighter* h, const TextBuffer* tb, size_t offset, size_t length) {
+    if (length > h->scratch_capacity) {
+        size_t cap = h->scratch_capacity ? h->scratch_capacity : 1024;
+        while (cap < length) cap *= 2;
+        char* grown = (char*)realloc(h->scratch, cap);
+        if (!grown) return -1;
+        h->scratch = grown;
+        h->scratch_capacity = cap;
+    }
+    tb_read(tb, offset, length, h->scratch);
+    return 0;
+}
+
+static HlRestarts* find_restarts(Highlighter* h, int line) {
+    for (int i = 0; i < HL_RESTART_SLOTS; i++) {
+        if (h->restarts[i].line == line) return &h->restarts[i];
+    }
+    return NULL;
+}
+
+static HlRestarts* take_restarts(Highlighter* h, int line) {
+    HlRestarts* r = find_restarts(h, line);
+    if (!r) {
+        r = &h->restarts[0];
+        for (int i = 1; i < HL_RESTART_SLOTS; i++) {
+            if (h->restarts[i].used < r->used) r = &h->restarts[i];
+        }
+        r->line = line;
+        r->count = 0;
+        r->valid_to = 0;
+        r->complete = 0;
+    }
+    r->used = ++h->restart_tick;
+    return r;
+}
+
+static int lex_line(Highlighter* h, const TextBuffer* tb, int line, int state) {
+    size_t length = tb_line_length(tb, line);
+    size_t start = tb_line_start(tb, line);
+    h->lines_lexed++;
+    if (length <= HL_RESTART_STRIDE) {
+        if (read_scratch(h, tb, start, length) != 0) return LEX_NORMAL;
+        return hl_lex(h->scratch, length, state, NULL);
+    }
+
+    HlRestarts* r = take_restarts(h, line);
+    if (r->entry_state != state) {
+        r->entry_state = state;
+        r->count = 0;
+        r->valid_to = 0;
+        r->complete = 0;
+    }
+    if (r->complete) return r->end_state;
+
+    while (r->count > 0 && r->offsets[r->count - 1] >= r->valid_to) r->count--;
+    size_t from = r->count > 0 ? r->offsets[r->count - 1] : 0;
+    if (read_scratch(h, tb, start + from, length - from) != 0) {
+        r->line = -1;
+        return LEX_NORMAL;
+    }
+    r->end_state = lex(h->scratch, length - from, from > 0 ? LEX_NORMAL : state, NULL, r, from);
+    r->valid_to = length;
+    r->complete = 1;
+    return r->end_state;
+}
+
+int hl_entry_state(Highlighter* h, const TextBuffer* tb, int line) {
+    // Lazily indexed files only ever grow at the end.
+    int total = tb_line_count(tb);
+    int count = line_count(h);
+    if (total > count) hl_edit(h, count - 1, 0, 0, total - count);
+    else if (total < count) hl_edit(h, 0, 0, count - 1, total - 1);
+    if (line < 0) return LEX_NORMAL;
+    if (line >= total) line = total - 1;
+
+    if (h->dirty_from < h->dirty_to && line > h->dirty_from) {
+        int l = h->dirty_from;
+        int state = *state_at(h, l);
+        int converged = 0;
+        while (l < line) {
+            state = lex_line(h, tb, l, state);
+            l++;
+            if (l >= h->dirty_to && l < h->lexed && *state_at(h, l) == state) {
+                converged = 1;
+                break;
+            }
+            *state_at(h, l) = (unsigned char)state;
+            if (l >= h->lexed) h->lexed = l + 1;
+        }
+        if (converged) {
+            h->dirty_from = h->dirty_to = 0;
+        } else {
+            h->dirty_from = l;
+            if (h->dirty_to < l + 1) h->dirty_to = l + 1;
+        }
+    }
+
+    while (h->lexed <= line) {
+        int state = lex_line(h, tb, h->lexed - 1, *state_at(h, h->lexed - 1));
+        *state_at(h, h->lexed) = (unsigned char)state;
+        h->lexed++;
+    }
+    return *state_at(h, line);
+}
+
+static int ident_start(char c) {
+    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c == '_';
+}
+
+static int ident_char(char c) {
+    return ident_start(c) || (c >= '0' && c <= '9');
+}
+
+static int in_list(const char** list, const char* word, size_t length) {
+    for (int i = 0; list[i]; i++) {
+        if (strncmp(list[i], word, length) == 0 && list[i][length] == '\0') return 1;
+    }
+    return 0;
+}
+
+static int classify(const char* text, size_t length, size_t start, size_t end) {
+    const char* word = text + start;
+    size_t n = end - start;
+    if (in_list(keywords, word, n)) return HL_KEYWORD;
+    if (in_list(types, word, n)) return HL_TYPE;
+    if (n > 2 && word[n - 2] == '_' && word[n - 1] == 't') return HL_TYPE;
+    if (in_list(constants, word, n)) return HL_NUMBER;
+
+    while (end < length && (text[end] == ' ' || text[end] == '\t')) end++;
+    return (end < length && text[end] == '(') ? HL_FUNCTION : HL_PLAIN;
+}
+
+// A backslash before the line end continues strings and // comments.
+static int continues(const char* text, size_t length) {
+    if (length > 0 && text[length - 1] == '\r') length--;
+    return length > 0 && text[length - 1] == '\\';
+}
+
+static void mark(unsigned char* classes, size_t from, size_t to, int cls) {
+    if (classes && to > from) memset(classes + from, cls, to - from);
+}
+
+// Scans a literal from i, just past its opening quote, to just past its
+// closing one or the line end.
+static size_t scan_literal(const char* text, size_t length, size_t i, char quote, int* closed) {
+    *closed = 0;
+    while (i < length) {
+        if (text[i] == '\\') {
+            i += 2;
+        } else if (text[i++] == quote) {
+            *closed = 1;
+            return i;
+        }
+    }
+    return length;
+}
+
+static void add_restart(HlRestarts* r, size_t offset) {
+    if (r->count == r->capacity) {
+        int cap = r->capacity ? r->capacity * 2 : 64;
+        size_t* grown = (size_t*)realloc(r->offsets, cap * sizeof(size_t));
+        if (!grown) return;
+        r->offsets = grown;
+        r->capacity = cap;
+    }
+    r->offsets[r->count++] = offset;
+}
+
+// Records restart points in r, when given, a stride or more apart; text
+// starts base bytes into the line.
+static int lex(const char* text, size_t length, int state, unsigned char* classes,
+               HlRestarts* r, size_t base) {
+    size_t i = 0;
+    size_t next_restart = HL_RESTART_STRIDE;
+    int closed;
+
+    if (state == LEX_LINE_COMMENT) {
+        mark(classes, 0, length, HL_COMMENT);
+        return continues(text, length) ? LEX_LINE_COMMENT : LEX_NORMAL;
+    }
+    if (state == LEX_STRING) {
+        i = scan_literal(text, length, 0, '"', &closed);
+        mark(classes, 0, i, HL_STRING);
+        if (!closed) return continues(text, length) ? LEX_STRING : LEX_NORMAL;
+    }
+    if (state == LEX_COMMENT) {
+        while (i + 1 < length && !(text[i] == '*' && text[i + 1] == '/')) i++;
+        if (i + 1 >= length) {
+            mark(classes, 0, length, HL_COMMENT);
+            return LEX_COMMENT;
+        }
+        i += 2;
+        mark(classes, 0, i, HL_COMMENT);
+    }
+
+    int line_start = (state == LEX_NORMAL);
+    while (i < length) {
+        char c = text[i];
+        size_t start = i;
+
+        // Lexing afresh from here must not take the token for the first
+        // on the line, where '#' starts a directive.
+        if (r && i >= next_restart && c != ' ' && c != '\t' && c != '#') {
+            add_restart(r, base + i);
+            next_restart = i + HL_RESTART_STRIDE;
+        }
+
+        if (c == '/' && i + 1 < length && text[i + 1] == '*') {
+            i += 2;
+            while (i + 1 < length && !(text[i] == '*' && text[i + 1] == '/')) i++;
+            if (i + 1 >= length) {
+                mark(classes, start, length, HL_COMMENT);
+                return LEX_COMMENT;
+            }
+            i += 2;
+            mark(classes, start, i, HL_COMMENT);
+        } else if (c == '/' && i + 1 < length && text[i + 1] == '/') {
+            mark(classes, start, length, HL_COMMENT);
+            return continues(text, length) ? LEX_LINE_COMMENT : LEX_NORMAL;
+        } else if (c == '"' || c == '\'') {
+            i = scan_literal(text, length, i + 1, c, &closed);
+            mark(classes, start, i, HL_STRING);
+            if (!closed && c == '"' && continues(text, length)) return LEX_STRING;
+        } else if (c == '#' && line_start) {
+            i++;
+            while (i < length && (text[i] == ' ' || text[i] == '\t')) i++;
+            size_t word = i;
+            while (i < length && ident_char(text[i])) i++;
+            mark(classes, start, i, HL_PREPROC);
+            if (i - word == 7 && strncmp(text + word, "include", 7) == 0) {
+                while (i < length && (text[i] == ' ' || text[i] == '\t')) i++;
+                if (i < length && text[i] == '<') {
+                    start = i;
+                    while (i < length && text[i] != '>') i++;
+                    if (i < length) i++;
+                    mark(classes, start, i, HL_STRING);
+                }
+            }
+        } else if ((c >= '0' && c <= '9') ||
+                   (c == '.' && i + 1 < length && text[i + 1] >= '0' && text[i + 1] <= '9')) {
+            while (i < length && (ident_char(text[i]) || text[i] == '.' ||
+                   ((text[i] == '+' || text[i] == '-') &&
+                    (text[i - 1] == 'e' || text[i - 1] == 'E' ||
+                     text[i - 1] == 'p' || text[i - 1] == 'P')))) {
+                i++;
+            }
+            mark(classes, start, i, HL_NUMBER);
+        } else if (ident_start(c)) {
+            while (i < length && ident_char(text[i])) i++;
+            if (classes) mark(classes, start, i, classify(text, length, start, i));
+        } else {
+            i++;
+            mark(classes, start, i, HL_PLAIN);
+        }
+
+        if (c != ' ' && c != '\t') line_start = 0;
+    }
+    return LEX_NORMAL;
+}
+
+int hl_lex(const char* text, size_t length, int state, unsigned char* classes) {
+    return lex(text, length, state, classes, NULL, 0);
+}
+
+int hl_restart(Highlighter* h, const TextBuffer* tb, int line, size_t offset, size_t* from) {
+    int state = hl_entry_state(h, tb, line);
+    *from = 0;
+    if (tb_line_length(tb, line) <= HL_RESTART_STRIDE) return state;
+
+    HlRestarts* r = find_restarts(h, line);
+    if (!r || !r->complete || r->entry_state != state) {
+        lex_line(h, tb, line, state);
+        r = find_restarts(h, line);
+        if (!r) return state;
+    }
+    r->used = ++h->restart_tick;
+    int lo = 0, hi = r->count - 1;
+    while (lo <= hi) {
+        int mid = (lo + hi) / 2;
+        if (r->offsets[mid] <= offset) {
+            *from = r->offsets[mid];
+            lo = mid + 1;
+        } else {
+            hi = mid - 1;
+        }
+    }
+    return *from > 0 ? LEX_NORMAL : state;
+}
@@ -0,0 +1,90 @@
+#ifndef HIGHLIGHT_H
+#define HIGHLIGHT_H
+
+#include <stddef.h>
+
+#include "text_buffer.h"
+
+// C lexer for syntax highlighting. Lexing a line needs only the state the
+// previous line ended in (inside a block comment, a continued string, ...),
+// so the entry state of every line is cached in a gap array that moves with
+// edits. After an edit only the changed lines are lexed again, followed by
+// the lines after them until an entry state comes out unchanged.
+//
+// Lexing a line longer than HL_RESTART_STRIDE also records restart points
+// about a stride apart: token starts outside comments and strings, from
+// which lexing in LEX_NORMAL goes on just as lexing the whole line would.
+// An edit keeps the restart points before the first byte it changed and
+// lexes again only from the last of them, and drawing part of a long line
+// lexes only from the restart point before that part.
+
+#define HL_RESTART_STRIDE 1024
+#define HL_RESTART_SLOTS 16
+
+enum {
+    LEX_NORMAL,
+    LEX_COMMENT,
+    LEX_STRING,
+    LEX_LINE_COMMENT
+};
+
+enum {
+    HL_PLAIN,
+    HL_KEYWORD,
+    HL_TYPE,
+    HL_FUNCTION,
+    HL_PREPROC,
+    HL_STRING,
+    HL_NUMBER,
+    HL_COMMENT
+};
+
+typedef struct {
+    int line;
+    unsigned long long used;
+    int entry_state;
+    int end_state;
+    // Offsets from valid_to on need lexing again, and the end state too
+    // unless complete.
+    int complete;
+    size_t valid_to;
+    size_t* offsets;
+    int count;
+    int capacity;
+} HlRestarts;
+
+typedef struct {
+    unsigned char* states;
+    int capacity;
+    int gap_start;
+    int gap_end;
+    int lexed;
+    int dirty_from;
+    int dirty_to;
+    char* scratch;
+    size_t scratch_capacity;
+    unsigned long long lines_lexed;
+    HlRestarts restarts[HL_RESTART_SLOTS];
+    unsigned long long restart_tick;
+} Highlighter;
+
+int hl_init(Highlighter* h);
+void hl_free(Highlighter* h);
+
+// Reports that line first, from byte offset on, and the removed lines after
+// it were replaced by first and inserted new lines.
+void hl_edit(Highlighter* h, int first, size_t offset, int removed, int inserted);
+
+// Returns the state line starts in, lexing whatever earlier lines need it.
+int hl_entry_state(Highlighter* h, const TextBuffer* tb, int line);
+
+// Lexes text starting in state, writing one HL_* class per byte to classes
+// when it is not NULL. Returns the state the text ends in.
+int hl_lex(const char* text, size_t length, int state, unsigned char* classes);
+
+// Where to start lexing line to class its bytes from offset on: stores the
+// last restart point at or before offset and returns LEX_NORMAL, or stores
+// 0 and returns the line's entry state.
+int hl_restart(Highlighter* h, const TextBuffer* tb, int line, size_t offset, size_t* from);
+
+#endif
@@ -0,0 +1,449 @@
+#include "input.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+// Text of the last KEY_PASTE, grown as needed and reused.
+static char* paste = NULL;
+static int paste_len = 0;
+static int paste_cap = 0;
+static int paste_cr = 0;
+
+static void paste_reset() {
+    paste_len = 0;
+    paste_cr = 0;
+}
+
+// Line breaks become '\n', a CR LF pair a single one; other control
+// characters are dropped.
+static void paste_add(unsigned char c) {
+    if (c == '\n' && paste_cr) {
+        paste_cr = 0;
+        return;
+    }
+    paste_cr = c == '\r';
+    if (c == '\r') c = '\n';
+    if ((c < 32 && c != '\n' && c != '\t') || c == 127) return;
+    if (paste_len == paste_cap) {
+        int cap = paste_cap ? paste_cap * 2 : 4096;
+        char* grown = (char*)realloc(paste, cap);
+        if (!grown) return;
+        paste = grown;
+        paste_cap = cap;
+    }
+    paste[paste_len++] = (char)c;
+}
+
+static int paste_event(InputEvent* ev) {
+    ev->key = KEY_PASTE;
+    ev->ch = 0;
+    ev->text = paste;
+    ev->length = paste_len;
+    return 1;
+}
+
+static void paste_free() {
+    free(paste);
+    paste = NULL;
+    paste_len = paste_cap = 0;
+}
+
+#ifdef _WIN32
+
+#include <windows.h>
+
+#define INPUT_BATCH 512
+
+static HANDLE hInput = INVALID_HANDLE_VALUE;
+static HANDLE hWake = NULL;
+static DWORD saved_mode = 0;
+static InputEvent repeat_event;
+static int repeat_count = 0;
+static INPUT_RECORD records[INPUT_BATCH];
+static DWORD record_count = 0;
+static DWORD record_pos = 0;
+
+int input_init() {
+    hInput = GetStdHandle(STD_INPUT_HANDLE);
+    if (hInput == INVALID_HANDLE_VALUE) return -1;
+    GetConsoleMode(hInput, &saved_mode);
+    SetConsoleMode(hInput, ENABLE_WINDOW_INPUT);
+    hWake = CreateEvent(NULL, FALSE, FALSE, NULL);
+    return hWake ? 0 : -1;
+}
+
+void input_shutdown() {
+    if (hInput != INVALID_HANDLE_VALUE) SetConsoleMode(hInput, saved_mode);
+    if (hWake) CloseHandle(hWake);
+    hWake = NULL;
+    paste_free();
+}
+
+int input_wait(int timeout_ms) {
+    if (repeat_count > 0 || record_pos < record_count) return 1;
+
+    DWORD pending = 0;
+    if (GetNumberOfConsoleInputEvents(hInput, &pending) && pending > 0) return 1;
+
+    HANDLE handles[2] = {hInput, hWake};
+    DWORD rc = WaitForMultipleObjects(2, handles, FALSE,
+                                      timeout_ms < 0 ? INFINITE : (DWORD)timeout_ms);
+    return rc == WAIT_OBJECT_0 || rc == WAIT_OBJECT_0 + 1;
+}
+
+static int translate_key(const KEY_EVENT_RECORD* k, InputEvent* ev) {
+    ev->ch = 0;
+    switch (k->wVirtualKeyCode) {
+        case VK_RETURN: ev->key = KEY_ENTER; return 1;
+        case VK_TAB: ev->key = KEY_TAB; return 1;
+        case VK_BACK: ev->key = KEY_BACKSPACE; return 1;
+        case VK_ESCAPE: ev->key = KEY_ESCAPE; return 1;
+        case VK_UP: ev->key = KEY_UP; return 1;
+        case VK_DOWN: ev->key = KEY_DOWN; return 1;
+        case VK_LEFT: ev->key = KEY_LEFT; return 1;
+        case VK_RIGHT: ev->key = KEY_RIGHT; return 1;
+        case VK_HOME: ev->key = KEY_HOME; return 1;
+        case VK_END: ev->key = KEY_END; return 1;
+        case VK_PRIOR: ev->key = KEY_PAGE_UP; return 1;
+        case VK_NEXT: ev->key = KEY_PAGE_DOWN; return 1;
+        case VK_DELETE: ev->key = KEY_DELETE; return 1;
+    }
+    if (k->wVirtualKeyCode >= VK_F1 && k->wVirtualKeyCode <= VK_F1 + 11) {
+        ev->key = KEY_F1 + (k->wVirtualKeyCode - VK_F1);
+        return 1;
+    }
+    if (k->uChar.AsciiChar) {
+        ev->key = KEY_CHAR;
+        ev->ch = (unsigned char)k->uChar.AsciiChar;
+        return 1;
+    }
+    return 0;
+}
+
+static int fill_records() {
+    DWORD pending = 0;
+    if (!GetNumberOfConsoleInputEvents(hInput, &pending) || pending == 0) return 0;
+    record_pos = record_count = 0;
+    if (!ReadConsoleInput(hInput, records, INPUT_BATCH, &record_count)) record_count = 0;
+    return (int)record_count;
+}
+
+// The console pastes as a key event per character, so a run of buffered
+// character, Enter and Tab presses, key releases aside, long enough to not
+// have been typed becomes one paste. Returns 0 and consumes nothing when the
+// run is too short.
+static int read_burst(InputEvent* ev) {
+    int chars = 0;
+    DWORD end = record_pos;
+    for (; end < record_count && chars < INPUT_BURST_MIN; end++) {
+        if (records[end].EventType != KEY_EVENT) break;
+        const KEY_EVENT_RECORD* k = &records[end].Event.KeyEvent;
+        if (!k->bKeyDown) continue;
+        InputEvent key;
+        if (!translate_key(k, &key)) continue;
+        if (key.key != KEY_CHAR && key.key != KEY_ENTER && key.key != KEY_TAB) break;
+        if (key.key == KEY_CHAR && key.ch < 32) break;
+        chars += k->wRepeatCount;
+    }
+    if (chars < INPUT_BURST_MIN) return 0;
+
+    paste_reset();
+    for (;;) {
+        if (record_pos == record_count && !fill_records()) break;
+        INPUT_RECORD* r = &records[record_pos];
+        if (r->EventType != KEY_EVENT) break;
+        const KEY_EVENT_RECORD* k = &r->Event.KeyEvent;
+        InputEvent key;
+        if (k->bKeyDown) {
+            if (!translate_key(k, &key)) {
+                record_pos++;
+                continue;
+            }
+            if (key.key != KEY_CHAR && key.key != KEY_ENTER && key.key != KEY_TAB) break;
+            if (key.key == KEY_CHAR && key.ch < 32) break;
+            unsigned char c = key.key == KEY_ENTER ? '\n' : key.key == KEY_TAB ? '\t'
+                                                                               : (unsigned char)key.ch;
+            for (WORD i = 0; i < k->wRepeatCount; i++) paste_add(c);
+        }
+        record_pos++;
+    }
+    return paste_event(ev);
+}
+
+int input_read(InputEvent* ev) {
+    if (repeat_count > 0) {
+        repeat_count--;
+        *ev = repeat_event;
+        return 1;
+    }
+
+    for (;;) {
+        if (record_pos == record_count && !fill_records()) return 0;
+        if (read_burst(ev)) return 1;
+
+        INPUT_RECORD* record = &records[record_pos++];
+        if (record->EventType != KEY_EVENT || !record->Event.KeyEvent.bKeyDown) continue;
+        if (!translate_key(&record->Event.KeyEvent, ev)) continue;
+
+        if (record->Event.KeyEvent.wRepeatCount > 1) {
+            repeat_event = *ev;
+            repeat_count = record->Event.KeyEvent.wRepeatCount - 1;
+        }
+        return 1;
+    }
+}
+
+void input_wake() {
+    if (hWake) SetEvent(hWake);
+}
+
+#else
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <termios.h>
+#include <unistd.h>
+
+#define ESCAPE_TIMEOUT_MS 25
+#define PASTE_TIMEOUT_MS 500
+#define PASTE_END "\x1b[201~"
+#define PASTE_END_LENGTH 6
+
+static struct termios saved_termios;
+static int raw_enabled = 0;
+static int wake_pipe[2] = {-1, -1};
+static unsigned char pending[4096];
+static int pending_len = 0;
+static int pending_pos = 0;
+static int paste_mode = 0;
+
+static void write_out(const char* s) {
+    ssize_t rc = write(STDOUT_FILENO, s, strlen(s));
+    (void)rc;
+}
+
+int input_init() {
+    if (tcgetattr(STDIN_FILENO, &saved_termios) == 0) {
+        struct termios raw = saved_termios;
+        raw.c_iflag &= ~(BRKINT | ICRNL | INPCK | ISTRIP | IXON);
+        raw.c_oflag &= ~(OPOST);
+        raw.c_cflag |= CS8;
+        raw.c_lflag &= ~(ECHO | ICANON | IEXTEN | ISIG);
+        raw.c_cc[VMIN] = 1;
+        raw.c_cc[VTIME] = 0;
+        if (tcsetattr(STDIN_FILENO, TCSAFLUSH, &raw) == 0) raw_enabled = 1;
+    }
+
+    if (pipe(wake_pipe) != 0) return -1;
+    fcntl(wake_pipe[0], F_SETFL, O_NONBLOCK);
+    fcntl(wake_pipe[1], F_SETFL, O_NONBLOCK);
+
+    if (raw_enabled && isatty(STDOUT_FILENO)) {
+        write_out("\x1b[?2004h");
+        paste_mode = 1;
+    }
+    return 0;
+}
+
+void input_shutdown() {
+    if (paste_mode) write_out("\x1b[?2004l");
+    paste_mode = 0;
+    if (raw_enabled) tcsetattr(STDIN_FILENO, TCSAFLUSH, &saved_termios);
+    raw_enabled = 0;
+    paste_free();
+    if (wake_pipe[0] >= 0) close(wake_pipe[0]);
+    if (wake_pipe[1] >= 0) close(wake_pipe[1]);
+    wake_pipe[0] = wake_pipe[1] = -1;
+}
+
+static int fill_pending(int timeout_ms) {
+    if (pending_pos == pending_len) pending_pos = pending_len = 0;
+    if (pending_len == (int)sizeof(pending)) return 0;
+
+    struct pollfd pfd = {STDIN_FILENO, POLLIN, 0};
+    if (poll(&pfd, 1, timeout_ms) <= 0) return 0;
+
+    ssize_t n = read(STDIN_FILENO, pending + pending_len, sizeof(pending) - pending_len);
+    if (n <= 0) return 0;
+    pending_len += (int)n;
+    return (int)n;
+}
+
+int input_wait(int timeout_ms) {
+    if (pending_pos < pending_len) return 1;
+
+    struct pollfd pfds[2] = {
+        {STDIN_FILENO, POLLIN, 0},
+        {wake_pipe[0], POLLIN, 0}
+    };
+    int rc = poll(pfds, 2, timeout_ms);
+    if (rc <= 0) return 0;
+
+    if (pfds[1].revents & POLLIN) {
+        char drain[64];
+        while (read(wake_pipe[0], drain, sizeof(drain)) > 0) {}
+    }
+    return 1;
+}
+
+static int csi_key(int code, char final) {
+    switch (final) {
+        case 'A': return KEY_UP;
+        case 'B': return KEY_DOWN;
+        case 'C': return KEY_RIGHT;
+        case 'D': return KEY_LEFT;
+        case 'H': return KEY_HOME;
+        case 'F': return KEY_END;
+        case 'P': return KEY_F1;
+        case 'Q': return KEY_F2;
+        case 'R': return KEY_F3;
+        case 'S': return KEY_F4;
+    }
+    if (final != '~') return KEY_NONE;
+    switch (code) {
+        case 1: case 7: return KEY_HOME;
+        case 4: case 8: return KEY_END;
+        case 3: return KEY_DELETE;
+        case 5: return KEY_PAGE_UP;
+        case 6: return KEY_PAGE_DOWN;
+        case 11: return KEY_F1;
+        case 12: return KEY_F2;
+        case 13: return KEY_F3;
+        case 14: return KEY_F4;
+        case 15: return KEY_F5;
+        case 17: return KEY_F6;
+        case 18: return KEY_F7;
+        case 19: return KEY_F8;
+        case 20: return KEY_F9;
+        case 21: return KEY_F10;
+        case 23: return KEY_F11;
+        case 24: return KEY_F12;
+    }
+    return KEY_NONE;
+}
+
+// Parses one escape sequence starting at pending[pending_pos]. Returns the
+// number of bytes consumed, or 0 when the sequence is still incomplete.
+static int parse_escape(InputEvent* ev) {
+    const unsigned char* p = pending + pending_pos;
+    int avail = pending_len - pending_pos;
+    if (avail < 2) return 0;
+
+    if (p[1] == 'O') {
+        if (avail < 3) return 0;
+        ev->key = csi_key(0, (char)p[2]);
+        return 3;
+    }
+    if (p[1] != '[') {
+        ev->key = KEY_ESCAPE;
+        return 1;
+    }
+
+    int code = 0;
+    for (int i = 2; i < avail; i++) {
+        if (p[i] >= '0' && p[i] <= '9') {
+            code = code * 10 + (p[i] - '0');
+        } else if (p[i] == ';') {
+            code = 0;
+        } else {
+            ev->key = code == 200 && p[i] == '~' ? KEY_PASTE : csi_key(code, (char)p[i]);
+            return i + 1;
+        }
+    }
+    return 0;
+}
+
+static int is_text(unsigned char c) {
+    return (c >= 32 && c != 127) || c == '\t' || c == '\r' || c == '\n';
+}
+
+// Collects a bracketed paste up to the closing ESC[201~, however many reads
+// it takes. A paste whose end never arrives ends at PASTE_TIMEOUT_MS.
+static int read_paste(InputEvent* ev) {
+    paste_reset();
+    for (;;) {
+        while (pending_pos < pending_len) {
+            const unsigned char* p = pending + pending_pos;
+            if (*p == 27) {
+                if (pending_len - pending_pos < PASTE_END_LENGTH) break;
+                if (memcmp(p, PASTE_END, PASTE_END_LENGTH) == 0) {
+                    pending_pos += PASTE_END_LENGTH;
+                    return paste_event(ev);
+                }
+            }
+            paste_add(*p);
+            pending_pos++;
+        }
+        // Keep a partial end marker at the front and read behind it.
+        memmove(pending, pending + pending_pos, pending_len - pending_pos);
+        pending_len -= pending_pos;
+        pending_pos = 0;
+        if (fill_pending(PASTE_TIMEOUT_MS) == 0) break;
+    }
+    while (pending_pos < pending_len) paste_add(pending[pending_pos++]);
+    return paste_event(ev);
+}
+
+// Without bracketed paste, a run of text already buffered that is too long
+// to have been typed is taken as a paste all the same.
+static int read_burst(InputEvent* ev) {
+    int run = 0;
+    while (pending_pos + run < pending_len && is_text(pending[pending_pos + run])) run++;
+    if (run < INPUT_BURST_MIN) return 0;
+    paste_reset();
+    for (int i = 0; i < run; i++) paste_add(pending[pending_pos + i]);
+    pending_pos += run;
+    return paste_event(ev);
+}
+
+int input_read(InputEvent* ev) {
+    for (;;) {
+        if (pending_pos == pending_len && fill_pending(0) == 0) return 0;
+
+        unsigned char c = pending[pending_pos];
+        ev->key = KEY_NONE;
+        ev->ch = 0;
+
+        if (c == 27) {
+            int used = parse_escape(ev);
+            if (used == 0 && fill_pending(ESCAPE_TIMEOUT_MS) > 0) used = parse_escape(ev);
+            if (used == 0) {
+                ev->key = KEY_ESCAPE;
+                used = 1;
+            }
+            pending_pos += used;
+            if (ev->key == KEY_PASTE) return read_paste(ev);
+            if (ev->key == KEY_NONE) continue;
+            return 1;
+        }
+        if (read_burst(ev)) return 1;
+
+        pending_pos++;
+        if (c == '\r' || c == '\n') ev->key = KEY_ENTER;
+        else if (c == '\t') ev->key = KEY_TAB;
+        else if (c == 127 || c == 8) ev->key = KEY_BACKSPACE;
+        else {
+            ev->key = KEY_CHAR;
+            ev->ch = c;
+        }
+        return 1;
+    }
+}
+
+void input_wake() {
+    if (wake_pipe[1] >= 0) {
+        char b = 1;
+        ssize_t rc = write(wake_pipe[1], &b, 1);
+        (void)rc;
+    }
+}
+
+#endif
+
+int input_wait_key(InputEvent* ev) {
+    for (;;) {
+        if (input_read(ev)) return ev->key;
+        input_wait(-1);
+    }
+}
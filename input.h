@@ -0,0 +1,72 @@
+#ifndef INPUT_H
+#define INPUT_H
+
+// Blocking keyboard input with a timeout. The Windows backend waits on the
+// console input handle, the POSIX backend puts the terminal in raw mode and
+// poll()s stdin. Both also wait on a wake handle so other threads can
+// interrupt the wait with input_wake().
+//
+// Pasted text arrives as a single KEY_PASTE event rather than one key per
+// character: the POSIX backend turns on the terminal's bracketed paste mode,
+// and on either backend a burst of at least INPUT_BURST_MIN characters that
+// is already waiting when it is read counts as a paste too.
+
+#define INPUT_BURST_MIN 64
+
+enum {
+    KEY_NONE = 0,
+    KEY_CHAR,
+    KEY_ENTER,
+    KEY_TAB,
+    KEY_BACKSPACE,
+    KEY_ESCAPE,
+    KEY_UP,
+    KEY_DOWN,
+    KEY_LEFT,
+    KEY_RIGHT,
+    KEY_HOME,
+    KEY_END,
+    KEY_PAGE_UP,
+    KEY_PAGE_DOWN,
+    KEY_DELETE,
+    KEY_F1,
+    KEY_F2,
+    KEY_F3,
+    KEY_F4,
+    KEY_F5,
+    KEY_F6,
+    KEY_F7,
+    KEY_F8,
+    KEY_F9,
+    KEY_F10,
+    KEY_F11,
+    KEY_F12,
+    KEY_PASTE
+};
+
+// For KEY_PASTE, text holds length bytes with line breaks as '\n' and
+// other control characters dropped. It stays valid until the next
+// input_read().
+typedef struct {
+    int key;
+    int ch;
+    const char* text;
+    int length;
+} InputEvent;
+
+int input_init();
+void input_shutdown();
+
+// Blocks until input or a wake-up arrives, or timeout_ms passes (-1 waits
+// forever). Returns 1 when events may be ready, 0 on timeout.
+int input_wait(int timeout_ms);
+
+// Returns 1 and fills ev when an event is ready, 0 without blocking otherwise.
+int input_read(InputEvent* ev);
+
+void input_wake();
+
+// Waits for and returns the next key, discarding everything else.
+int input_wait_key(InputEvent* ev);
+
+#endif
@@ -0,0 +1,335 @@
+#include "job.h"
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <thread>
+
+#include "input.h"
+#include "process.h"
+
+// Output past the limit is still drained so the child never blocks, but no
+// longer kept.
+#define JOB_OUTPUT_LIMIT (1024 * 1024)
+#define JOB_LINE_MAX 512
+#define JOB_PATH_MAX 260
+
+typedef std::chrono::steady_clock Clock;
+
+typedef struct {
+    size_t start;
+    size_t length;
+    int stream;
+} JobLine;
+
+static std::mutex job_mutex;
+static std::thread supervisor;
+static std::atomic<unsigned int> version(0);
+
+// Guarded by job_mutex.
+static int state = JOB_IDLE;
+static int exit_code = 0;
+static int cancelled = 0;
+static int build_first = 0;
+static int built = 0;
+static double build_ms = 0;
+static double run_ms = 0;
+static Clock::time_point step_started;
+static char* output = NULL;
+static size_t output_length = 0;
+static size_t output_capacity = 0;
+static JobLine* lines = NULL;
+static int line_count = 0;
+static int line_capacity = 0;
+static int truncated = 0;
+static Process child;
+
+static char source_path[JOB_PATH_MAX];
+static char program_path[JOB_PATH_MAX];
+
+static void changed() {
+    version++;
+    input_wake();
+}
+
+static void append_line_locked(int stream, const char* text, size_t length) {
+    if (truncated) return;
+    if (output_length + length > JOB_OUTPUT_LIMIT) {
+        truncated = 1;
+        text = "[output truncated]";
+        length = strlen(text);
+        stream = JOB_INFO;
+    }
+
+    if (line_count == line_capacity) {
+        int cap = line_capacity ? line_capacity * 2 : 256;
+        JobLine* grown = (JobLine*)realloc(lines, cap * sizeof(JobLine));
+        if (!grown) return;
+        lines = grown;
+        line_capacity = cap;
+    }
+    if (output_length + length > output_capacity) {
+        size_t cap = output_capacity ? output_capacity : 65536;
+        while (cap < output_length + length) cap *= 2;
+        char* grown = (char*)realloc(output, cap);
+        if (!grown) return;
+        output = grown;
+        output_capacity = cap;
+    }
+
+    memcpy(output + output_length, text, length);
+    lines[line_count].start = output_length;
+    lines[line_count].length = length;
+    lines[line_count].stream = stream;
+    line_count++;
+    output_length += length;
+}
+
+static void info(const char* format, ...) {
+    char line[JOB_LINE_MAX];
+    va_list args;
+    va_start(args, format);
+    vsnprintf(line, sizeof(line), format, args);
+    va_end(args);
+    {
+        std::lock_guard<std::mutex> lock(job_mutex);
+        append_line_locked(JOB_INFO, line, strlen(line));
+    }
+    changed();
+}
+
+static double elapsed_ms(Clock::time_point since) {
+    return std::chrono::duration<double, std::milli>(Clock::now() - since).count();
+}
+
+static void set_state(int next) {
+    {
+        std::lock_guard<std::mutex> lock(job_mutex);
+        state = next;
+        step_started = Clock::now();
+    }
+    changed();
+}
+
+// Splits a child stream into lines, waking the editor once per read.
+static void drain(ProcessStream s, int stream) {
+    char buf[4096];
+    char line[JOB_LINE_MAX];
+    size_t length = 0;
+    int n;
+
+    while ((n = process_read(s, buf, sizeof(buf))) > 0) {
+        std::unique_lock<std::mutex> lock(job_mutex);
+        for (int i = 0; i < n; i++) {
+            unsigned char c = (unsigned char)buf[i];
+            if (c == '\n') {
+                append_line_locked(stream, line, length);
+                length = 0;
+            } else if (c != '\r') {
+                if (length == sizeof(line)) {
+                    append_line_locked(stream, line, length);
+                    length = 0;
+                }
+                line[length++] = c < 32 ? ' ' : (char)c;
+            }
+        }
+        lock.unlock();
+        changed();
+    }
+    if (length > 0) {
+        std::lock_guard<std::mutex> lock(job_mutex);
+        append_line_locked(stream, line, length);
+    }
+    process_close(s);
+    changed();
+}
+
+// Runs one child to completion. Returns -1 when it could not be started or
+// the job was cancelled first.
+static int run_step(const char* const* argv, double* ms, int* code) {
+    ProcessStream out, err;
+    Clock::time_point started = Clock::now();
+    {
+        std::lock_guard<std::mutex> lock(job_mutex);
+        if (cancelled || process_spawn(&child, argv, &out, &err) != 0) return -1;
+    }
+
+    std::thread out_reader(drain, out, JOB_STDOUT);
+    std::thread err_reader(drain, err, JOB_STDERR);
+    process_wait(&child);
+    *ms = elapsed_ms(started);
+    // Anything the child left running in its group would keep the pipes
+    // open and the readers waiting.
+    {
+        std::lock_guard<std::mutex> lock(job_mutex);
+        *code = process_reap(&child);
+        process_kill(&child);
+    }
+    out_reader.join();
+    err_reader.join();
+    {
+        std::lock_guard<std::mutex> lock(job_mutex);
+        process_release(&child);
+    }
+    return 0;
+}
+
+static void finish(int final_state) {
+    {
+        std::lock_guard<std::mutex> lock(job_mutex);
+        state = final_state;
+    }
+    changed();
+}
+
+static int was_cancelled() {
+    std::lock_guard<std::mutex> lock(job_mutex);
+    return cancelled;
+}
+
+static void job_main() {
+    const char* build[] = {JOB_COMPILER, source_path, "-o", program_path, NULL};
+    const char* run[] = {program_path, NULL};
+    double ms = 0;
+    int code = 0;
+    int rc;
+
+    if (build_first) {
+        info("$ %s %s -o %s", JOB_COMPILER, source_path, program_path);
+        set_state(JOB_BUILDING);
+        rc = run_step(build, &ms, &code);
+        {
+            std::lock_guard<std::mutex> lock(job_mutex);
+            build_ms = ms;
+            built = rc == 0 && code == 0 && !cancelled;
+        }
+        if (was_cancelled()) {
+            info("Stopped");
+            finish(JOB_CANCELLED);
+            return;
+        }
+        if (rc != 0) {
+            info("Could not start %s", JOB_COMPILER);
+            finish(JOB_FAILED);
+            return;
+        }
+        if (code != 0) {
+            info("Build failed after %.0f ms", ms);
+            finish(JOB_BUILD_FAILED);
+            return;
+        }
+    }
+
+    info("$ %s%s", program_path, build_first ? "" : "  (cached build)");
+    set_state(JOB_RUNNING);
+    rc = run_step(run, &ms, &code);
+    {
+        std::lock_guard<std::mutex> lock(job_mutex);
+        run_ms = ms;
+        exit_code = code;
+    }
+    if (was_cancelled()) {
+        info("Stopped after %.0f ms", ms);
+        finish(JOB_CANCELLED);
+    } else if (rc != 0) {
+        info("Could not start %s", program_path);
+        finish(JOB_FAILED);
+    } else {
+        if (build_first) info("Exited with %d, build %.0f ms, run %.0f ms", code, build_ms, ms);
+        else info("Exited with %d, run %.0f ms", code, ms);
+        finish(JOB_FINISHED);
+    }
+}
+
+static void join_supervisor() {
+    job_cancel();
+    if (supervisor.joinable()) supervisor.join();
+}
+
+// An empty source skips the build.
+static int launch(const char* source, const char* program) {
+    if (strlen(source) >= JOB_PATH_MAX || strlen(program) >= JOB_PATH_MAX) return -1;
+    join_supervisor();
+
+    strcpy(source_path, source);
+    strcpy(program_path, program);
+    {
+        std::lock_guard<std::mutex> lock(job_mutex);
+        build_first = source[0] != '\0';
+        built = 0;
+        state = build_first ? JOB_BUILDING : JOB_RUNNING;
+        cancelled = 0;
+        exit_code = 0;
+        build_ms = run_ms = 0;
+        step_started = Clock::now();
+        output_length = 0;
+        line_count = 0;
+        truncated = 0;
+    }
+    supervisor = std::thread(job_main);
+    changed();
+    return 0;
+}
+
+int job_start(const char* source, const char* program) {
+    if (!source[0]) return -1;
+    return launch(source, program);
+}
+
+int job_run(const char* program) {
+    return launch("", program);
+}
+
+void job_cancel() {
+    std::lock_guard<std::mutex> lock(job_mutex);
+    if (state != JOB_BUILDING && state != JOB_RUNNING) return;
+    cancelled = 1;
+    process_kill(&child);
+}
+
+void job_shutdown() {
+    join_supervisor();
+    std::lock_guard<std::mutex> lock(job_mutex);
+    free(output);
+    free(lines);
+    output = NULL;
+    lines = NULL;
+    output_length = output_capacity = 0;
+    line_count = line_capacity = 0;
+    state = JOB_IDLE;
+}
+
+void job_status(JobStatus* status) {
+    std::lock_guard<std::mutex> lock(job_mutex);
+    status->state = state;
+    status->exit_code = exit_code;
+    status->build_ms = state == JOB_BUILDING ? elapsed_ms(step_started) : build_ms;
+    status->run_ms = state == JOB_RUNNING ? elapsed_ms(step_started) : run_ms;
+    status->line_count = line_count;
+    status->built = built;
+    status->cached = !build_first;
+}
+
+int job_active() {
+    std::lock_guard<std::mutex> lock(job_mutex);
+    return state == JOB_BUILDING || state == JOB_RUNNING;
+}
+
+int job_line(int index, char* out, size_t out_size) {
+    std::lock_guard<std::mutex> lock(job_mutex);
+    if (index < 0 || index >= line_count || out_size == 0) return -1;
+    size_t length = lines[index].length;
+    if (length > out_size - 1) length = out_size - 1;
+    memcpy(out, output + lines[index].start, length);
+    out[length] = '\0';
+    return lines[index].stream;
+}
+
+unsigned int job_version() {
+    return version.load();
+}
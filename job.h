@@ -0,0 +1,64 @@
+#ifndef JOB_H
+#define JOB_H
+
+#include <stddef.h>
+
+// Background build-and-run. A supervisor thread compiles the source
+// and, when that succeeds, runs the result. Both children get pipes for
+// stdout and stderr, drained by reader threads into a shared list of output
+// lines, and the null device as stdin. Every batch of output and every state
+// change calls input_wake(), so the editor never blocks on a child.
+
+// The build runs JOB_COMPILER source -o program.
+#define JOB_COMPILER "gcc"
+
+enum {
+    JOB_IDLE,
+    JOB_BUILDING,
+    JOB_RUNNING,
+    JOB_FINISHED,
+    JOB_BUILD_FAILED,
+    JOB_CANCELLED,
+    JOB_FAILED
+};
+
+enum {
+    JOB_STDOUT,
+    JOB_STDERR,
+    JOB_INFO
+};
+
+typedef struct {
+    int state;
+    int exit_code;
+    double build_ms;
+    double run_ms;
+    int line_count;
+    int built;
+    int cached;
+} JobStatus;
+
+// Builds source into program and runs it, replacing any previous job.
+int job_start(const char* source, const char* program);
+
+// Runs an already built program, replacing any previous job.
+int job_run(const char* program);
+
+// Kills the running child, with everything it started, and skips what is left.
+void job_cancel();
+
+// Cancels and waits for the job, then frees its output.
+void job_shutdown();
+
+// While a step runs its time so far is reported.
+void job_status(JobStatus* status);
+
+int job_active();
+
+// Copies output line index into out and returns its JOB_* stream, or -1.
+int job_line(int index, char* out, size_t out_size);
+
+// Changes whenever output arrives or the state changes.
+unsigned int job_version();
+
+#endif
@@ -0,0 +1,462 @@
+#include "journal.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+#ifdef _WIN32
+#include <fcntl.h>
+#include <io.h>
+#include <windows.h>
+#else
+#include <unistd.h>
+#endif
+
+#include "profile.h"
+
+#define JOURNAL_MAGIC 0x314A4D4Du
+#define JOURNAL_PATH_MAX 1024
+#define JOURNAL_RECORD_MAX (1ull << 31)
+
+enum {
+    RECORD_INSERT = 1,
+    RECORD_DELETE,
+    RECORD_SAVED
+};
+
+// base is JOURNAL_BASE_EMPTY or JOURNAL_BASE_FILE; size and mtime identify
+// the file version the records apply to.
+typedef struct {
+    unsigned int magic;
+    unsigned int base;
+    unsigned long long size;
+    long long mtime;
+} JournalHeader;
+
+// Followed by length bytes of text for an insert.
+typedef struct {
+    unsigned int type;
+    unsigned int checksum;
+    unsigned long long offset;
+    unsigned long long length;
+} JournalRecord;
+
+typedef struct JournalMessage {
+    struct JournalMessage* next;
+    int type;
+    size_t offset;
+    size_t length;
+    char* text;
+} JournalMessage;
+
+static std::mutex journal_mutex;
+static std::condition_variable journal_ready;
+static JournalMessage* queue_head = NULL;
+static JournalMessage* queue_tail = NULL;
+static int stopping = 0;
+static std::thread worker;
+static int running = 0;
+
+static char document_path[JOURNAL_PATH_MAX];
+static char journal_path[JOURNAL_PATH_MAX];
+static char journal_tmp_path[JOURNAL_PATH_MAX];
+static char document_tmp_path[JOURNAL_PATH_MAX];
+
+// Worker-private.
+static TextBuffer replica;
+static int replica_ready = 0;
+static FILE* out = NULL;
+static unsigned long long journal_bytes = 0;
+static unsigned long long compact_at = JOURNAL_COMPACT_BYTES;
+static unsigned long long edits = 0;
+static char* batch = NULL;
+static size_t batch_length = 0;
+static size_t batch_capacity = 0;
+
+static void set_paths(const char* document) {
+    snprintf(document_path, sizeof(document_path), "%s", document);
+    snprintf(journal_path, sizeof(journal_path), "%s.journal", document);
+    snprintf(journal_tmp_path, sizeof(journal_tmp_path), "%s.journal.tmp", document);
+    snprintf(document_tmp_path, sizeof(document_tmp_path), "%s.autosave.tmp", document);
+}
+
+static int stat_file(const char* path, unsigned long long* size, long long* mtime) {
+#ifdef _WIN32
+    struct __stat64 st;
+    if (_stat64(path, &st) != 0) return -1;
+#else
+    struct stat st;
+    if (stat(path, &st) != 0) return -1;
+#endif
+    *size = (unsigned long long)st.st_size;
+    *mtime = (long long)st.st_mtime;
+    return 0;
+}
+
+static int sync_file(FILE* f) {
+    if (fflush(f) != 0) return -1;
+#ifdef _WIN32
+    return _commit(_fileno(f));
+#else
+    return fsync(fileno(f));
+#endif
+}
+
+static int replace_file(const char* from, const char* to) {
+#ifdef _WIN32
+    return MoveFileExA(from, to, MOVEFILE_REPLACE_EXISTING) ? 0 : -1;
+#else
+    return rename(from, to);
+#endif
+}
+
+static int truncate_file(const char* path, unsigned long long size) {
+#ifdef _WIN32
+    int fd = _open(path, _O_RDWR | _O_BINARY);
+    if (fd < 0) return -1;
+    int rc = _chsize_s(fd, (long long)size);
+    _close(fd);
+    return rc == 0 ? 0 : -1;
+#else
+    return truncate(path, (off_t)size);
+#endif
+}
+
+static unsigned int checksum(const JournalRecord* r, const char* text) {
+    unsigned int h = 2166136261u;
+    const unsigned char* fields[3] = {
+        (const unsigned char*)&r->type,
+        (const unsigned char*)&r->offset,
+        (const unsigned char*)&r->length
+    };
+    size_t sizes[3] = {sizeof(r->type), sizeof(r->offset), sizeof(r->length)};
+    for (int f = 0; f < 3; f++) {
+        for (size_t i = 0; i < sizes[f]; i++) {
+            h ^= fields[f][i];
+            h *= 16777619u;
+        }
+    }
+    if (text) {
+        for (unsigned long long i = 0; i < r->length; i++) {
+            h ^= (unsigned char)text[i];
+            h *= 16777619u;
+        }
+    }
+    return h;
+}
+
+// Builds tb from the journal's base and replays records up to the first
+// torn or corrupt one. Returns the journal length that is valid, 0 when
+// there is no usable journal; sets *stale when its base file has changed.
+static unsigned long long load(TextBuffer* tb, int* stale) {
+    *stale = 0;
+    FILE* f = fopen(journal_path, "rb");
+    if (!f) return 0;
+
+    JournalHeader h;
+    if (fread(&h, sizeof(h), 1, f) != 1 || h.magic != JOURNAL_MAGIC) {
+        fclose(f);
+        *stale = 1;
+        return 0;
+    }
+
+    int rc;
+    if (h.base == JOURNAL_BASE_FILE) {
+        unsigned long long size;
+        long long mtime;
+        if (stat_file(document_path, &size, &mtime) != 0 || size != h.size || mtime != h.mtime) {
+            fclose(f);
+            *stale = 1;
+            return 0;
+        }
+        rc = tb_open(tb, document_path);
+        if (rc == 0) tb_index_all(tb);
+    } else {
+        rc = tb_init(tb);
+    }
+    if (rc != 0) {
+        fclose(f);
+        return 0;
+    }
+
+    unsigned long long valid = sizeof(h);
+    char* text = NULL;
+    size_t capacity = 0;
+    JournalRecord r;
+    while (fread(&r, sizeof(r), 1, f) == 1) {
+        if (r.length > JOURNAL_RECORD_MAX) break;
+        if (r.type == RECORD_INSERT) {
+            if (r.length > capacity) {
+                char* grown = (char*)realloc(text, (size_t)r.length);
+                if (!grown) break;
+                text = grown;
+                capacity = (size_t)r.length;
+            }
+            if (fread(text, 1, (size_t)r.length, f) != r.length) break;
+            if (checksum(&r, text) != r.checksum) break;
+            if (r.offset > tb_length(tb)) break;
+            if (tb_insert(tb, (size_t)r.offset, text, (size_t)r.length) != 0) break;
+            valid += sizeof(r) + r.length;
+        } else if (r.type == RECORD_DELETE) {
+            if (checksum(&r, NULL) != r.checksum) break;
+            if (r.offset + r.length > tb_length(tb)) break;
+            tb_delete(tb, (size_t)r.offset, (size_t)r.length);
+            valid += sizeof(r);
+        } else {
+            break;
+        }
+    }
+    free(text);
+    fclose(f);
+    return valid;
+}
+
+int journal_recover(const char* document, TextBuffer* tb) {
+    set_paths(document);
+    TextBuffer rebuilt;
+    int stale;
+    unsigned long long valid = load(&rebuilt, &stale);
+    if (stale) {
+        char stale_path[JOURNAL_PATH_MAX + 8];
+        snprintf(stale_path, sizeof(stale_path), "%s.stale", journal_path);
+        replace_file(journal_path, stale_path);
+    }
+    if (valid == 0) return 0;
+
+    // Without records the document on disk is already the latest text.
+    if (valid == sizeof(JournalHeader)) {
+        tb_free(&rebuilt);
+        return 0;
+    }
+    *tb = rebuilt;
+    return 1;
+}
+
+// Replaces the journal with one holding only a header, based on the
+// document as it is now.
+static int reset_journal(int base) {
+    JournalHeader h = {JOURNAL_MAGIC, (unsigned int)base, 0, 0};
+    if (base == JOURNAL_BASE_FILE && stat_file(document_path, &h.size, &h.mtime) != 0) return -1;
+
+    FILE* f = fopen(journal_tmp_path, "wb");
+    if (!f) return -1;
+    int rc = fwrite(&h, sizeof(h), 1, f) == 1 ? 0 : -1;
+    if (sync_file(f) != 0) rc = -1;
+    if (fclose(f) != 0) rc = -1;
+
+    // Windows cannot rename over a file that is still open.
+    if (out) fclose(out);
+    out = NULL;
+    if (rc == 0) rc = replace_file(journal_tmp_path, journal_path);
+    if (rc != 0) {
+        remove(journal_tmp_path);
+        out = fopen(journal_path, "ab");
+        return -1;
+    }
+    out = fopen(journal_path, "ab");
+    journal_bytes = sizeof(h);
+    edits = 0;
+    return out ? 0 : -1;
+}
+
+// Writes the replica over the document and starts a fresh journal on it.
+// After a failure the old journal stays valid and keeps growing.
+static int compact() {
+    FILE* f = fopen(document_tmp_path, "wb");
+    if (!f) return -1;
+    int rc = tb_write(&replica, f);
+    if (sync_file(f) != 0) rc = -1;
+    if (fclose(f) != 0) rc = -1;
+    if (rc == 0) rc = replace_file(document_tmp_path, document_path);
+    if (rc != 0) {
+        remove(document_tmp_path);
+        return -1;
+    }
+    return reset_journal(JOURNAL_BASE_FILE);
+}
+
+static int append_batch(const void* data, size_t length) {
+    if (batch_length + length > batch_capacity) {
+        size_t cap = batch_capacity ? batch_capacity : 65536;
+        while (cap < batch_length + length) cap *= 2;
+        char* grown = (char*)realloc(batch, cap);
+        if (!grown) return -1;
+        batch = grown;
+        batch_capacity = cap;
+    }
+    memcpy(batch + batch_length, data, length);
+    batch_length += length;
+    return 0;
+}
+
+static void flush_batch() {
+    if (batch_length == 0) return;
+    if (out && fwrite(batch, 1, batch_length, out) == batch_length && sync_file(out) == 0) {
+        journal_bytes += batch_length;
+    }
+    batch_length = 0;
+}
+
+static void apply(JournalMessage* m) {
+    // The editor already wrote the buffer, so only the base moves.
+    if (m->type == RECORD_SAVED) {
+        flush_batch();
+        reset_journal(JOURNAL_BASE_FILE);
+        return;
+    }
+
+    JournalRecord r;
+    r.type = (unsigned int)m->type;
+    r.offset = m->offset;
+    r.length = m->length;
+    r.checksum = checksum(&r, m->text);
+    if (m->type == RECORD_INSERT) {
+        tb_insert(&replica, m->offset, m->text, m->length);
+    } else {
+        tb_delete(&replica, m->offset, m->length);
+    }
+    edits++;
+    if (append_batch(&r, sizeof(r)) == 0 && m->text) append_batch(m->text, m->length);
+}
+
+static void free_messages(JournalMessage* m) {
+    while (m) {
+        JournalMessage* next = m->next;
+        free(m);
+        m = next;
+    }
+}
+
+static int open_replica(int base) {
+    int stale;
+    if (base == JOURNAL_RESUME) {
+        unsigned long long valid = load(&replica, &stale);
+        if (valid == 0) return -1;
+        // Drop a torn tail so new records follow the last good one.
+        if (truncate_file(journal_path, valid) != 0) return -1;
+        out = fopen(journal_path, "ab");
+        journal_bytes = valid;
+        edits = 1;
+        return out ? 0 : -1;
+    }
+    if (base == JOURNAL_BASE_FILE && tb_open(&replica, document_path) == 0) {
+        tb_index_all(&replica);
+    } else {
+        base = JOURNAL_BASE_EMPTY;
+        if (tb_init(&replica) != 0) return -1;
+    }
+    return reset_journal(base);
+}
+
+static void journal_main(int base) {
+    profile_thread("journal");
+    replica_ready = open_replica(base) == 0;
+
+    std::unique_lock<std::mutex> lock(journal_mutex);
+    for (;;) {
+        while (!queue_head && !stopping) journal_ready.wait(lock);
+
+        // Let a burst of keystrokes collect into one write.
+        auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(JOURNAL_BATCH_MS);
+        while (!stopping && journal_ready.wait_until(lock, deadline) != std::cv_status::timeout) {}
+
+        JournalMessage* messages = queue_head;
+        queue_head = queue_tail = NULL;
+        int stop = stopping;
+        lock.unlock();
+
+        if (replica_ready) {
+            PROFILE_SCOPE(PROFILE_JOURNAL);
+            for (JournalMessage* m = messages; m; m = m->next) apply(m);
+            flush_batch();
+            if (journal_bytes >= compact_at) {
+                if (compact() == 0) compact_at = JOURNAL_COMPACT_BYTES;
+                else compact_at = journal_bytes + JOURNAL_COMPACT_BYTES;
+            }
+        }
+        free_messages(messages);
+        if (stop) break;
+
+        lock.lock();
+    }
+
+    if (replica_ready && (edits == 0 || compact() == 0)) {
+        if (out) fclose(out);
+        out = NULL;
+        remove(journal_path);
+    }
+    if (out) fclose(out);
+    out = NULL;
+    if (replica_ready) tb_free(&replica);
+    replica_ready = 0;
+    free(batch);
+    batch = NULL;
+    batch_length = batch_capacity = 0;
+}
+
+int journal_start(const char* document, int base) {
+    if (running) return 0;
+    set_paths(document);
+    stopping = 0;
+    compact_at = JOURNAL_COMPACT_BYTES;
+    worker = std::thread(journal_main, base);
+    running = 1;
+    return 0;
+}
+
+void journal_stop() {
+    if (!running) return;
+    {
+        std::lock_guard<std::mutex> lock(journal_mutex);
+        stopping = 1;
+    }
+    journal_ready.notify_one();
+    worker.join();
+    running = 0;
+}
+
+// Only the first message of a batch wakes the worker; the rest wait out
+// the batch window.
+static void post(int type, size_t offset, const char* text, size_t length) {
+    if (!running) return;
+    size_t extra = type == RECORD_INSERT ? length : 0;
+    JournalMessage* m = (JournalMessage*)malloc(sizeof(JournalMessage) + extra);
+    if (!m) return;
+    m->next = NULL;
+    m->type = type;
+    m->offset = offset;
+    m->length = length;
+    m->text = NULL;
+    if (extra) {
+        m->text = (char*)(m + 1);
+        memcpy(m->text, text, length);
+    }
+
+    int wake;
+    {
+        std::lock_guard<std::mutex> lock(journal_mutex);
+        wake = queue_head == NULL;
+        if (queue_tail) queue_tail->next = m;
+        else queue_head = m;
+        queue_tail = m;
+    }
+    if (wake) journal_ready.notify_one();
+}
+
+void journal_insert(size_t offset, const char* text, size_t length) {
+    if (length > 0) post(RECORD_INSERT, offset, text, length);
+}
+
+void journal_delete(size_t offset, size_t length) {
+    if (length > 0) post(RECORD_DELETE, offset, NULL, length);
+}
+
+void journal_saved() {
+    post(RECORD_SAVED, 0, NULL, 0);
+}
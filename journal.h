@@ -0,0 +1,44 @@
+#ifndef JOURNAL_H
+#define JOURNAL_H
+
+#include <stddef.h>
+
+#include "text_buffer.h"
+
+// Autosave. Every buffer edit is queued to a worker thread that appends it
+// to <document>.journal in batches, each record checksummed so a torn tail
+// is ignored. The worker applies the same edits to its own copy of the
+// buffer; once the journal grows past JOURNAL_COMPACT_BYTES it writes that
+// copy over the document (temporary file plus rename) and starts a fresh
+// journal based on it. The journal header names its base, so reopening
+// after a crash rebuilds the buffer from the base plus the valid records.
+
+#define JOURNAL_BATCH_MS 100
+#define JOURNAL_COMPACT_BYTES (1024 * 1024)
+
+enum {
+    JOURNAL_BASE_EMPTY,
+    JOURNAL_BASE_FILE,
+    JOURNAL_RESUME
+};
+
+// Rebuilds tb from the document's journal. Returns 1 when tb was built
+// from it, 0 when there is no usable journal (tb is left untouched). A
+// journal whose base file changed since is renamed to .journal.stale.
+int journal_recover(const char* document, TextBuffer* tb);
+
+// base says what the buffer holds now: nothing, the document as on disk,
+// or what journal_recover() rebuilt.
+int journal_start(const char* document, int base);
+
+// Writes the buffer to the document and removes the journal.
+void journal_stop();
+
+void journal_insert(size_t offset, const char* text, size_t length);
+void journal_delete(size_t offset, size_t length);
+
+// Reports that the editor wrote the buffer to the document. The journal
+// restarts empty on top of it; the document is not written again.
+void journal_saved();
+
+#endif
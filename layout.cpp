@@ -0,0 +1,341 @@
+#include "layout.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define LAYOUT_SSE2 1
+#endif
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+typedef struct {
+    unsigned int first;
+    unsigned int last;
+} CodeRange;
+
+static const CodeRange zero_width[] = {
+    {0x0300, 0x036F}, {0x0483, 0x0489}, {0x0591, 0x05BD}, {0x0610, 0x061A},
+    {0x064B, 0x065F}, {0x1AB0, 0x1AFF}, {0x1DC0, 0x1DFF}, {0x200B, 0x200F},
+    {0x202A, 0x202E}, {0x2060, 0x2064}, {0x20D0, 0x20FF}, {0xFE00, 0xFE0F},
+    {0xFE20, 0xFE2F}, {0xFEFF, 0xFEFF}, {0xE0100, 0xE01EF}
+};
+
+static const CodeRange wide[] = {
+    {0x1100, 0x115F}, {0x231A, 0x231B}, {0x2329, 0x232A}, {0x23E9, 0x23EC},
+    {0x25FD, 0x25FE}, {0x2614, 0x2615}, {0x2648, 0x2653}, {0x26A1, 0x26A1},
+    {0x26AA, 0x26AB}, {0x26BD, 0x26BE}, {0x26C4, 0x26C5}, {0x26D4, 0x26D4},
+    {0x26EA, 0x26EA}, {0x26F2, 0x26F5}, {0x26FA, 0x26FA}, {0x26FD, 0x26FD},
+    {0x2705, 0x2705}, {0x270A, 0x270B}, {0x2728, 0x2728}, {0x274C, 0x274C},
+    {0x2753, 0x2755}, {0x2757, 0x2757}, {0x2795, 0x2797}, {0x27B0, 0x27B0},
+    {0x27BF, 0x27BF}, {0x2B1B, 0x2B1C}, {0x2B50, 0x2B50}, {0x2B55, 0x2B55},
+    {0x2E80, 0x303E}, {0x3041, 0x33FF}, {0x3400, 0x4DBF}, {0x4E00, 0x9FFF},
+    {0xA000, 0xA4CF}, {0xA960, 0xA97F}, {0xAC00, 0xD7A3}, {0xF900, 0xFAFF},
+    {0xFE10, 0xFE19}, {0xFE30, 0xFE6F}, {0xFF00, 0xFF60}, {0xFFE0, 0xFFE6},
+    {0x1F004, 0x1F004}, {0x1F0CF, 0x1F0CF}, {0x1F18E, 0x1F18E}, {0x1F191, 0x1F19A},
+    {0x1F200, 0x1F251}, {0x1F300, 0x1F64F}, {0x1F680, 0x1F6FF}, {0x1F900, 0x1F9FF},
+    {0x1FA70, 0x1FAFF}, {0x20000, 0x2FFFD}, {0x30000, 0x3FFFD}
+};
+
+static int in_ranges(const CodeRange* ranges, int count, unsigned int cp) {
+    int lo = 0, hi = count - 1;
+    while (lo <= hi) {
+        int mid = (lo + hi) / 2;
+        if (cp < ranges[mid].first) hi = mid - 1;
+        else if (cp > ranges[mid].last) lo = mid + 1;
+        else return 1;
+    }
+    return 0;
+}
+
+int layout_width(unsigned int cp) {
+    if (cp < 0x300) return 1;
+    if (in_ranges(zero_width, (int)(sizeof(zero_width) / sizeof(zero_width[0])), cp)) return 0;
+    if (in_ranges(wide, (int)(sizeof(wide) / sizeof(wide[0])), cp)) return 2;
+    return 1;
+}
+
+int layout_decode(const char* s, size_t n, unsigned int* cp) {
+    const unsigned char* p = (const unsigned char*)s;
+    unsigned int c = p[0];
+    unsigned int min;
+    int length;
+    *cp = 0xFFFD;
+    if (c < 0x80) {
+        *cp = c;
+        return 1;
+    }
+    if (c >= 0xC2 && c <= 0xDF) {
+        length = 2;
+        c &= 0x1F;
+        min = 0x80;
+    } else if (c >= 0xE0 && c <= 0xEF) {
+        length = 3;
+        c &= 0x0F;
+        min = 0x800;
+    } else if (c >= 0xF0 && c <= 0xF4) {
+        length = 4;
+        c &= 0x07;
+        min = 0x10000;
+    } else {
+        return 1;
+    }
+    if ((size_t)length > n) return 1;
+    for (int i = 1; i < length; i++) {
+        if ((p[i] & 0xC0) != 0x80) return 1;
+        c = (c << 6) | (p[i] & 0x3F);
+    }
+    if (c < min || c > 0x10FFFF || (c >= 0xD800 && c <= 0xDFFF)) return 1;
+    *cp = c;
+    return length;
+}
+
+// Columns the character at s takes when it starts at column; stores its
+// length in bytes.
+static size_t char_columns(const char* s, size_t n, size_t column, int* bytes) {
+    unsigned char c = (unsigned char)*s;
+    if (c < 0x80) {
+        *bytes = 1;
+        return c == '\t' ? LAYOUT_TAB_WIDTH - column % LAYOUT_TAB_WIDTH : 1;
+    }
+    unsigned int cp;
+    *bytes = layout_decode(s, n, &cp);
+    return (size_t)layout_width(cp);
+}
+
+static int lowest_bit(unsigned int mask) {
+#ifdef _MSC_VER
+    unsigned long index;
+    _BitScanForward(&index, mask);
+    return (int)index;
+#else
+    return __builtin_ctz(mask);
+#endif
+}
+
+// Leading bytes of s that are printable ASCII, each one column wide,
+// sixteen bytes per compare where SSE2 is available.
+static size_t plain_run(const char* s, size_t n) {
+    size_t i = 0;
+#ifdef LAYOUT_SSE2
+    const __m128i space = _mm_set1_epi8(' ');
+    const __m128i del = _mm_set1_epi8(127);
+    for (; i + 16 <= n; i += 16) {
+        __m128i bytes = _mm_loadu_si128((const __m128i*)(s + i));
+        // The compare is signed, so bytes from 0x80 up are below ' ' too.
+        __m128i other = _mm_or_si128(_mm_cmplt_epi8(bytes, space), _mm_cmpeq_epi8(bytes, del));
+        unsigned int mask = (unsigned int)_mm_movemask_epi8(other);
+        if (mask) return i + lowest_bit(mask);
+    }
+#endif
+    while (i < n && (unsigned char)s[i] >= 32 && (unsigned char)s[i] < 127) i++;
+    return i;
+}
+
+static void clear_slot(LineLayout* l) {
+    free(l->stops);
+    memset(l, 0, sizeof(*l));
+    l->line = -1;
+}
+
+void layout_init(LayoutCache* c) {
+    memset(c, 0, sizeof(*c));
+    for (int i = 0; i < LAYOUT_SLOTS; i++) c->slots[i].line = -1;
+}
+
+void layout_free(LayoutCache* c) {
+    for (int i = 0; i < LAYOUT_SLOTS; i++) clear_slot(&c->slots[i]);
+    free(c->scratch);
+    layout_init(c);
+}
+
+void layout_edit(LayoutCache* c, int first, size_t offset, int removed, int inserted) {
+    for (int i = 0; i < LAYOUT_SLOTS; i++) {
+        LineLayout* l = &c->slots[i];
+        if (l->line < first) continue;
+        if (l->line == first) {
+            if (l->valid_to > offset) l->valid_to = offset;
+            l->complete = 0;
+        } else if (l->line <= first + removed) {
+            clear_slot(l);
+        } else {
+            l->line += inserted - removed;
+        }
+    }
+}
+
+static int read_range(LayoutCache* c, const TextBuffer* tb, size_t offset, size_t length) {
+    if (length > c->scratch_capacity) {
+        size_t cap = c->scratch_capacity ? c->scratch_capacity : 4096;
+        while (cap < length) cap *= 2;
+        char* grown = (char*)realloc(c->scratch, cap);
+        if (!grown) return -1;
+        c->scratch = grown;
+        c->scratch_capacity = cap;
+    }
+    tb_read(tb, offset, length, c->scratch);
+    return 0;
+}
+
+// Counts the columns of the line from the last stop still valid, or from
+// its start, where a line of nothing but plain bytes needs no stops. Each
+// stride gets a stop at its first character boundary.
+static int measure(LayoutCache* c, LineLayout* l, const TextBuffer* tb, size_t line_start) {
+    // A byte that didn't decode may have become the lead of a character
+    // reaching the stop, so keep only stops a whole character before.
+    while (l->stop_count > 0 && l->stops[l->stop_count - 1].byte + 4 > l->valid_to) l->stop_count--;
+    size_t base = 0, column = 0;
+    if (l->stop_count > 0) {
+        base = l->stops[l->stop_count - 1].byte;
+        column = l->stops[l->stop_count - 1].column;
+    }
+    size_t n = l->length - base;
+    if (read_range(c, tb, line_start + base, n) != 0) return -1;
+    const char* s = c->scratch;
+
+    l->plain = 0;
+    if (base == 0 && plain_run(s, n) == n) {
+        l->plain = 1;
+        l->columns = n;
+        l->stop_count = 0;
+        return 0;
+    }
+    int needed = (int)(l->length / LAYOUT_STRIDE + 1);
+    if (needed > l->stop_capacity) {
+        LayoutStop* grown = (LayoutStop*)realloc(l->stops, needed * sizeof(LayoutStop));
+        if (!grown) return -1;
+        l->stops = grown;
+        l->stop_capacity = needed;
+    }
+
+    size_t i = 0, next = (base / LAYOUT_STRIDE + 1) * LAYOUT_STRIDE - base;
+    while (i < n) {
+        if (i >= next) {
+            l->stops[l->stop_count].byte = base + i;
+            l->stops[l->stop_count].column = column;
+            l->stop_count++;
+            next = ((base + i) / LAYOUT_STRIDE + 1) * LAYOUT_STRIDE - base;
+        }
+        size_t run = plain_run(s + i, (next < n ? next : n) - i);
+        if (run > 0) {
+            i += run;
+            column += run;
+            continue;
+        }
+        int bytes;
+        column += char_columns(s + i, n - i, column, &bytes);
+        i += bytes;
+    }
+    l->columns = column;
+    return 0;
+}
+
+const LineLayout* layout_line(LayoutCache* c, const TextBuffer* tb, int line) {
+    LineLayout* l = NULL;
+    LineLayout* victim = &c->slots[0];
+    for (int i = 0; i < LAYOUT_SLOTS && !l; i++) {
+        if (c->slots[i].line == line) l = &c->slots[i];
+        else if (c->slots[i].used < victim->used) victim = &c->slots[i];
+    }
+    if (!l) {
+        l = victim;
+        clear_slot(l);
+        l->line = line;
+    }
+    l->used = ++c->tick;
+    if (l->complete) return l;
+
+    l->length = tb_line_length(tb, line);
+    if (measure(c, l, tb, tb_line_start(tb, line)) != 0) {
+        clear_slot(l);
+        return NULL;
+    }
+    l->valid_to = l->length;
+    l->complete = 1;
+    c->lines_laid_out++;
+    return l;
+}
+
+// The last stop at or before byte, or the line start.
+static LayoutStop stop_before_byte(const LineLayout* l, size_t byte) {
+    LayoutStop start = {0, 0};
+    int lo = 0, hi = l->stop_count - 1;
+    while (lo <= hi) {
+        int mid = (lo + hi) / 2;
+        if (l->stops[mid].byte <= byte) {
+            start = l->stops[mid];
+            lo = mid + 1;
+        } else {
+            hi = mid - 1;
+        }
+    }
+    return start;
+}
+
+static int stop_before_column(const LineLayout* l, size_t column) {
+    int found = -1;
+    int lo = 0, hi = l->stop_count - 1;
+    while (lo <= hi) {
+        int mid = (lo + hi) / 2;
+        if (l->stops[mid].column <= column) {
+            found = mid;
+            lo = mid + 1;
+        } else {
+            hi = mid - 1;
+        }
+    }
+    return found;
+}
+
+size_t layout_column(const LineLayout* l, const TextBuffer* tb, size_t line_start, size_t byte) {
+    if (byte > l->length) byte = l->length;
+    if (l->plain) return byte;
+    if (byte == l->length) return l->columns;
+
+    // Stops are at most a stride and a character apart.
+    char chunk[LAYOUT_STRIDE + 8];
+    LayoutStop stop = stop_before_byte(l, byte);
+    size_t n = tb_read(tb, line_start + stop.byte, byte - stop.byte, chunk);
+    size_t column = stop.column;
+    for (size_t i = 0; i < n;) {
+        int bytes;
+        column += char_columns(chunk + i, n - i, column, &bytes);
+        i += bytes;
+    }
+    return column;
+}
+
+size_t layout_byte(const LineLayout* l, const TextBuffer* tb, size_t line_start,
+                   size_t column, size_t* start_column) {
+    if (column >= l->columns) {
+        *start_column = l->columns;
+        return l->length;
+    }
+    if (l->plain) {
+        *start_column = column;
+        return column;
+    }
+
+    char chunk[LAYOUT_STRIDE + 8];
+    int s = stop_before_column(l, column);
+    size_t from = s >= 0 ? l->stops[s].byte : 0;
+    size_t at = s >= 0 ? l->stops[s].column : 0;
+    size_t to = s + 1 < l->stop_count ? l->stops[s + 1].byte : l->length;
+    if (to - from > sizeof(chunk)) to = from + sizeof(chunk);
+    size_t n = tb_read(tb, line_start + from, to - from, chunk);
+    for (size_t i = 0; i < n;) {
+        int bytes;
+        size_t width = char_columns(chunk + i, n - i, at, &bytes);
+        if (at + width > column) {
+            *start_column = at;
+            return from + i;
+        }
+        at += width;
+        i += bytes;
+    }
+    *start_column = at;
+    return from + n;
+}
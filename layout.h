@@ -0,0 +1,77 @@
+#ifndef LAYOUT_H
+#define LAYOUT_H
+
+#include <stddef.h>
+
+#include "text_buffer.h"
+
+// Display columns of lines. A UTF-8 character takes zero, one or two
+// columns, a tab runs to the next multiple of LAYOUT_TAB_WIDTH, and any
+// other control byte, or a byte that doesn't decode, takes one. A line's
+// layout keeps the column of a character boundary about every
+// LAYOUT_STRIDE bytes, so placing the cursor or drawing anywhere on a long
+// line reads only the stride around that spot. Layouts are cached by line
+// number in a few slots that move with edits; an edit drops only the lines
+// it removed and the stops after its first changed byte.
+
+#define LAYOUT_TAB_WIDTH 4
+#define LAYOUT_STRIDE 1024
+#define LAYOUT_SLOTS 64
+
+typedef struct {
+    size_t byte;
+    size_t column;
+} LayoutStop;
+
+typedef struct {
+    int line;
+    unsigned long long used;
+    size_t length;
+    size_t columns;
+    // Every byte is printable ASCII, so columns are byte offsets and there
+    // are no stops.
+    int plain;
+    LayoutStop* stops;
+    int stop_count;
+    int stop_capacity;
+    // Stops from valid_to on need measuring again, and columns too unless
+    // complete.
+    int complete;
+    size_t valid_to;
+} LineLayout;
+
+typedef struct {
+    LineLayout slots[LAYOUT_SLOTS];
+    unsigned long long tick;
+    char* scratch;
+    size_t scratch_capacity;
+    unsigned long long lines_laid_out;
+} LayoutCache;
+
+void layout_init(LayoutCache* c);
+void layout_free(LayoutCache* c);
+
+// Reports that line first, from byte offset on, and the removed lines after
+// it were replaced by first and inserted new lines, as for hl_edit().
+void layout_edit(LayoutCache* c, int first, size_t offset, int removed, int inserted);
+
+// The layout of line. Valid until the next call; NULL when out of memory.
+const LineLayout* layout_line(LayoutCache* c, const TextBuffer* tb, int line);
+
+// The column at which the character at byte starts.
+size_t layout_column(const LineLayout* l, const TextBuffer* tb, size_t line_start, size_t byte);
+
+// The character covering column, or the line end when column is past it.
+// Stores the column that character starts at.
+size_t layout_byte(const LineLayout* l, const TextBuffer* tb, size_t line_start,
+                   size_t column, size_t* start_column);
+
+// Decodes the character at s, which has n bytes left, and returns its
+// length. A byte that doesn't start a valid character decodes to U+FFFD
+// with length 1.
+int layout_decode(const char* s, size_t n, unsigned int* cp);
+
+// Columns of a printable code point: 0 for combining marks, 2 for wide ones.
+int layout_width(unsigned int cp);
+
+#endif
@@ -0,0 +1,188 @@
+#include "pool.h"
+
+#include <stdlib.h>
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+#include "profile.h"
+
+#define POOL_DEQUE_INITIAL 64
+
+typedef struct {
+    PoolTask task;
+    void* arg;
+} PoolItem;
+
+// Ring of items, its capacity a power of two. The owner works the back and
+// thieves the front; each end takes the same short lock.
+typedef struct {
+    std::mutex lock;
+    PoolItem* items;
+    unsigned int head;
+    unsigned int count;
+    unsigned int capacity;
+} PoolDeque;
+
+static std::thread workers[POOL_MAX_THREADS];
+static PoolDeque deques[POOL_MAX_THREADS];
+static int thread_count = 0;
+static int running = 0;
+static std::atomic<int> stopping(0);
+static std::atomic<int> queued(0);
+static std::atomic<int> pending(0);
+static std::atomic<unsigned int> next_deque(0);
+static std::atomic<unsigned long long> steals(0);
+static std::mutex sleep_mutex;
+static std::condition_variable work_ready;
+static std::condition_variable all_done;
+
+// The deque of the calling thread, -1 outside the pool.
+static thread_local int own = -1;
+
+static int push_back(PoolDeque* d, PoolItem item) {
+    std::lock_guard<std::mutex> lock(d->lock);
+    if (d->count == d->capacity) {
+        unsigned int cap = d->capacity ? d->capacity * 2 : POOL_DEQUE_INITIAL;
+        PoolItem* grown = (PoolItem*)malloc(cap * sizeof(PoolItem));
+        if (!grown) return -1;
+        for (unsigned int i = 0; i < d->count; i++) {
+            grown[i] = d->items[(d->head + i) & (d->capacity - 1)];
+        }
+        free(d->items);
+        d->items = grown;
+        d->head = 0;
+        d->capacity = cap;
+    }
+    d->items[(d->head + d->count) & (d->capacity - 1)] = item;
+    d->count++;
+    return 0;
+}
+
+static int pop_back(PoolDeque* d, PoolItem* out) {
+    std::lock_guard<std::mutex> lock(d->lock);
+    if (d->count == 0) return 0;
+    d->count--;
+    *out = d->items[(d->head + d->count) & (d->capacity - 1)];
+    return 1;
+}
+
+static int pop_front(PoolDeque* d, PoolItem* out) {
+    std::lock_guard<std::mutex> lock(d->lock);
+    if (d->count == 0) return 0;
+    *out = d->items[d->head];
+    d->head = (d->head + 1) & (d->capacity - 1);
+    d->count--;
+    return 1;
+}
+
+// Own work first, newest first; then the oldest task of the next worker
+// along that has any.
+static int take(int self, PoolItem* item) {
+    if (pop_back(&deques[self], item)) return 1;
+    for (int i = 1; i < thread_count; i++) {
+        if (pop_front(&deques[(self + i) % thread_count], item)) {
+            steals.fetch_add(1, std::memory_order_relaxed);
+            return 1;
+        }
+    }
+    return 0;
+}
+
+static void finish() {
+    if (pending.fetch_sub(1) == 1) {
+        std::lock_guard<std::mutex> lock(sleep_mutex);
+        all_done.notify_all();
+    }
+}
+
+static void worker_main(int self) {
+    own = self;
+    profile_thread("pool");
+    while (!stopping.load()) {
+        PoolItem item;
+        if (take(self, &item)) {
+            queued.fetch_sub(1);
+            item.task(item.arg);
+            finish();
+            continue;
+        }
+        std::unique_lock<std::mutex> lock(sleep_mutex);
+        work_ready.wait(lock, [] { return stopping.load() || queued.load() > 0; });
+    }
+    own = -1;
+}
+
+int pool_start(int threads) {
+    if (running) return -1;
+    if (threads <= 0) threads = (int)std::thread::hardware_concurrency() - 1;
+    if (threads < 1) threads = 1;
+    if (threads > POOL_MAX_THREADS) threads = POOL_MAX_THREADS;
+
+    stopping = 0;
+    queued = 0;
+    pending = 0;
+    steals = 0;
+    thread_count = threads;
+    for (int i = 0; i < threads; i++) workers[i] = std::thread(worker_main, i);
+    running = 1;
+    return 0;
+}
+
+void pool_stop() {
+    if (!running) return;
+    {
+        std::lock_guard<std::mutex> lock(sleep_mutex);
+        stopping = 1;
+    }
+    work_ready.notify_all();
+    for (int i = 0; i < thread_count; i++) workers[i].join();
+    for (int i = 0; i < thread_count; i++) {
+        free(deques[i].items);
+        deques[i].items = NULL;
+        deques[i].head = deques[i].count = deques[i].capacity = 0;
+    }
+    queued = 0;
+    pending = 0;
+    running = 0;
+    {
+        std::lock_guard<std::mutex> lock(sleep_mutex);
+        all_done.notify_all();
+    }
+}
+
+int pool_submit(PoolTask task, void* arg) {
+    if (!running) return -1;
+    int d = own >= 0 ? own : (int)(next_deque.fetch_add(1) % (unsigned int)thread_count);
+    PoolItem item = {task, arg};
+    pending.fetch_add(1);
+    if (push_back(&deques[d], item) != 0) {
+        finish();
+        return -1;
+    }
+    queued.fetch_add(1);
+    std::lock_guard<std::mutex> lock(sleep_mutex);
+    work_ready.notify_one();
+    return 0;
+}
+
+int pool_wait(int timeout_ms) {
+    std::unique_lock<std::mutex> lock(sleep_mutex);
+    if (timeout_ms < 0) {
+        all_done.wait(lock, [] { return pending.load() == 0; });
+        return 1;
+    }
+    return all_done.wait_for(lock, std::chrono::milliseconds(timeout_ms),
+                             [] { return pending.load() == 0; }) ? 1 : 0;
+}
+
+int pool_threads() {
+    return running ? thread_count : 0;
+}
+
+unsigned long long pool_steals() {
+    return steals.load();
+}
@@ -0,0 +1,32 @@
+#ifndef POOL_H
+#define POOL_H
+
+// Work-stealing thread pool. Each worker owns a deque of tasks: it pushes
+// and pops its own at the back, so work a task spawns runs next while it is
+// still warm, and a worker that runs dry steals from the front of another's
+// deque, taking the oldest and usually largest piece of work. Tasks
+// submitted from outside the pool are dealt out round-robin.
+
+#define POOL_MAX_THREADS 32
+
+typedef void (*PoolTask)(void* arg);
+
+// threads <= 0 means one per core but one, leaving a core to the input
+// thread. Returns -1 if the pool is already running.
+int pool_start(int threads);
+
+// Lets the running tasks finish, drops the queued ones and joins the workers.
+void pool_stop();
+
+int pool_submit(PoolTask task, void* arg);
+
+// Waits up to timeout_ms, or forever when negative, for every submitted task
+// to finish. Returns 1 once none are left.
+int pool_wait(int timeout_ms);
+
+int pool_threads();
+
+// Tasks taken from another worker's deque since pool_start().
+unsigned long long pool_steals();
+
+#endif
@@ -0,0 +1,209 @@
+#include "process.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <spawn.h>
+#include <sys/wait.h>
+#include <unistd.h>
+extern char** environ;
+#endif
+
+#define PROCESS_COMMAND_MAX 2048
+
+#ifdef _WIN32
+
+// Starts the child suspended so it is inside the job object before it runs
+// any code.
+int process_spawn(Process* p, const char* const* argv, ProcessStream* out, ProcessStream* err) {
+    char cmd[PROCESS_COMMAND_MAX];
+    size_t used = 0;
+    cmd[0] = '\0';
+    for (int i = 0; argv[i]; i++) {
+        used += snprintf(cmd + used, sizeof(cmd) - used, "%s\"%s\"", i ? " " : "", argv[i]);
+        if (used >= sizeof(cmd)) return -1;
+    }
+
+    SECURITY_ATTRIBUTES sa = {sizeof(sa), NULL, TRUE};
+    HANDLE out_read = NULL, out_write = NULL, err_read, err_write;
+    if (out && !CreatePipe(&out_read, &out_write, &sa, 0)) return -1;
+    if (!CreatePipe(&err_read, &err_write, &sa, 0)) {
+        if (out) {
+            CloseHandle(out_read);
+            CloseHandle(out_write);
+        }
+        return -1;
+    }
+    if (out) SetHandleInformation(out_read, HANDLE_FLAG_INHERIT, 0);
+    SetHandleInformation(err_read, HANDLE_FLAG_INHERIT, 0);
+    HANDLE nul = CreateFileA("NUL", GENERIC_READ | GENERIC_WRITE,
+                             FILE_SHARE_READ | FILE_SHARE_WRITE,
+                             &sa, OPEN_EXISTING, 0, NULL);
+
+    STARTUPINFOA si;
+    ZeroMemory(&si, sizeof(si));
+    si.cb = sizeof(si);
+    si.dwFlags = STARTF_USESTDHANDLES;
+    si.hStdInput = nul;
+    si.hStdOutput = out ? out_write : nul;
+    si.hStdError = err_write;
+
+    PROCESS_INFORMATION pi;
+    BOOL ok = CreateProcessA(NULL, cmd, NULL, NULL, TRUE,
+                             CREATE_NO_WINDOW | CREATE_SUSPENDED, NULL, NULL, &si, &pi);
+    if (out) CloseHandle(out_write);
+    CloseHandle(err_write);
+    if (nul != INVALID_HANDLE_VALUE) CloseHandle(nul);
+    if (!ok) {
+        if (out) CloseHandle(out_read);
+        CloseHandle(err_read);
+        return -1;
+    }
+
+    HANDLE job = CreateJobObjectA(NULL, NULL);
+    if (job && !AssignProcessToJobObject(job, pi.hProcess)) {
+        CloseHandle(job);
+        job = NULL;
+    }
+    ResumeThread(pi.hThread);
+    CloseHandle(pi.hThread);
+    p->handle = pi.hProcess;
+    p->job = job;
+    if (out) *out = out_read;
+    *err = err_read;
+    return 0;
+}
+
+void process_wait(Process* p) {
+    WaitForSingleObject(p->handle, INFINITE);
+}
+
+int process_reap(Process* p) {
+    DWORD status = 1;
+    GetExitCodeProcess(p->handle, &status);
+    CloseHandle(p->handle);
+    p->handle = NULL;
+    return (int)status;
+}
+
+void process_release(Process* p) {
+    if (p->job) CloseHandle(p->job);
+    p->job = NULL;
+}
+
+int process_running(const Process* p) {
+    return p->handle != NULL;
+}
+
+void process_kill(Process* p) {
+    if (p->job) TerminateJobObject(p->job, 1);
+    else if (p->handle) TerminateProcess(p->handle, 1);
+}
+
+int process_read(ProcessStream s, char* buf, size_t size) {
+    DWORD n = 0;
+    if (!ReadFile(s, buf, (DWORD)size, &n, NULL)) return 0;
+    return (int)n;
+}
+
+void process_close(ProcessStream s) {
+    CloseHandle(s);
+}
+
+#else
+
+static int open_pipe(int fds[2]) {
+    if (pipe(fds) != 0) return -1;
+    fcntl(fds[0], F_SETFD, FD_CLOEXEC);
+    fcntl(fds[1], F_SETFD, FD_CLOEXEC);
+    return 0;
+}
+
+int process_spawn(Process* p, const char* const* argv, ProcessStream* out, ProcessStream* err) {
+    int out_fds[2] = {-1, -1}, err_fds[2];
+    if (out && open_pipe(out_fds) != 0) return -1;
+    if (open_pipe(err_fds) != 0) {
+        if (out) {
+            close(out_fds[0]);
+            close(out_fds[1]);
+        }
+        return -1;
+    }
+
+    posix_spawn_file_actions_t actions;
+    posix_spawn_file_actions_init(&actions);
+    posix_spawn_file_actions_addopen(&actions, STDIN_FILENO, "/dev/null", O_RDONLY, 0);
+    if (out) {
+        posix_spawn_file_actions_adddup2(&actions, out_fds[1], STDOUT_FILENO);
+    } else {
+        posix_spawn_file_actions_addopen(&actions, STDOUT_FILENO, "/dev/null", O_WRONLY, 0);
+    }
+    posix_spawn_file_actions_adddup2(&actions, err_fds[1], STDERR_FILENO);
+
+    posix_spawnattr_t attr;
+    posix_spawnattr_init(&attr);
+    posix_spawnattr_setflags(&attr, POSIX_SPAWN_SETPGROUP);
+    posix_spawnattr_setpgroup(&attr, 0);
+
+    pid_t pid;
+    int rc = posix_spawnp(&pid, argv[0], &actions, &attr, (char* const*)argv, environ);
+    posix_spawn_file_actions_destroy(&actions);
+    posix_spawnattr_destroy(&attr);
+    if (out) close(out_fds[1]);
+    close(err_fds[1]);
+    if (rc != 0) {
+        if (out) close(out_fds[0]);
+        close(err_fds[0]);
+        return -1;
+    }
+
+    p->pid = pid;
+    p->pgid = pid;
+    if (out) *out = out_fds[0];
+    *err = err_fds[0];
+    return 0;
+}
+
+void process_wait(Process* p) {
+    siginfo_t info;
+    while (waitid(P_PID, p->pid, &info, WEXITED | WNOWAIT) != 0 && errno == EINTR) {}
+}
+
+int process_reap(Process* p) {
+    int status = 0;
+    while (waitpid(p->pid, &status, 0) < 0 && errno == EINTR) {}
+    p->pid = 0;
+    return WIFEXITED(status) ? WEXITSTATUS(status) : 128 + WTERMSIG(status);
+}
+
+void process_release(Process* p) {
+    p->pgid = 0;
+}
+
+int process_running(const Process* p) {
+    return p->pid > 0;
+}
+
+void process_kill(Process* p) {
+    if (p->pgid > 0) kill(-p->pgid, SIGKILL);
+}
+
+int process_read(ProcessStream s, char* buf, size_t size) {
+    ssize_t n;
+    do {
+        n = read(s, buf, size);
+    } while (n < 0 && errno == EINTR);
+    return n > 0 ? (int)n : 0;
+}
+
+void process_close(ProcessStream s) {
+    close(s);
+}
+
+#endif
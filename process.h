@@ -0,0 +1,49 @@
+#ifndef PROCESS_H
+#define PROCESS_H
+
+#include <stddef.h>
+
+// Child processes with stdout and stderr on pipes and the null device as
+// stdin. On Windows each child runs in a job object, on POSIX it leads its
+// own process group, so process_kill() also reaches everything it started.
+
+#ifdef _WIN32
+typedef void* ProcessStream;
+#else
+typedef int ProcessStream;
+#endif
+
+typedef struct {
+#ifdef _WIN32
+    void* handle;
+    void* job;
+#else
+    int pid;
+    int pgid;
+#endif
+} Process;
+
+// out may be NULL to send stdout to the null device.
+int process_spawn(Process* p, const char* const* argv, ProcessStream* out, ProcessStream* err);
+
+// Blocks until the child exits but keeps it around, so a process_kill() from
+// another thread can never hit a recycled pid. Follow with process_reap().
+void process_wait(Process* p);
+
+// Releases an exited child and returns its exit code, 128 + the signal
+// number when a signal killed it. Processes it started may live on and hold
+// its pipes open; process_kill() still reaches them until process_release().
+int process_reap(Process* p);
+
+// Forgets the child's process group or job object. Call once its streams
+// have been drained.
+void process_release(Process* p);
+
+int process_running(const Process* p);
+void process_kill(Process* p);
+
+// Returns the number of bytes read, 0 at end of stream.
+int process_read(ProcessStream s, char* buf, size_t size);
+void process_close(ProcessStream s);
+
+#endif
@@ -0,0 +1,195 @@
+#include "profile.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <atomic>
+#include <chrono>
+
+typedef std::chrono::steady_clock Clock;
+
+// The writer claims a slot before overwriting it and publishes it after,
+// so a reader that copied a slot can tell from the claim count whether
+// the writer got to it meanwhile. Fields are relaxed atomics to keep the
+// racing copy well defined.
+typedef struct {
+    std::atomic<unsigned long long> start;
+    std::atomic<unsigned long long> end;
+    std::atomic<int> stage;
+} ProfileSpan;
+
+typedef struct {
+    ProfileSpan spans[PROFILE_RING_SIZE];
+    std::atomic<unsigned long long> claimed;
+    std::atomic<unsigned long long> published;
+    std::atomic<const char*> name;
+    std::atomic<int> taken;
+} ProfileRing;
+
+typedef struct {
+    unsigned long long start;
+    unsigned long long end;
+    int stage;
+} SpanCopy;
+
+const char* const profile_stage_names[PROFILE_STAGES] = {
+    "input", "edit", "suggest", "layout", "output", "harvest", "journal", "index"
+};
+
+static const Clock::time_point origin = Clock::now();
+
+// Traces walk the first ring_count rings, every one that was ever taken.
+static ProfileRing rings[PROFILE_MAX_THREADS];
+static std::atomic<int> ring_count(0);
+
+// Gives the ring back when its thread exits. Every editor_open() starts new
+// background threads, and they take over the rings of the ones before.
+struct ProfileOwner {
+    ProfileRing* ring;
+    ~ProfileOwner() {
+        if (ring) ring->taken.store(0, std::memory_order_release);
+    }
+};
+
+static thread_local ProfileOwner owner = {NULL};
+static thread_local int registered = 0;
+static thread_local unsigned long long totals[PROFILE_STAGES];
+
+// Frames belong to the thread that marks them and are only read there.
+static ProfileFrame frames[PROFILE_FRAMES];
+static unsigned long long frame_count = 0;
+static ProfileFrame open_frame;
+static int frame_open = 0;
+static int frame_ring = -1;
+
+unsigned long long profile_now() {
+    return (unsigned long long)std::chrono::duration_cast<std::chrono::nanoseconds>(
+        Clock::now() - origin).count();
+}
+
+static ProfileRing* own() {
+    if (!registered) {
+        registered = 1;
+        for (int i = 0; i < PROFILE_MAX_THREADS; i++) {
+            int expected = 0;
+            if (!rings[i].taken.compare_exchange_strong(expected, 1)) continue;
+            rings[i].name.store(NULL);
+            owner.ring = &rings[i];
+            int count = ring_count.load();
+            while (count <= i && !ring_count.compare_exchange_weak(count, i + 1)) {}
+            break;
+        }
+    }
+    return owner.ring;
+}
+
+void profile_record(int stage, unsigned long long start_ns, unsigned long long end_ns) {
+    totals[stage] += end_ns - start_ns;
+    ProfileRing* r = own();
+    if (!r) return;
+    unsigned long long n = r->published.load(std::memory_order_relaxed);
+    r->claimed.store(n + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    ProfileSpan* s = &r->spans[n & (PROFILE_RING_SIZE - 1)];
+    s->start.store(start_ns, std::memory_order_relaxed);
+    s->end.store(end_ns, std::memory_order_relaxed);
+    s->stage.store(stage, std::memory_order_relaxed);
+    r->published.store(n + 1, std::memory_order_release);
+}
+
+void profile_thread(const char* name) {
+    ProfileRing* r = own();
+    if (r) r->name.store(name);
+}
+
+unsigned long long profile_stage_total(int stage) {
+    return totals[stage];
+}
+
+void profile_frame_begin() {
+    open_frame.start_ns = profile_now();
+    for (int i = 0; i < PROFILE_STAGES; i++) open_frame.stage_ns[i] = totals[i];
+    frame_open = 1;
+    ProfileRing* r = own();
+    frame_ring = r ? (int)(r - rings) : -1;
+}
+
+void profile_frame_end() {
+    if (!frame_open) return;
+    frame_open = 0;
+    ProfileFrame* f = &frames[frame_count % PROFILE_FRAMES];
+    f->start_ns = open_frame.start_ns;
+    f->total_ns = profile_now() - open_frame.start_ns;
+    for (int i = 0; i < PROFILE_STAGES; i++) f->stage_ns[i] = totals[i] - open_frame.stage_ns[i];
+    f->number = frame_count++;
+}
+
+int profile_last_frame(ProfileFrame* frame) {
+    if (frame_count == 0) return 0;
+    *frame = frames[(frame_count - 1) % PROFILE_FRAMES];
+    return 1;
+}
+
+// Copies the ring's spans, oldest first, and returns how many are intact.
+static int copy_ring(ProfileRing* r, SpanCopy* out) {
+    unsigned long long published = r->published.load(std::memory_order_acquire);
+    unsigned long long first = published > PROFILE_RING_SIZE ? published - PROFILE_RING_SIZE : 0;
+    for (unsigned long long i = first; i < published; i++) {
+        ProfileSpan* s = &r->spans[i & (PROFILE_RING_SIZE - 1)];
+        out[i - first].start = s->start.load(std::memory_order_relaxed);
+        out[i - first].end = s->end.load(std::memory_order_relaxed);
+        out[i - first].stage = s->stage.load(std::memory_order_relaxed);
+    }
+    std::atomic_thread_fence(std::memory_order_acquire);
+    // Slots the writer claimed since no longer hold what was copied.
+    unsigned long long claimed = r->claimed.load(std::memory_order_relaxed);
+    unsigned long long valid = claimed > PROFILE_RING_SIZE ? claimed - PROFILE_RING_SIZE : 0;
+    if (valid <= first) return (int)(published - first);
+    if (valid >= published) return 0;
+    memmove(out, out + (valid - first), (published - valid) * sizeof(SpanCopy));
+    return (int)(published - valid);
+}
+
+static void emit(FILE* f, int* first, const char* name, int tid, unsigned long long start,
+                 unsigned long long end) {
+    fprintf(f, "%s{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f}",
+            *first ? "" : ",\n", name, tid, start / 1000.0, (end - start) / 1000.0);
+    *first = 0;
+}
+
+int profile_write_trace(const char* path) {
+    SpanCopy* copy = (SpanCopy*)malloc(PROFILE_RING_SIZE * sizeof(SpanCopy));
+    if (!copy) return -1;
+    FILE* f = fopen(path, "wb");
+    if (!f) {
+        free(copy);
+        return -1;
+    }
+
+    fprintf(f, "{\"traceEvents\":[\n");
+    int first = 1;
+    int threads = ring_count.load();
+    if (threads > PROFILE_MAX_THREADS) threads = PROFILE_MAX_THREADS;
+    for (int t = 0; t < threads; t++) {
+        const char* name = rings[t].name.load();
+        fprintf(f, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,"
+                   "\"args\":{\"name\":\"%s\"}}",
+                first ? "" : ",\n", t, name ? name : "thread");
+        first = 0;
+
+        int count = copy_ring(&rings[t], copy);
+        for (int i = 0; i < count; i++) {
+            if (copy[i].stage < 0 || copy[i].stage >= PROFILE_STAGES) continue;
+            emit(f, &first, profile_stage_names[copy[i].stage], t, copy[i].start, copy[i].end);
+        }
+    }
+
+    unsigned long long oldest = frame_count > PROFILE_FRAMES ? frame_count - PROFILE_FRAMES : 0;
+    for (unsigned long long i = oldest; i < frame_count; i++) {
+        ProfileFrame* fr = &frames[i % PROFILE_FRAMES];
+        emit(f, &first, "frame", frame_ring, fr->start_ns, fr->start_ns + fr->total_ns);
+    }
+    fprintf(f, "\n],\"displayTimeUnit\":\"ms\"}\n");
+    free(copy);
+    return fclose(f) == 0 ? 0 : -1;
+}
@@ -0,0 +1,73 @@
+#ifndef PROFILE_H
+#define PROFILE_H
+
+// Scoped timers for the hot path. Each thread records its spans into its
+// own ring, which it alone writes; readers copy the ring and drop whatever
+// the writer lapped meanwhile, so recording never takes a lock or waits.
+// A thread's ring is handed on when it exits, so PROFILE_MAX_THREADS
+// bounds the threads recording at once, not those ever started.
+// The UI thread also groups its spans into frames, one per batch of keys
+// plus the redraw that follows, kept in a ring of their own.
+//
+// profile_write_trace() exports the rings in Chrome's trace event format,
+// for chrome://tracing or Perfetto.
+
+#define PROFILE_RING_SIZE 4096
+#define PROFILE_FRAMES 256
+#define PROFILE_MAX_THREADS 16
+
+enum {
+    PROFILE_INPUT,
+    PROFILE_EDIT,
+    PROFILE_SUGGEST,
+    PROFILE_LAYOUT,
+    PROFILE_OUTPUT,
+    PROFILE_HARVEST,
+    PROFILE_JOURNAL,
+    PROFILE_INDEX,
+    PROFILE_STAGES
+};
+
+typedef struct {
+    unsigned long long start_ns;
+    unsigned long long total_ns;
+    unsigned long long stage_ns[PROFILE_STAGES];
+    unsigned long long number;
+} ProfileFrame;
+
+extern const char* const profile_stage_names[PROFILE_STAGES];
+
+// Nanoseconds since the program started.
+unsigned long long profile_now();
+
+void profile_record(int stage, unsigned long long start_ns, unsigned long long end_ns);
+
+// Names the calling thread in traces.
+void profile_thread(const char* name);
+
+// The calling thread's running total for stage.
+unsigned long long profile_stage_total(int stage);
+
+// Frames cover the calling thread's stages; beginning one while another is
+// open starts it over.
+void profile_frame_begin();
+void profile_frame_end();
+
+// Copies the newest finished frame; returns 0 when there is none yet.
+int profile_last_frame(ProfileFrame* frame);
+
+int profile_write_trace(const char* path);
+
+struct ProfileScope {
+    int stage;
+    unsigned long long start;
+
+    explicit ProfileScope(int stage) : stage(stage), start(profile_now()) {}
+    ~ProfileScope() { profile_record(stage, start, profile_now()); }
+};
+
+#define PROFILE_JOIN2(a, b) a##b
+#define PROFILE_JOIN(a, b) PROFILE_JOIN2(a, b)
+#define PROFILE_SCOPE(stage) ProfileScope PROFILE_JOIN(profile_scope_, __LINE__)(stage)
+
+#endif
@@ -0,0 +1,191 @@
+#include "replay.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+typedef struct {
+    const char* name;
+    int key;
+} KeyName;
+
+static const KeyName key_names[] = {
+    {"Enter", KEY_ENTER},
+    {"Tab", KEY_TAB},
+    {"BS", KEY_BACKSPACE},
+    {"Esc", KEY_ESCAPE},
+    {"Up", KEY_UP},
+    {"Down", KEY_DOWN},
+    {"Left", KEY_LEFT},
+    {"Right", KEY_RIGHT},
+    {"Home", KEY_HOME},
+    {"End", KEY_END},
+    {"PgUp", KEY_PAGE_UP},
+    {"PgDn", KEY_PAGE_DOWN},
+    {"Del", KEY_DELETE},
+    {"F1", KEY_F1},
+    {"F2", KEY_F2},
+    {"F3", KEY_F3},
+    {"F4", KEY_F4},
+    {"F5", KEY_F5},
+    {"F6", KEY_F6},
+    {"F7", KEY_F7},
+    {"F8", KEY_F8},
+    {"F9", KEY_F9},
+    {"F10", KEY_F10},
+    {"F11", KEY_F11},
+    {"F12", KEY_F12}
+};
+
+#define KEY_NAME_COUNT (int)(sizeof(key_names) / sizeof(key_names[0]))
+
+#define PASTE_OPEN "<Paste>"
+#define PASTE_CLOSE "</Paste>"
+
+static void write_paste(FILE* f, const char* s, int length) {
+    fputs(PASTE_OPEN, f);
+    for (int i = 0; i < length; i++) {
+        if (s[i] == '\n') fputs("<Enter>\n", f);
+        else if (s[i] == '\t') fputs("<Tab>", f);
+        else if (s[i] == '<') fputs("<lt>", f);
+        else fputc(s[i], f);
+    }
+    fputs(PASTE_CLOSE, f);
+}
+
+void replay_write(FILE* f, const InputEvent* ev) {
+    if (ev->key == KEY_PASTE) {
+        write_paste(f, ev->text, ev->length);
+        return;
+    }
+    if (ev->key == KEY_CHAR) {
+        if (ev->ch == '<') {
+            fputs("<lt>", f);
+        } else if (ev->ch >= 1 && ev->ch <= 26) {
+            fprintf(f, "<C-%c>", 'a' + ev->ch - 1);
+        } else if ((ev->ch >= 32 && ev->ch <= 126) || (ev->ch >= 128 && ev->ch <= 255)) {
+            fputc(ev->ch, f);
+        }
+        return;
+    }
+    for (int i = 0; i < KEY_NAME_COUNT; i++) {
+        if (key_names[i].key == ev->key) {
+            fprintf(f, "<%s>", key_names[i].name);
+            if (ev->key == KEY_ENTER) fputc('\n', f);
+            return;
+        }
+    }
+}
+
+// name is the text between the brackets.
+static int parse_name(const char* name, size_t length, InputEvent* ev) {
+    ev->ch = 0;
+    if (length == 2 && memcmp(name, "lt", 2) == 0) {
+        ev->key = KEY_CHAR;
+        ev->ch = '<';
+        return 0;
+    }
+    if (length == 3 && name[0] == 'C' && name[1] == '-' && name[2] >= 'a' && name[2] <= 'z') {
+        ev->key = KEY_CHAR;
+        ev->ch = name[2] - 'a' + 1;
+        return 0;
+    }
+    for (int i = 0; i < KEY_NAME_COUNT; i++) {
+        if (strlen(key_names[i].name) == length && memcmp(key_names[i].name, name, length) == 0) {
+            ev->key = key_names[i].key;
+            return 0;
+        }
+    }
+    return -1;
+}
+
+static int starts_with(const char* s, long length, const char* prefix) {
+    size_t n = strlen(prefix);
+    return length >= (long)n && memcmp(s, prefix, n) == 0;
+}
+
+// Reads the text of a paste starting at data[i], just past <Paste>, into
+// text. Returns the index of the '>' closing </Paste>, or -1.
+static long parse_paste(const char* data, long size, long i, char* text, int* length) {
+    *length = 0;
+    for (; i < size; i++) {
+        char c = data[i];
+        if (c == '\n' || c == '\r') continue;
+        if (c != '<') {
+            text[(*length)++] = c;
+        } else if (starts_with(data + i, size - i, PASTE_CLOSE)) {
+            return i + (long)strlen(PASTE_CLOSE) - 1;
+        } else if (starts_with(data + i, size - i, "<Enter>")) {
+            text[(*length)++] = '\n';
+            i += 6;
+        } else if (starts_with(data + i, size - i, "<Tab>")) {
+            text[(*length)++] = '\t';
+            i += 4;
+        } else if (starts_with(data + i, size - i, "<lt>")) {
+            text[(*length)++] = '<';
+            i += 3;
+        } else {
+            return -1;
+        }
+    }
+    return -1;
+}
+
+int replay_load(const char* path, InputEvent** events) {
+    FILE* f = fopen(path, "rb");
+    if (!f) return -1;
+    fseek(f, 0, SEEK_END);
+    long size = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    char* data = (char*)malloc(size > 0 ? size : 1);
+    // Events first, then the text of every paste, which can't be longer
+    // than the file.
+    InputEvent* out = (InputEvent*)malloc((size > 0 ? size : 1) * (sizeof(InputEvent) + 1));
+    if (!data || !out || (long)fread(data, 1, size, f) != size) {
+        free(data);
+        free(out);
+        fclose(f);
+        return -1;
+    }
+    fclose(f);
+
+    // Every event takes at least one byte, so size events always fit.
+    char* text = (char*)(out + (size > 0 ? size : 1));
+    int count = 0;
+    for (long i = 0; i < size; i++) {
+        char c = data[i];
+        if (c == '\n' || c == '\r') continue;
+        memset(&out[count], 0, sizeof(InputEvent));
+        if (c != '<') {
+            out[count].key = KEY_CHAR;
+            out[count].ch = (unsigned char)c;
+            count++;
+            continue;
+        }
+        if (starts_with(data + i, size - i, PASTE_OPEN)) {
+            int length;
+            i = parse_paste(data, size, i + (long)strlen(PASTE_OPEN), text, &length);
+            if (i < 0) {
+                free(data);
+                free(out);
+                return -1;
+            }
+            out[count].key = KEY_PASTE;
+            out[count].text = text;
+            out[count].length = length;
+            text += length;
+            count++;
+            continue;
+        }
+        const char* end = (const char*)memchr(data + i + 1, '>', size - i - 1);
+        if (!end || parse_name(data + i + 1, end - (data + i + 1), &out[count]) != 0) {
+            free(data);
+            free(out);
+            return -1;
+        }
+        count++;
+        i = end - data;
+    }
+    free(data);
+    *events = out;
+    return count;
+}
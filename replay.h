@@ -0,0 +1,25 @@
+#ifndef REPLAY_H
+#define REPLAY_H
+
+#include <stdio.h>
+
+#include "input.h"
+
+// Keystroke scripts, as written by the editor's --record option and read
+// by the replay benchmark. Printable characters and the bytes of UTF-8
+// characters stand for themselves, and every other key is a name in angle
+// brackets: <Enter> <Tab> <BS> <Esc> <Up> <Down> <Left> <Right> <Home>
+// <End> <PgUp> <PgDn> <Del> <F1>..<F12>, <C-a>..<C-z> for control
+// characters and <lt> for '<'. A paste is its text between <Paste> and
+// </Paste>, where only <Enter>, <Tab> and <lt> may appear. Line breaks in
+// the file are ignored; the writer adds one after each <Enter> so a
+// recording reads like the text that was typed.
+
+void replay_write(FILE* f, const InputEvent* ev);
+
+// Returns the number of events read into a malloc'd array, or -1 if the
+// file can't be read or names an unknown key. The text of pastes lives in
+// the same allocation, so freeing the array frees it too.
+int replay_load(const char* path, InputEvent** events);
+
+#endif
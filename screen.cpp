@@ -0,0 +1,373 @@
+#include "screen.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sys/ioctl.h>
+#include <unistd.h>
+#endif
+
+// Unchanged runs shorter than this are rewritten rather than skipped, since
+// the cursor motion to jump them costs about as much.
+#define MERGE_GAP 4
+
+static void out_bytes(Screen* s, const char* data, size_t length) {
+    if (s->out_length + length > s->out_capacity) {
+        size_t cap = s->out_capacity ? s->out_capacity : 4096;
+        while (cap < s->out_length + length) cap *= 2;
+        char* grown = (char*)realloc(s->out, cap);
+        if (!grown) return;
+        s->out = grown;
+        s->out_capacity = cap;
+    }
+    memcpy(s->out + s->out_length, data, length);
+    s->out_length += length;
+}
+
+static void out_str(Screen* s, const char* str) {
+    out_bytes(s, str, strlen(str));
+}
+
+static void out_flush(Screen* s) {
+    s->bytes_emitted += s->out_length;
+#ifndef _WIN32
+    if (s->backend == SCREEN_ANSI) {
+        size_t done = 0;
+        while (done < s->out_length) {
+            ssize_t n = write(STDOUT_FILENO, s->out + done, s->out_length - done);
+            if (n <= 0) break;
+            done += (size_t)n;
+        }
+    }
+#endif
+    s->out_length = 0;
+}
+
+static int ansi_color(unsigned short attr, int shift) {
+    int bits = (attr >> shift) & 0x7;
+    return ((bits & 4) ? 1 : 0) | ((bits & 2) ? 2 : 0) | ((bits & 1) ? 4 : 0);
+}
+
+static void ansi_attr(Screen* s, unsigned short attr) {
+    if (s->out_attr == attr) return;
+    char seq[32];
+    int fg = ansi_color(attr, 0) + ((attr & ATTR_FG_INTENSITY) ? 90 : 30);
+    int bg = ansi_color(attr, 4) + ((attr & ATTR_BG_INTENSITY) ? 100 : 40);
+    snprintf(seq, sizeof(seq), "\x1b[%d;%dm", fg, bg);
+    out_str(s, seq);
+    s->out_attr = attr;
+}
+
+// Picks the shortest of an absolute move and the relative moves available
+// from the last known cursor position.
+static void ansi_move(Screen* s, int x, int y) {
+    if (s->out_x == x && s->out_y == y) return;
+
+    char best[32];
+    snprintf(best, sizeof(best), "\x1b[%d;%dH", y + 1, x + 1);
+
+    if (s->out_x >= 0 && s->out_y >= 0) {
+        char cand[32];
+        char vert[16] = "";
+        int dy = y - s->out_y;
+        if (dy > 0) snprintf(vert, sizeof(vert), dy == 1 ? "\n" : "\x1b[%dB", dy);
+        else if (dy < 0) snprintf(vert, sizeof(vert), dy == -1 ? "\x1b[A" : "\x1b[%dA", -dy);
+
+        int dx = x - s->out_x;
+        if (dx == 0) snprintf(cand, sizeof(cand), "%s", vert);
+        else if (dx > 0) snprintf(cand, sizeof(cand), dx == 1 ? "%s\x1b[C" : "%s\x1b[%dC", vert, dx);
+        else snprintf(cand, sizeof(cand), dx == -1 ? "%s\x1b[D" : "%s\x1b[%dD", vert, -dx);
+        if (strlen(cand) < strlen(best)) strcpy(best, cand);
+
+        if (x == 0) {
+            snprintf(cand, sizeof(cand), "\r%s", vert);
+            if (strlen(cand) < strlen(best)) strcpy(best, cand);
+        }
+    }
+
+    out_str(s, best);
+    s->out_x = x;
+    s->out_y = y;
+}
+
+// Control characters and code points that can't be encoded show as '?'.
+static int utf8_encode(unsigned int ch, char* out) {
+    if (ch < 32 || ch == 127 || ch > 0x10FFFF || (ch >= 0xD800 && ch <= 0xDFFF)) {
+        out[0] = '?';
+        return 1;
+    }
+    if (ch < 0x80) {
+        out[0] = (char)ch;
+        return 1;
+    }
+    if (ch < 0x800) {
+        out[0] = (char)(0xC0 | (ch >> 6));
+        out[1] = (char)(0x80 | (ch & 0x3F));
+        return 2;
+    }
+    if (ch < 0x10000) {
+        out[0] = (char)(0xE0 | (ch >> 12));
+        out[1] = (char)(0x80 | ((ch >> 6) & 0x3F));
+        out[2] = (char)(0x80 | (ch & 0x3F));
+        return 3;
+    }
+    out[0] = (char)(0xF0 | (ch >> 18));
+    out[1] = (char)(0x80 | ((ch >> 12) & 0x3F));
+    out[2] = (char)(0x80 | ((ch >> 6) & 0x3F));
+    out[3] = (char)(0x80 | (ch & 0x3F));
+    return 4;
+}
+
+static void ansi_span(Screen* s, int x, int y, int length) {
+    ansi_move(s, x, y);
+    const Cell* row = s->back + y * s->width;
+    for (int i = x; i < x + length; i++) {
+        // The terminal moved past it with the character before.
+        if (row[i].ch == CELL_CONTINUATION) continue;
+        ansi_attr(s, row[i].attr);
+        char c[4];
+        out_bytes(s, c, utf8_encode(row[i].ch, c));
+    }
+    s->out_x = x + length;
+    // Terminals defer the wrap after the last column, so the position is unknown.
+    if (s->out_x >= s->width) s->out_x = -1;
+    s->cells_emitted += length;
+}
+
+#ifdef _WIN32
+
+static void console_span(Screen* s, int x, int y, int length) {
+    CHAR_INFO cells[512];
+    const Cell* row = s->back + y * s->width;
+    while (length > 0) {
+        int n = length < 512 ? length : 512;
+        for (int i = 0; i < n; i++) {
+            unsigned int ch = row[x + i].ch;
+            cells[i].Attributes = row[x + i].attr;
+            if (ch == CELL_CONTINUATION && x + i > 0) {
+                // The console wants a wide character in both of its cells.
+                unsigned int lead = row[x + i - 1].ch;
+                cells[i].Char.UnicodeChar = (WCHAR)(lead <= 0xFFFF ? lead : ' ');
+                cells[i].Attributes |= COMMON_LVB_TRAILING_BYTE;
+                if (i > 0 && lead <= 0xFFFF) cells[i - 1].Attributes |= COMMON_LVB_LEADING_BYTE;
+            } else {
+                cells[i].Char.UnicodeChar = (WCHAR)(ch <= 0xFFFF ? ch : '?');
+            }
+        }
+        COORD size = {(SHORT)n, 1};
+        COORD origin = {0, 0};
+        SMALL_RECT region = {(SHORT)x, (SHORT)y, (SHORT)(x + n - 1), (SHORT)y};
+        WriteConsoleOutputW((HANDLE)s->console, cells, size, origin, &region);
+        s->cells_emitted += n;
+        s->bytes_emitted += n * sizeof(CHAR_INFO);
+        x += n;
+        length -= n;
+    }
+}
+
+static int console_init(Screen* s, const char* title) {
+    HANDLE hConsole = GetStdHandle(STD_OUTPUT_HANDLE);
+    SetConsoleTitle(title);
+
+    HANDLE hBuffer = CreateConsoleScreenBuffer(
+        GENERIC_READ | GENERIC_WRITE,
+        FILE_SHARE_READ | FILE_SHARE_WRITE,
+        NULL,
+        CONSOLE_TEXTMODE_BUFFER,
+        NULL);
+
+    COORD size = {(SHORT)s->width, (SHORT)s->height};
+    if (hBuffer != INVALID_HANDLE_VALUE) {
+        SetConsoleActiveScreenBuffer(hBuffer);
+        SetConsoleScreenBufferSize(hBuffer, size);
+    } else {
+        hBuffer = hConsole;
+    }
+
+    CONSOLE_CURSOR_INFO cursorInfo;
+    GetConsoleCursorInfo(hBuffer, &cursorInfo);
+    cursorInfo.bVisible = TRUE;
+    cursorInfo.dwSize = 100;
+    SetConsoleCursorInfo(hBuffer, &cursorInfo);
+
+    s->console = hBuffer;
+    s->saved_console = hConsole;
+    return 0;
+}
+
+static void console_shutdown(Screen* s) {
+    if (s->console && s->console != s->saved_console) {
+        SetConsoleActiveScreenBuffer((HANDLE)s->saved_console);
+        CloseHandle((HANDLE)s->console);
+    }
+    s->console = NULL;
+}
+
+#endif
+
+int screen_init(Screen* s, int backend, int width, int height, const char* title) {
+    memset(s, 0, sizeof(*s));
+    s->backend = backend;
+
+#ifndef _WIN32
+    if (backend == SCREEN_CONSOLE) s->backend = backend = SCREEN_ANSI;
+    if (backend == SCREEN_ANSI) {
+        struct winsize ws;
+        if (ioctl(STDOUT_FILENO, TIOCGWINSZ, &ws) == 0 && ws.ws_col > 0 && ws.ws_row > 0) {
+            width = ws.ws_col;
+            height = ws.ws_row;
+        }
+    }
+#else
+    if (backend == SCREEN_ANSI) s->backend = backend = SCREEN_CONSOLE;
+#endif
+
+    s->width = width;
+    s->height = height;
+    s->front = (Cell*)malloc((size_t)width * height * sizeof(Cell));
+    s->back = (Cell*)malloc((size_t)width * height * sizeof(Cell));
+    if (!s->front || !s->back) {
+        free(s->front);
+        free(s->back);
+        return -1;
+    }
+    screen_clear(s);
+    memcpy(s->front, s->back, (size_t)width * height * sizeof(Cell));
+    s->full_redraw = 1;
+    s->out_x = s->out_y = s->out_attr = -1;
+
+#ifdef _WIN32
+    if (backend == SCREEN_CONSOLE) console_init(s, title);
+#else
+    if (backend == SCREEN_ANSI) {
+        char seq[256];
+        snprintf(seq, sizeof(seq), "\x1b]0;%s\x07", title ? title : "");
+        out_str(s, seq);
+    }
+#endif
+    screen_resume(s);
+    return 0;
+}
+
+void screen_shutdown(Screen* s) {
+    screen_suspend(s);
+#ifdef _WIN32
+    if (s->backend == SCREEN_CONSOLE) console_shutdown(s);
+#endif
+    free(s->front);
+    free(s->back);
+    free(s->out);
+    memset(s, 0, sizeof(*s));
+}
+
+void screen_suspend(Screen* s) {
+    if (s->backend == SCREEN_CONSOLE) return;
+    out_str(s, "\x1b[0m\x1b[?25h\x1b[?1049l");
+    out_flush(s);
+}
+
+void screen_resume(Screen* s) {
+    if (s->backend != SCREEN_CONSOLE) {
+        out_str(s, "\x1b[?1049h\x1b[0m\x1b[2J");
+        out_flush(s);
+        s->out_x = s->out_y = s->out_attr = -1;
+    }
+    screen_invalidate(s);
+}
+
+void screen_clear(Screen* s) {
+    int total = s->width * s->height;
+    for (int i = 0; i < total; i++) {
+        s->back[i].ch = ' ';
+        s->back[i].attr = ATTR_DEFAULT;
+    }
+}
+
+void screen_put(Screen* s, int x, int y, unsigned int ch, unsigned short attr) {
+    if (x >= 0 && x < s->width && y >= 0 && y < s->height) {
+        Cell* c = &s->back[y * s->width + x];
+        c->ch = ch;
+        c->attr = attr;
+    }
+}
+
+void screen_text(Screen* s, int x, int y, const char* text, unsigned short attr) {
+    for (int i = 0; text[i] && x + i < s->width; i++) {
+        screen_put(s, x + i, y, (unsigned char)text[i], attr);
+    }
+}
+
+void screen_set_cursor(Screen* s, int x, int y) {
+    s->cursor_x = x;
+    s->cursor_y = y;
+}
+
+void screen_invalidate(Screen* s) {
+    s->full_redraw = 1;
+}
+
+static int cell_equal(const Cell* a, const Cell* b) {
+    return a->ch == b->ch && a->attr == b->attr;
+}
+
+static void emit_span(Screen* s, int x, int y, int length) {
+#ifdef _WIN32
+    if (s->backend == SCREEN_CONSOLE) {
+        console_span(s, x, y, length);
+        return;
+    }
+#endif
+    ansi_span(s, x, y, length);
+}
+
+void screen_present(Screen* s) {
+    if (s->backend != SCREEN_CONSOLE) out_str(s, "\x1b[?25l");
+
+    for (int y = 0; y < s->height; y++) {
+        Cell* front = s->front + y * s->width;
+        const Cell* back = s->back + y * s->width;
+
+        int x = 0;
+        while (x < s->width) {
+            if (!s->full_redraw && cell_equal(&front[x], &back[x])) {
+                x++;
+                continue;
+            }
+
+            int start = x;
+            int end = x + 1;
+            int gap = 0;
+            for (x = end; x < s->width && gap <= MERGE_GAP; x++) {
+                if (s->full_redraw || !cell_equal(&front[x], &back[x])) {
+                    end = x + 1;
+                    gap = 0;
+                } else {
+                    gap++;
+                }
+            }
+            x = end;
+            // Spans hold whole double-width characters.
+            if (start > 0 && back[start].ch == CELL_CONTINUATION) start--;
+            if (end < s->width && back[end].ch == CELL_CONTINUATION) x = ++end;
+
+            emit_span(s, start, y, end - start);
+            memcpy(front + start, back + start, (end - start) * sizeof(Cell));
+        }
+    }
+    s->full_redraw = 0;
+
+#ifdef _WIN32
+    if (s->backend == SCREEN_CONSOLE) {
+        COORD pos = {(SHORT)s->cursor_x, (SHORT)s->cursor_y};
+        SetConsoleCursorPosition((HANDLE)s->console, pos);
+        return;
+    }
+#endif
+    ansi_move(s, s->cursor_x, s->cursor_y);
+    out_str(s, "\x1b[?25h");
+    out_flush(s);
+}
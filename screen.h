@@ -0,0 +1,73 @@
+#ifndef SCREEN_H
+#define SCREEN_H
+
+#include <stddef.h>
+
+// Double-buffered cell grid. Drawing goes to the back grid; screen_present()
+// compares it with the front grid and sends only the changed spans of each
+// row to the backend.
+
+// Same bit layout as the Win32 console attributes.
+#define ATTR_FG_BLUE 0x0001
+#define ATTR_FG_GREEN 0x0002
+#define ATTR_FG_RED 0x0004
+#define ATTR_FG_INTENSITY 0x0008
+#define ATTR_BG_BLUE 0x0010
+#define ATTR_BG_GREEN 0x0020
+#define ATTR_BG_RED 0x0040
+#define ATTR_BG_INTENSITY 0x0080
+#define ATTR_DEFAULT (ATTR_FG_RED | ATTR_FG_GREEN | ATTR_FG_BLUE)
+
+enum {
+    SCREEN_CONSOLE,
+    SCREEN_ANSI,
+    SCREEN_HEADLESS
+};
+
+// A cell holds a code point. A double-width character fills its own cell
+// and the next, which holds CELL_CONTINUATION.
+#define CELL_CONTINUATION 0
+
+typedef struct {
+    unsigned int ch;
+    unsigned short attr;
+} Cell;
+
+typedef struct {
+    int backend;
+    int width;
+    int height;
+    Cell* front;
+    Cell* back;
+    int cursor_x;
+    int cursor_y;
+    int full_redraw;
+
+    char* out;
+    size_t out_length;
+    size_t out_capacity;
+    int out_x;
+    int out_y;
+    int out_attr;
+    unsigned long long bytes_emitted;
+    unsigned long long cells_emitted;
+
+    void* console;
+    void* saved_console;
+} Screen;
+
+int screen_init(Screen* s, int backend, int width, int height, const char* title);
+void screen_shutdown(Screen* s);
+
+// Hands the terminal back to other programs, e.g. while a child runs in it.
+void screen_suspend(Screen* s);
+void screen_resume(Screen* s);
+
+void screen_clear(Screen* s);
+void screen_put(Screen* s, int x, int y, unsigned int ch, unsigned short attr);
+void screen_text(Screen* s, int x, int y, const char* text, unsigned short attr);
+void screen_set_cursor(Screen* s, int x, int y);
+void screen_present(Screen* s);
+void screen_invalidate(Screen* s);
+
+#endif
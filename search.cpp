@@ -0,0 +1,1187 @@
+#include "search.h"
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define SEARCH_SSE2 1
+#endif
+
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+#include <immintrin.h>
+#define SEARCH_AVX2 1
+#ifdef _MSC_VER
+#include <intrin.h>
+#define SEARCH_TARGET_AVX2
+#else
+#define SEARCH_TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+#endif
+
+// Past this many states a DFA throws its states away and starts over.
+#define DFA_MAX_STATES 4096
+#define DFA_TABLE_SIZE (2 * DFA_MAX_STATES)
+
+#define DFA_ACCEPT 1
+#define DFA_DEAD 2
+
+static int active_kernel = -1;
+
+static int lowest_bit(unsigned int mask) {
+#ifdef _MSC_VER
+    unsigned long index;
+    _BitScanForward(&index, mask);
+    return (int)index;
+#else
+    return __builtin_ctz(mask);
+#endif
+}
+
+// Each kernel returns the first position at or after from where needle
+// fits inside text, or length when there is none.
+static size_t find_scalar(const char* text, size_t length, size_t from,
+                          const char* needle, size_t n) {
+    if (length < n) return length;
+    size_t last = length - n;
+    while (from <= last) {
+        const char* hit = (const char*)memchr(text + from, needle[0], last - from + 1);
+        if (!hit) break;
+        size_t i = (size_t)(hit - text);
+        if (memcmp(hit + 1, needle + 1, n - 1) == 0) return i;
+        from = i + 1;
+    }
+    return length;
+}
+
+#ifdef SEARCH_SSE2
+static size_t find_sse2(const char* text, size_t length, size_t from,
+                        const char* needle, size_t n) {
+    const __m128i first = _mm_set1_epi8(needle[0]);
+    const __m128i last = _mm_set1_epi8(needle[n - 1]);
+    size_t i = from;
+    for (; i + n - 1 + 16 <= length; i += 16) {
+        __m128i a = _mm_loadu_si128((const __m128i*)(text + i));
+        __m128i b = _mm_loadu_si128((const __m128i*)(text + i + n - 1));
+        unsigned int bits = (unsigned int)_mm_movemask_epi8(
+            _mm_and_si128(_mm_cmpeq_epi8(a, first), _mm_cmpeq_epi8(b, last)));
+        while (bits) {
+            size_t p = i + lowest_bit(bits);
+            if (n <= 2 || memcmp(text + p + 1, needle + 1, n - 2) == 0) return p;
+            bits &= bits - 1;
+        }
+    }
+    return find_scalar(text, length, i, needle, n);
+}
+#endif
+
+#ifdef SEARCH_AVX2
+SEARCH_TARGET_AVX2
+static size_t find_avx2(const char* text, size_t length, size_t from,
+                        const char* needle, size_t n) {
+    const __m256i first = _mm256_set1_epi8(needle[0]);
+    const __m256i last = _mm256_set1_epi8(needle[n - 1]);
+    size_t i = from;
+    for (; i + n - 1 + 32 <= length; i += 32) {
+        __m256i a = _mm256_loadu_si256((const __m256i*)(text + i));
+        __m256i b = _mm256_loadu_si256((const __m256i*)(text + i + n - 1));
+        unsigned int bits = (unsigned int)_mm256_movemask_epi8(
+            _mm256_and_si256(_mm256_cmpeq_epi8(a, first), _mm256_cmpeq_epi8(b, last)));
+        while (bits) {
+            size_t p = i + lowest_bit(bits);
+            if (n <= 2 || memcmp(text + p + 1, needle + 1, n - 2) == 0) return p;
+            bits &= bits - 1;
+        }
+    }
+    return find_scalar(text, length, i, needle, n);
+}
+#endif
+
+static int detect_kernel() {
+#ifdef SEARCH_AVX2
+#ifdef _MSC_VER
+    int info[4];
+    __cpuid(info, 0);
+    if (info[0] >= 7) {
+        __cpuid(info, 1);
+        int osxsave = (info[2] >> 27) & 1;
+        int avx = (info[2] >> 28) & 1;
+        if (osxsave && avx && (_xgetbv(0) & 6) == 6) {
+            __cpuidex(info, 7, 0);
+            if (info[1] & (1 << 5)) return SEARCH_KERNEL_AVX2;
+        }
+    }
+#else
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) return SEARCH_KERNEL_AVX2;
+#endif
+#endif
+#ifdef SEARCH_SSE2
+    return SEARCH_KERNEL_SSE2;
+#else
+    return SEARCH_KERNEL_SCALAR;
+#endif
+}
+
+int search_kernel() {
+    if (active_kernel < 0) active_kernel = detect_kernel();
+    return active_kernel;
+}
+
+void search_set_kernel(int kernel) {
+    int supported = detect_kernel();
+    active_kernel = kernel < supported ? kernel : supported;
+}
+
+static size_t find_literal(const char* text, size_t length, size_t from,
+                           const char* needle, size_t n) {
+    switch (search_kernel()) {
+#ifdef SEARCH_AVX2
+        case SEARCH_KERNEL_AVX2: return find_avx2(text, length, from, needle, n);
+#endif
+#ifdef SEARCH_SSE2
+        case SEARCH_KERNEL_SSE2: return find_sse2(text, length, from, needle, n);
+#endif
+    }
+    return find_scalar(text, length, from, needle, n);
+}
+
+// Regular expressions.
+
+enum {
+    NODE_SET,
+    NODE_EMPTY,
+    NODE_BOL,
+    NODE_EOL,
+    NODE_CONCAT,
+    NODE_ALT,
+    NODE_STAR,
+    NODE_PLUS,
+    NODE_QUEST
+};
+
+enum {
+    NFA_SET,
+    NFA_SPLIT,
+    NFA_BOL,
+    NFA_EOL,
+    NFA_MATCH
+};
+
+typedef struct {
+    unsigned int bits[8];
+} ByteSet;
+
+typedef struct {
+    int type;
+    int left;
+    int right;
+} Node;
+
+typedef struct {
+    int type;
+    int out;
+    int out1;
+} NfaState;
+
+typedef struct {
+    NfaState* states;
+    int count;
+    int start;
+} Nfa;
+
+// States are sets of NFA states, stored sorted in items. Each state has a
+// row of transitions, one per byte class plus ^ and $, filled in as they
+// are first taken, followed by its flags. A state is known by the offset
+// of its row, so taking a transition is a single load.
+typedef struct {
+    const Regex* re;
+    const Nfa* nfa;
+    int unanchored;
+    int symbols;
+    int stride;
+    int* trans;
+    int* set_offset;
+    int* set_length;
+    int count;
+    int capacity;
+    int* items;
+    size_t item_count;
+    size_t item_capacity;
+    int* table;
+    int start;
+    int* list;
+    int* stack;
+    unsigned int* seen;
+    unsigned int generation;
+} Dfa;
+
+struct Regex {
+    ByteSet* sets;
+    int set_count;
+    Node* nodes;
+    int node_count;
+    int root;
+    unsigned char classes[256];
+    unsigned char class_byte[256];
+    int class_count;
+    Nfa forward;
+    Nfa reverse;
+    Dfa scan;
+    Dfa starts;
+    Dfa extend;
+    char literal[SEARCH_MAX_PATTERN];
+    size_t literal_length;
+    int plain;
+    char* marks;
+    size_t marks_capacity;
+    char* line;
+    size_t line_capacity;
+};
+
+static int set_has(const ByteSet* set, unsigned char b) {
+    return (set->bits[b >> 5] >> (b & 31)) & 1;
+}
+
+static void set_add(ByteSet* set, unsigned char b) {
+    set->bits[b >> 5] |= 1u << (b & 31);
+}
+
+static void set_add_class(ByteSet* set, char kind) {
+    for (int b = 0; b < 256; b++) {
+        int in;
+        switch (kind) {
+            case 'd': in = b >= '0' && b <= '9'; break;
+            case 'w': in = (b >= 'a' && b <= 'z') || (b >= 'A' && b <= 'Z') ||
+                           (b >= '0' && b <= '9') || b == '_'; break;
+            default: in = b == ' ' || b == '\t' || b == '\r' || b == '\f' || b == '\v'; break;
+        }
+        if (in) set_add(set, (unsigned char)b);
+    }
+}
+
+static int is_class_escape(char c) {
+    return c == 'd' || c == 'w' || c == 's' || c == 'D' || c == 'W' || c == 'S';
+}
+
+typedef struct {
+    const char* p;
+    const char* end;
+    Regex* re;
+    const char* error;
+} Parser;
+
+static int add_node(Regex* re, int type, int left, int right) {
+    Node* n = &re->nodes[re->node_count];
+    n->type = type;
+    n->left = left;
+    n->right = right;
+    return re->node_count++;
+}
+
+static ByteSet* add_set(Regex* re, int* node) {
+    ByteSet* set = &re->sets[re->set_count];
+    memset(set, 0, sizeof(*set));
+    *node = add_node(re, NODE_SET, re->set_count++, -1);
+    return set;
+}
+
+// Adds the byte or class an escape stands for; set is inverted afterwards
+// for the uppercase classes.
+static int parse_escape(Parser* ps, ByteSet* set, int* inverted) {
+    *inverted = 0;
+    if (ps->p == ps->end) {
+        ps->error = "trailing backslash";
+        return -1;
+    }
+    char c = *ps->p++;
+    if (c == 'n') {
+        ps->error = "matches cannot span lines";
+        return -1;
+    }
+    if (is_class_escape(c)) {
+        set_add_class(set, (char)(c | 0x20));
+        *inverted = c >= 'A' && c <= 'Z';
+    } else {
+        set_add(set, (unsigned char)(c == 't' ? '\t' : c));
+    }
+    return 0;
+}
+
+static void invert(ByteSet* set) {
+    for (int i = 0; i < 8; i++) set->bits[i] = ~set->bits[i];
+}
+
+static int parse_class(Parser* ps) {
+    int node;
+    ByteSet* set = add_set(ps->re, &node);
+    int negated = 0;
+    if (ps->p < ps->end && *ps->p == '^') {
+        negated = 1;
+        ps->p++;
+    }
+    int first = 1;
+    while (ps->p < ps->end && (*ps->p != ']' || first)) {
+        first = 0;
+        unsigned char lo = (unsigned char)*ps->p++;
+        if (lo == '\\') {
+            ByteSet one;
+            memset(&one, 0, sizeof(one));
+            int inverted;
+            if (parse_escape(ps, &one, &inverted) != 0) return -1;
+            if (inverted) invert(&one);
+            if (is_class_escape(ps->p[-1])) {
+                for (int i = 0; i < 8; i++) set->bits[i] |= one.bits[i];
+                continue;
+            }
+            lo = (unsigned char)(ps->p[-1] == 't' ? '\t' : ps->p[-1]);
+        }
+        unsigned char hi = lo;
+        if (ps->end - ps->p >= 2 && ps->p[0] == '-' && ps->p[1] != ']') {
+            ps->p++;
+            hi = (unsigned char)*ps->p++;
+            if (hi == '\\') {
+                if (ps->p == ps->end) break;
+                hi = (unsigned char)*ps->p++;
+                if (hi == 't') hi = '\t';
+            }
+            if (hi < lo) {
+                ps->error = "bad range";
+                return -1;
+            }
+        }
+        for (int b = lo; b <= hi; b++) set_add(set, (unsigned char)b);
+    }
+    if (ps->p == ps->end) {
+        ps->error = "missing ]";
+        return -1;
+    }
+    ps->p++;
+    if (negated) invert(set);
+    return node;
+}
+
+static int parse_alt(Parser* ps);
+
+static int parse_atom(Parser* ps) {
+    char c = *ps->p++;
+    int node;
+    switch (c) {
+        case '(':
+            node = parse_alt(ps);
+            if (node < 0) return -1;
+            if (ps->p == ps->end || *ps->p != ')') {
+                ps->error = "missing )";
+                return -1;
+            }
+            ps->p++;
+            return node;
+        case '*':
+        case '+':
+        case '?':
+            ps->error = "nothing to repeat";
+            return -1;
+        case '^':
+            return add_node(ps->re, NODE_BOL, -1, -1);
+        case '$':
+            return add_node(ps->re, NODE_EOL, -1, -1);
+        case '.':
+            invert(add_set(ps->re, &node));
+            return node;
+        case '[':
+            return parse_class(ps);
+        case '\\': {
+            ByteSet* set = add_set(ps->re, &node);
+            int inverted;
+            if (parse_escape(ps, set, &inverted) != 0) return -1;
+            if (inverted) invert(set);
+            return node;
+        }
+        default:
+            set_add(add_set(ps->re, &node), (unsigned char)c);
+            return node;
+    }
+}
+
+static int parse_repeat(Parser* ps) {
+    int node = parse_atom(ps);
+    while (node >= 0 && ps->p < ps->end &&
+           (*ps->p == '*' || *ps->p == '+' || *ps->p == '?')) {
+        char c = *ps->p++;
+        int type = c == '*' ? NODE_STAR : c == '+' ? NODE_PLUS : NODE_QUEST;
+        node = add_node(ps->re, type, node, -1);
+    }
+    return node;
+}
+
+static int parse_concat(Parser* ps) {
+    int node = -1;
+    while (ps->p < ps->end && *ps->p != '|' && *ps->p != ')') {
+        int atom = parse_repeat(ps);
+        if (atom < 0) return -1;
+        node = node < 0 ? atom : add_node(ps->re, NODE_CONCAT, node, atom);
+    }
+    return node < 0 ? add_node(ps->re, NODE_EMPTY, -1, -1) : node;
+}
+
+static int parse_alt(Parser* ps) {
+    int node = parse_concat(ps);
+    while (node >= 0 && ps->p < ps->end && *ps->p == '|') {
+        ps->p++;
+        int right = parse_concat(ps);
+        if (right < 0) return -1;
+        node = add_node(ps->re, NODE_ALT, node, right);
+    }
+    return node;
+}
+
+// ^ and $ take no text, so they count as empty here.
+static int nullable(const Regex* re, int node) {
+    const Node* n = &re->nodes[node];
+    switch (n->type) {
+        case NODE_SET: return 0;
+        case NODE_CONCAT: return nullable(re, n->left) && nullable(re, n->right);
+        case NODE_ALT: return nullable(re, n->left) || nullable(re, n->right);
+        case NODE_PLUS: return nullable(re, n->left);
+        default: return 1;
+    }
+}
+
+static int single_byte(const ByteSet* set) {
+    int found = -1;
+    for (int b = 0; b < 256; b++) {
+        if (!set_has(set, (unsigned char)b)) continue;
+        if (found >= 0) return -1;
+        found = b;
+    }
+    return found;
+}
+
+static void flatten(const Regex* re, int node, int* out, int* n) {
+    const Node* nd = &re->nodes[node];
+    if (nd->type == NODE_CONCAT) {
+        flatten(re, nd->left, out, n);
+        flatten(re, nd->right, out, n);
+        return;
+    }
+    out[(*n)++] = nd->type == NODE_SET ? single_byte(&re->sets[nd->left]) : -1;
+}
+
+// Finds the longest run of plain characters that every match contains,
+// such as " items" in "\\d+ items". Only the top-level sequence is looked
+// at, so an alternation at the top has none.
+static int required_literal(Regex* re) {
+    int* seq = (int*)malloc(re->node_count * sizeof(int));
+    if (!seq) return -1;
+    int n = 0;
+    flatten(re, re->root, seq, &n);
+    int best = 0;
+    int best_start = 0;
+    int run = 0;
+    for (int i = 0; i <= n; i++) {
+        if (i < n && seq[i] >= 0) {
+            run++;
+            continue;
+        }
+        if (run > best) {
+            best = run;
+            best_start = i - run;
+        }
+        run = 0;
+    }
+    for (int i = 0; i < best; i++) re->literal[i] = (char)seq[best_start + i];
+    re->literal_length = (size_t)best;
+    re->plain = best == n;
+    free(seq);
+    return 0;
+}
+
+static int nfa_add(Nfa* nfa, int type, int out, int out1) {
+    NfaState* s = &nfa->states[nfa->count];
+    s->type = type;
+    s->out = out;
+    s->out1 = out1;
+    return nfa->count++;
+}
+
+// Thompson construction, back to front: returns the state that matches
+// node and continues at next. A NFA_SET state's out1 is its byte set.
+static int compile(const Regex* re, Nfa* nfa, int node, int next, int reversed) {
+    const Node* n = &re->nodes[node];
+    int s;
+    int body;
+    switch (n->type) {
+        case NODE_SET:
+            return nfa_add(nfa, NFA_SET, next, n->left);
+        case NODE_EMPTY:
+            return next;
+        case NODE_BOL:
+            return nfa_add(nfa, NFA_BOL, next, -1);
+        case NODE_EOL:
+            return nfa_add(nfa, NFA_EOL, next, -1);
+        case NODE_CONCAT:
+            if (reversed) return compile(re, nfa, n->right, compile(re, nfa, n->left, next, 1), 1);
+            return compile(re, nfa, n->left, compile(re, nfa, n->right, next, 0), 0);
+        case NODE_ALT:
+            return nfa_add(nfa, NFA_SPLIT, compile(re, nfa, n->left, next, reversed),
+                           compile(re, nfa, n->right, next, reversed));
+        case NODE_QUEST:
+            return nfa_add(nfa, NFA_SPLIT, compile(re, nfa, n->left, next, reversed), next);
+        default:
+            s = nfa_add(nfa, NFA_SPLIT, -1, next);
+            body = compile(re, nfa, n->left, s, reversed);
+            nfa->states[s].out = body;
+            return n->type == NODE_STAR ? s : body;
+    }
+}
+
+static int build_nfa(const Regex* re, Nfa* nfa, int reversed) {
+    nfa->states = (NfaState*)malloc((re->node_count + 1) * sizeof(NfaState));
+    if (!nfa->states) return -1;
+    nfa->count = 0;
+    int match = nfa_add(nfa, NFA_MATCH, -1, -1);
+    nfa->start = compile(re, nfa, re->root, match, reversed);
+    return 0;
+}
+
+// Splits the bytes into classes that every byte set treats alike.
+static void build_classes(Regex* re) {
+    memset(re->classes, 0, sizeof(re->classes));
+    re->class_count = 1;
+    for (int s = 0; s < re->set_count; s++) {
+        int split[256][2];
+        for (int c = 0; c < re->class_count; c++) split[c][0] = split[c][1] = -1;
+        int count = 0;
+        for (int b = 0; b < 256; b++) {
+            int* slot = &split[re->classes[b]][set_has(&re->sets[s], (unsigned char)b)];
+            if (*slot < 0) *slot = count++;
+            re->classes[b] = (unsigned char)*slot;
+        }
+        re->class_count = count;
+    }
+    for (int b = 255; b >= 0; b--) re->class_byte[re->classes[b]] = (unsigned char)b;
+}
+
+static unsigned int hash_items(const int* items, int n) {
+    unsigned int h = 2166136261u;
+    for (int i = 0; i < n; i++) {
+        h ^= (unsigned int)items[i];
+        h *= 16777619u;
+    }
+    return h;
+}
+
+static void closure(Dfa* d, int state, int* n) {
+    const NfaState* states = d->nfa->states;
+    int top = 0;
+    d->stack[top++] = state;
+    while (top > 0) {
+        int s = d->stack[--top];
+        if (s < 0 || d->seen[s] == d->generation) continue;
+        d->seen[s] = d->generation;
+        if (states[s].type == NFA_SPLIT) {
+            d->stack[top++] = states[s].out1;
+            d->stack[top++] = states[s].out;
+        } else {
+            d->list[(*n)++] = s;
+        }
+    }
+}
+
+static int compare_int(const void* a, const void* b) {
+    return *(const int*)a - *(const int*)b;
+}
+
+static void dfa_clear(Dfa* d) {
+    d->count = 0;
+    d->item_count = 0;
+    for (int i = 0; i < DFA_TABLE_SIZE; i++) d->table[i] = -1;
+}
+
+// Returns the state for the sorted set d->list[0, n), or -1 when the DFA
+// is full or out of memory.
+static int intern(Dfa* d, int n) {
+    unsigned int h = hash_items(d->list, n);
+    int slot = (int)(h & (DFA_TABLE_SIZE - 1));
+    while (d->table[slot] >= 0) {
+        int id = d->table[slot];
+        if (d->set_length[id] == n &&
+            memcmp(d->items + d->set_offset[id], d->list, n * sizeof(int)) == 0) {
+            return id * d->stride;
+        }
+        slot = (slot + 1) & (DFA_TABLE_SIZE - 1);
+    }
+    if (d->count == DFA_MAX_STATES) return -1;
+
+    if (d->count == d->capacity) {
+        int cap = d->capacity ? d->capacity * 2 : 64;
+        int* trans = (int*)realloc(d->trans, (size_t)cap * d->stride * sizeof(int));
+        if (trans) d->trans = trans;
+        int* offsets = (int*)realloc(d->set_offset, cap * sizeof(int));
+        if (offsets) d->set_offset = offsets;
+        int* lengths = (int*)realloc(d->set_length, cap * sizeof(int));
+        if (lengths) d->set_length = lengths;
+        if (!trans || !offsets || !lengths) return -1;
+        d->capacity = cap;
+    }
+    if (d->item_count + n > d->item_capacity) {
+        size_t cap = d->item_capacity ? d->item_capacity * 2 : 1024;
+        while (cap < d->item_count + n) cap *= 2;
+        int* items = (int*)realloc(d->items, cap * sizeof(int));
+        if (!items) return -1;
+        d->items = items;
+        d->item_capacity = cap;
+    }
+
+    int id = d->count++;
+    memcpy(d->items + d->item_count, d->list, n * sizeof(int));
+    d->set_offset[id] = (int)d->item_count;
+    d->set_length[id] = n;
+    d->item_count += n;
+    int* row = d->trans + id * d->stride;
+    for (int i = 0; i < d->symbols; i++) row[i] = -1;
+    row[d->symbols] = n == 0 ? DFA_DEAD : 0;
+    for (int i = 0; i < n; i++) {
+        if (d->nfa->states[d->list[i]].type == NFA_MATCH) row[d->symbols] |= DFA_ACCEPT;
+    }
+    d->table[slot] = id;
+    return id * d->stride;
+}
+
+static int start_set(Dfa* d) {
+    int n = 0;
+    d->generation++;
+    closure(d, d->nfa->start, &n);
+    qsort(d->list, n, sizeof(int), compare_int);
+    return n;
+}
+
+static int dfa_init(Dfa* d, const Regex* re, const Nfa* nfa, int unanchored) {
+    memset(d, 0, sizeof(*d));
+    d->re = re;
+    d->nfa = nfa;
+    d->unanchored = unanchored;
+    d->symbols = re->class_count + 2;
+    d->stride = d->symbols + 1;
+    d->table = (int*)malloc(DFA_TABLE_SIZE * sizeof(int));
+    d->list = (int*)malloc((nfa->count + 1) * sizeof(int));
+    d->stack = (int*)malloc((2 * nfa->count + 2) * sizeof(int));
+    d->seen = (unsigned int*)calloc(nfa->count + 1, sizeof(unsigned int));
+    if (!d->table || !d->list || !d->stack || !d->seen) return -1;
+    dfa_clear(d);
+    d->start = intern(d, start_set(d));
+    return d->start < 0 ? -1 : 0;
+}
+
+static void dfa_free(Dfa* d) {
+    free(d->trans);
+    free(d->set_offset);
+    free(d->set_length);
+    free(d->items);
+    free(d->table);
+    free(d->list);
+    free(d->stack);
+    free(d->seen);
+    memset(d, 0, sizeof(*d));
+}
+
+// Symbols past the byte classes are ^ and $. They take no text, so taking
+// one keeps every state that was already there.
+static int compute(Dfa* d, int state, int symbol) {
+    const NfaState* states = d->nfa->states;
+    int classes = d->re->class_count;
+    int id = state / d->stride;
+    const int* items = d->items + d->set_offset[id];
+    int length = d->set_length[id];
+    int n = 0;
+    d->generation++;
+
+    if (symbol < classes) {
+        unsigned char b = d->re->class_byte[symbol];
+        for (int i = 0; i < length; i++) {
+            const NfaState* s = &states[items[i]];
+            if (s->type == NFA_SET && set_has(&d->re->sets[s->out1], b)) closure(d, s->out, &n);
+        }
+        if (d->unanchored) closure(d, d->nfa->start, &n);
+    } else {
+        int type = symbol == classes ? NFA_BOL : NFA_EOL;
+        for (int i = 0; i < length; i++) {
+            d->seen[items[i]] = d->generation;
+            d->list[n++] = items[i];
+        }
+        for (int i = 0; i < n; i++) {
+            if (states[d->list[i]].type == type) closure(d, states[d->list[i]].out, &n);
+        }
+    }
+    qsort(d->list, n, sizeof(int), compare_int);
+
+    int next = intern(d, n);
+    if (next >= 0) {
+        d->trans[state + symbol] = next;
+        return next;
+    }
+
+    // Full: keep only the start state and the one being entered. The
+    // caller's other state numbers are no longer valid.
+    int* saved = (int*)malloc((n + 1) * sizeof(int));
+    if (saved) memcpy(saved, d->list, n * sizeof(int));
+    dfa_clear(d);
+    d->start = intern(d, start_set(d));
+    if (!saved) return d->start;
+    memcpy(d->list, saved, n * sizeof(int));
+    free(saved);
+    next = intern(d, n);
+    return next >= 0 ? next : d->start;
+}
+
+static int flags_of(const Dfa* d, int state) {
+    return d->trans[state + d->symbols];
+}
+
+static inline int step(Dfa* d, int state, int symbol) {
+    int next = d->trans[state + symbol];
+    return next >= 0 ? next : compute(d, state, symbol);
+}
+
+static void regex_free(Regex* re) {
+    if (!re) return;
+    dfa_free(&re->scan);
+    dfa_free(&re->starts);
+    dfa_free(&re->extend);
+    free(re->forward.states);
+    free(re->reverse.states);
+    free(re->sets);
+    free(re->nodes);
+    free(re->marks);
+    free(re->line);
+    free(re);
+}
+
+static Regex* regex_compile(const char* pattern, size_t length, const char** error) {
+    Regex* re = (Regex*)calloc(1, sizeof(Regex));
+    if (!re) {
+        *error = "out of memory";
+        return NULL;
+    }
+    // Every character adds at most three nodes and one set.
+    re->nodes = (Node*)malloc((3 * length + 4) * sizeof(Node));
+    re->sets = (ByteSet*)malloc((length + 1) * sizeof(ByteSet));
+    if (!re->nodes || !re->sets) {
+        *error = "out of memory";
+        regex_free(re);
+        return NULL;
+    }
+
+    Parser ps = {pattern, pattern + length, re, NULL};
+    re->root = parse_alt(&ps);
+    if (re->root >= 0 && ps.p < ps.end) ps.error = "unmatched )";
+    if (!ps.error && nullable(re, re->root)) ps.error = "matches empty text";
+    if (ps.error) {
+        *error = ps.error;
+        regex_free(re);
+        return NULL;
+    }
+    for (int i = 0; i < re->set_count; i++) {
+        re->sets[i].bits['\n' >> 5] &= ~(1u << ('\n' & 31));
+    }
+    build_classes(re);
+
+    if (required_literal(re) != 0 || build_nfa(re, &re->forward, 0) != 0 || build_nfa(re, &re->reverse, 1) != 0 ||
+        dfa_init(&re->scan, re, &re->forward, 1) != 0 ||
+        dfa_init(&re->starts, re, &re->reverse, 1) != 0 ||
+        dfa_init(&re->extend, re, &re->forward, 0) != 0) {
+        *error = "out of memory";
+        regex_free(re);
+        return NULL;
+    }
+    return re;
+}
+
+// Reports the leftmost-longest matches in one line. A backward pass with
+// the reversed pattern marks every position a match starts at; from each
+// mark not inside an earlier match, a forward pass finds the longest end.
+static int match_line(Regex* re, const char* text, size_t length, size_t base,
+                      SearchMatchFn fn, void* ctx) {
+    if (length > re->marks_capacity) {
+        char* marks = (char*)realloc(re->marks, length);
+        if (!marks) return 0;
+        re->marks = marks;
+        re->marks_capacity = length;
+    }
+    const unsigned char* p = (const unsigned char*)text;
+    int bol = re->class_count;
+    int eol = bol + 1;
+
+    Dfa* d = &re->starts;
+    int r = step(d, d->start, eol);
+    for (size_t i = length; i > 0;) {
+        i--;
+        r = step(d, r, re->classes[p[i]]);
+        int t = i == 0 ? step(d, r, bol) : r;
+        re->marks[i] = (char)(flags_of(d, t) & DFA_ACCEPT);
+    }
+
+    Dfa* e = &re->extend;
+    size_t from = 0;
+    while (from < length) {
+        const char* mark = (const char*)memchr(re->marks + from, DFA_ACCEPT, length - from);
+        if (!mark) break;
+        size_t start = (size_t)(mark - re->marks);
+        size_t end = start;
+        int a = start == 0 ? step(e, e->start, bol) : e->start;
+        size_t i = start;
+        for (; i < length; i++) {
+            a = step(e, a, re->classes[p[i]]);
+            if (flags_of(e, a) & DFA_DEAD) break;
+            if (flags_of(e, a) & DFA_ACCEPT) end = i + 1;
+        }
+        if (i == length && (flags_of(e, step(e, a, eol)) & DFA_ACCEPT)) end = length;
+        if (end == start) {
+            from = start + 1;
+            continue;
+        }
+        if (fn(base + start, base + end, ctx)) return 1;
+        from = end;
+    }
+    return 0;
+}
+
+// Carries a search from one piece of the buffer to the next.
+typedef struct {
+    Search* s;
+    const TextBuffer* tb;
+    SearchMatchFn fn;
+    void* ctx;
+    const char* span;
+    size_t span_length;
+    size_t offset;
+    int stopped;
+
+    // A regex with a required literal looks for the literal first.
+    const char* needle;
+    size_t needle_length;
+    int prefilter;
+    size_t next_allowed;
+    char carry[SEARCH_MAX_PATTERN];
+    size_t carry_length;
+
+    int state;
+    int hit;
+    size_t line_start;
+} Scan;
+
+static const char* read_line(Scan* sc, size_t start, size_t length) {
+    Regex* re = sc->s->regex;
+    if (length > re->line_capacity) {
+        char* grown = (char*)realloc(re->line, length);
+        if (!grown) return NULL;
+        re->line = grown;
+        re->line_capacity = length;
+    }
+    tb_read(sc->tb, start, length, re->line);
+    return re->line;
+}
+
+// Matches the whole line around a required literal found at offset, then
+// skips the rest of that line.
+static int prefilter_hit(Scan* sc, size_t offset) {
+    size_t start = 0;
+    size_t length = 0;
+    const char* line = NULL;
+    if (offset >= sc->offset) {
+        // Usually the line lies inside the current piece.
+        const char* text = sc->span;
+        size_t at = offset - sc->offset;
+        size_t from = at;
+        while (from > 0 && text[from - 1] != '\n') from--;
+        const char* nl = (const char*)memchr(text + at, '\n', sc->span_length - at);
+        if ((from > 0 || sc->offset == 0) && (nl || !sc->tb)) {
+            start = sc->offset + from;
+            length = (nl ? (size_t)(nl - text) : sc->span_length) - from;
+            line = text + from;
+        }
+    }
+    if (!line) {
+        int number = tb_line_of_offset(sc->tb, offset);
+        start = tb_line_start(sc->tb, number);
+        length = tb_line_length(sc->tb, number);
+        line = read_line(sc, start, length);
+        if (!line) return 0;
+    }
+    sc->next_allowed = start + length + 1;
+    if (match_line(sc->s->regex, line, length, start, sc->fn, sc->ctx)) sc->stopped = 1;
+    return sc->stopped;
+}
+
+static int report(Scan* sc, size_t start, size_t end) {
+    if (sc->prefilter) return prefilter_hit(sc, start);
+    if (sc->fn(start, end, sc->ctx)) sc->stopped = 1;
+    return sc->stopped;
+}
+
+static int literal_span(const char* text, size_t length, void* ctx) {
+    Scan* sc = (Scan*)ctx;
+    const char* needle = sc->needle;
+    size_t n = sc->needle_length;
+    size_t base = sc->offset;
+    sc->span = text;
+    sc->span_length = length;
+
+    // Matches that start in the previous pieces and end in this one.
+    if (sc->carry_length > 0) {
+        char joint[2 * SEARCH_MAX_PATTERN];
+        size_t take = length < n - 1 ? length : n - 1;
+        memcpy(joint, sc->carry, sc->carry_length);
+        memcpy(joint + sc->carry_length, text, take);
+        size_t joint_base = base - sc->carry_length;
+        size_t joint_length = sc->carry_length + take;
+        size_t from = sc->next_allowed > joint_base ? sc->next_allowed - joint_base : 0;
+        while (from < sc->carry_length) {
+            size_t p = find_literal(joint, joint_length, from, needle, n);
+            if (p >= sc->carry_length) break;
+            sc->next_allowed = joint_base + p + n;
+            if (report(sc, joint_base + p, joint_base + p + n)) return 1;
+            from = sc->next_allowed - joint_base;
+        }
+    }
+
+    size_t from = sc->next_allowed > base ? sc->next_allowed - base : 0;
+    while (from < length) {
+        size_t p = find_literal(text, length, from, needle, n);
+        if (p == length) break;
+        sc->next_allowed = base + p + n;
+        if (report(sc, base + p, base + p + n)) return 1;
+        from = sc->next_allowed - base;
+    }
+
+    size_t keep = n - 1;
+    if (length >= keep) {
+        memcpy(sc->carry, text + length - keep, keep);
+        sc->carry_length = keep;
+    } else {
+        size_t old = sc->carry_length < keep - length ? sc->carry_length : keep - length;
+        memmove(sc->carry, sc->carry + sc->carry_length - old, old);
+        memcpy(sc->carry + old, text, length);
+        sc->carry_length = old + length;
+    }
+    sc->offset += length;
+    return 0;
+}
+
+// Matches the line that ends at end. text holds the buffer from offset
+// base on; a line that started before it is read from the buffer.
+static int end_line(Scan* sc, const char* text, size_t base, size_t end) {
+    Regex* re = sc->s->regex;
+    size_t length = end - sc->line_start;
+    const char* line;
+    if (sc->line_start >= base) {
+        line = text + (sc->line_start - base);
+    } else {
+        line = read_line(sc, sc->line_start, length);
+        if (!line) return 0;
+    }
+    if (match_line(re, line, length, sc->line_start, sc->fn, sc->ctx)) sc->stopped = 1;
+    return sc->stopped;
+}
+
+static int regex_span(const char* text, size_t length, void* ctx) {
+    Scan* sc = (Scan*)ctx;
+    Regex* re = sc->s->regex;
+    Dfa* d = &re->scan;
+    const unsigned char* p = (const unsigned char*)text;
+    int eol = re->class_count + 1;
+    int state = sc->state;
+    size_t i = 0;
+
+    while (i < length) {
+        if (!sc->hit) {
+            for (; i < length; i++) {
+                unsigned char b = p[i];
+                if (b == '\n') break;
+                int next = d->trans[state + re->classes[b]];
+                state = next >= 0 ? next : compute(d, state, re->classes[b]);
+                if (d->trans[state + d->symbols]) break;
+            }
+            if (i == length) break;
+            if (p[i] != '\n') {
+                sc->hit = 1;
+                i++;
+                continue;
+            }
+            if (flags_of(d, step(d, state, eol)) & DFA_ACCEPT) sc->hit = 1;
+        } else {
+            const char* nl = (const char*)memchr(text + i, '\n', length - i);
+            if (!nl) break;
+            i = (size_t)(nl - text);
+        }
+
+        if (sc->hit && end_line(sc, text, sc->offset, sc->offset + i)) return 1;
+        sc->hit = 0;
+        sc->line_start = sc->offset + i + 1;
+        state = step(d, d->start, re->class_count);
+        i++;
+    }
+    sc->state = state;
+    sc->offset += length;
+    return 0;
+}
+
+static void scan_init(Scan* sc, Search* s, const TextBuffer* tb, SearchMatchFn fn, void* ctx) {
+    memset(sc, 0, sizeof(*sc));
+    sc->s = s;
+    sc->tb = tb;
+    sc->fn = fn;
+    sc->ctx = ctx;
+    sc->needle = s->pattern;
+    sc->needle_length = s->length;
+    Regex* re = s->regex;
+    if (re && re->literal_length > 0) {
+        sc->needle = re->literal;
+        sc->needle_length = re->literal_length;
+        sc->prefilter = 1;
+    } else if (re) {
+        sc->state = step(&re->scan, re->scan.start, re->class_count);
+    }
+}
+
+static int buffer_span(const char* text, size_t length, void* ctx) {
+    Scan* sc = (Scan*)ctx;
+    return sc->s->regex && !sc->prefilter ? regex_span(text, length, ctx)
+                                          : literal_span(text, length, ctx);
+}
+
+// The last line has no newline to end it.
+static void regex_finish(Scan* sc, const char* text, size_t base) {
+    Regex* re = sc->s->regex;
+    Dfa* d = &re->scan;
+    if (sc->stopped || sc->line_start == sc->offset) return;
+    if (sc->hit || (flags_of(d, step(d, sc->state, re->class_count + 1)) & DFA_ACCEPT)) {
+        end_line(sc, text, base, sc->offset);
+    }
+}
+
+int search_compile(Search* s, const char* pattern, size_t length, int mode) {
+    memset(s, 0, sizeof(*s));
+    s->mode = mode;
+    if (length == 0) {
+        s->error = "empty pattern";
+        return -1;
+    }
+    if (length > SEARCH_MAX_PATTERN) {
+        s->error = "pattern too long";
+        return -1;
+    }
+    memcpy(s->pattern, pattern, length);
+    s->pattern[length] = '\0';
+    s->length = length;
+    if (mode == SEARCH_REGEX) {
+        s->regex = regex_compile(pattern, length, &s->error);
+        if (!s->regex) return -1;
+        // Nothing but plain characters: search for them as a literal.
+        if (s->regex->plain) {
+            s->length = s->regex->literal_length;
+            memcpy(s->pattern, s->regex->literal, s->length);
+            s->pattern[s->length] = '\0';
+            regex_free(s->regex);
+            s->regex = NULL;
+        }
+    } else if (memchr(pattern, '\n', length)) {
+        s->error = "matches cannot span lines";
+        return -1;
+    }
+    return 0;
+}
+
+void search_free(Search* s) {
+    regex_free(s->regex);
+    s->regex = NULL;
+}
+
+int search_text(Search* s, const char* text, size_t length, SearchMatchFn fn, void* ctx) {
+    if (s->length == 0 || s->error) return 0;
+    Scan sc;
+    scan_init(&sc, s, NULL, fn, ctx);
+    buffer_span(text, length, &sc);
+    if (s->regex && !sc.prefilter) regex_finish(&sc, text, 0);
+    return sc.stopped;
+}
+
+int search_buffer(Search* s, const TextBuffer* tb, SearchMatchFn fn, void* ctx) {
+    if (s->length == 0 || s->error) return 0;
+    Scan sc;
+    scan_init(&sc, s, tb, fn, ctx);
+    tb_for_each_span(tb, 0, tb_length(tb), buffer_span, &sc);
+    if (s->regex && !sc.prefilter) regex_finish(&sc, NULL, sc.offset);
+    return sc.stopped;
+}
+
+static int collect_match(size_t start, size_t end, void* ctx) {
+    SearchResults* r = (SearchResults*)ctx;
+    if (r->count == SEARCH_MAX_MATCHES) {
+        r->truncated = 1;
+        return 1;
+    }
+    if (r->count == r->capacity) {
+        int cap = r->capacity ? r->capacity * 2 : 256;
+        SearchMatch* grown = (SearchMatch*)realloc(r->matches, cap * sizeof(SearchMatch));
+        if (!grown) {
+            r->truncated = 1;
+            return 1;
+        }
+        r->matches = grown;
+        r->capacity = cap;
+    }
+    r->matches[r->count].start = start;
+    r->matches[r->count].end = end;
+    r->count++;
+    return 0;
+}
+
+void search_collect(Search* s, const TextBuffer* tb, SearchResults* r) {
+    r->count = 0;
+    r->truncated = 0;
+    search_buffer(s, tb, collect_match, r);
+}
+
+void search_results_free(SearchResults* r) {
+    free(r->matches);
+    memset(r, 0, sizeof(*r));
+}
+
+int search_first_after(const SearchResults* r, size_t offset) {
+    int lo = 0;
+    int hi = r->count;
+    while (lo < hi) {
+        int mid = lo + (hi - lo) / 2;
+        if (r->matches[mid].end <= offset) lo = mid + 1;
+        else hi = mid;
+    }
+    return lo;
+}
+
+char* search_replacement(const TextBuffer* tb, const SearchResults* r,
+                         const char* replacement, size_t replacement_length,
+                         size_t* length) {
+    *length = 0;
+    if (r->count == 0) return NULL;
+    size_t first = r->matches[0].start;
+    size_t last = r->matches[r->count - 1].end;
+    size_t total = last - first;
+    for (int i = 0; i < r->count; i++) {
+        total += replacement_length - (r->matches[i].end - r->matches[i].start);
+    }
+
+    char* out = (char*)malloc(total + 1);
+    if (!out) return NULL;
+    char* p = out;
+    size_t at = first;
+    for (int i = 0; i < r->count; i++) {
+        p += tb_read(tb, at, r->matches[i].start - at, p);
+        memcpy(p, replacement, replacement_length);
+        p += replacement_length;
+        at = r->matches[i].end;
+    }
+    *length = (size_t)(p - out);
+    return out;
+}
@@ -0,0 +1,89 @@
+#ifndef SEARCH_H
+#define SEARCH_H
+
+#include <stddef.h>
+
+#include "text_buffer.h"
+
+// Find over the whole buffer, one piece at a time without copying it.
+//
+// Literal patterns are found by comparing the pattern's first and last
+// bytes against 16 (SSE2) or 32 (AVX2) positions at once and checking only
+// the positions where both agree.
+//
+// Regular expressions support . [] [^] * + ? | () ^ $ and the escapes
+// \d \w \s \D \W \S \t. They are compiled to an NFA whose DFA states are
+// built lazily while scanning, so every byte costs one table lookup and
+// nothing ever backtracks. Matches never span lines. A forward DFA finds
+// the lines that contain a match; on those, a DFA for the reversed pattern
+// marks where matches start and a forward anchored one finds the longest
+// end, giving leftmost-longest matches.
+
+#define SEARCH_MAX_PATTERN 256
+#define SEARCH_MAX_MATCHES (1 << 20)
+
+enum {
+    SEARCH_LITERAL,
+    SEARCH_REGEX
+};
+
+enum {
+    SEARCH_KERNEL_SCALAR,
+    SEARCH_KERNEL_SSE2,
+    SEARCH_KERNEL_AVX2
+};
+
+typedef struct Regex Regex;
+
+typedef struct {
+    int mode;
+    char pattern[SEARCH_MAX_PATTERN + 1];
+    size_t length;
+    Regex* regex;
+    const char* error;
+} Search;
+
+typedef struct {
+    size_t start;
+    size_t end;
+} SearchMatch;
+
+typedef struct {
+    SearchMatch* matches;
+    int count;
+    int capacity;
+    int truncated;
+} SearchResults;
+
+// Called for each match in order; returning nonzero stops the search.
+typedef int (*SearchMatchFn)(size_t start, size_t end, void* ctx);
+
+// Returns -1 and sets s->error for a pattern that is empty, malformed or
+// would match empty text.
+int search_compile(Search* s, const char* pattern, size_t length, int mode);
+void search_free(Search* s);
+
+// Reports non-overlapping matches.
+int search_text(Search* s, const char* text, size_t length, SearchMatchFn fn, void* ctx);
+int search_buffer(Search* s, const TextBuffer* tb, SearchMatchFn fn, void* ctx);
+
+// Replaces r's contents with the buffer's matches, keeping the first
+// SEARCH_MAX_MATCHES.
+void search_collect(Search* s, const TextBuffer* tb, SearchResults* r);
+void search_results_free(SearchResults* r);
+
+// Index of the first match ending after offset, or r->count.
+int search_first_after(const SearchResults* r, size_t offset);
+
+// Builds the text that replaces everything from the first match's start to
+// the last match's end, with each match swapped for replacement. Returns
+// NULL when out of memory.
+char* search_replacement(const TextBuffer* tb, const SearchResults* r,
+                         const char* replacement, size_t replacement_length,
+                         size_t* length);
+
+// The best kernel the CPU supports is used by default.
+int search_kernel();
+void search_set_kernel(int kernel);
+
+#endif
@@ -0,0 +1,1062 @@
+#include "symbol_index.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <sys/stat.h>
+
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <thread>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <dirent.h>
+#endif
+
+#include "input.h"
+#include "pool.h"
+#include "profile.h"
+
+#define SYMBOLS_CACHE_MAGIC 0x4D595331u
+#define SYMBOLS_CACHE_VERSION 1
+#define SYMBOLS_PATH_MAX 1024
+#define SYMBOLS_BLOCK_DEPTH 64
+#define SYMBOLS_WAKE_MS 100
+#define KEYWORD_SLOTS 256
+
+enum {
+    BLOCK_SCOPE,
+    BLOCK_RECORD,
+    BLOCK_ENUM,
+    BLOCK_CODE
+};
+
+enum {
+    TAG_NONE,
+    TAG_RECORD,
+    TAG_ENUM
+};
+
+// One source file and the names it declares, NUL-separated.
+typedef struct {
+    char* path;
+    long long mtime;
+    unsigned long long size;
+    unsigned long long hash;
+    char* names;
+    unsigned int names_length;
+    unsigned int name_count;
+    int system;
+} SymbolFile;
+
+typedef struct {
+    char path[SYMBOLS_PATH_MAX];
+    int system;
+} SymbolRoot;
+
+typedef struct {
+    char* path;
+    int system;
+} WalkTask;
+
+// Names found in one file, each kept once.
+typedef struct {
+    char* names;
+    unsigned int length;
+    unsigned int capacity;
+    unsigned int count;
+    unsigned int* table;
+    unsigned int table_capacity;
+    int system;
+} NameList;
+
+// What is known of the declaration being read. last is the latest
+// identifier outside brackets, declarator the name in a `(*name)`.
+typedef struct {
+    const char* last;
+    const char* declarator;
+    unsigned char last_length;
+    unsigned char declarator_length;
+    unsigned char paren;
+    unsigned char bracket;
+    unsigned char angle;
+    unsigned char tag;
+    unsigned char tag_name;
+    unsigned char assign;
+    unsigned char call;
+    unsigned char scope;
+    unsigned char access;
+    unsigned char item;
+} Statement;
+
+static SymbolRoot roots[SYMBOLS_MAX_ROOTS];
+static int root_count = 0;
+static char cache_file[SYMBOLS_PATH_MAX];
+
+static std::thread coordinator;
+static int running = 0;
+static int pool_size = 0;
+static std::atomic<int> stopping(0);
+static std::atomic<int> state(SYMBOLS_IDLE);
+static std::atomic<unsigned int> files_found(0);
+static std::atomic<unsigned int> files_done(0);
+static std::atomic<unsigned int> files_lexed(0);
+static std::atomic<unsigned int> files_read(0);
+static std::atomic<unsigned int> symbol_count(0);
+static std::atomic<long long> elapsed_us(0);
+static std::atomic<Trie*> published(NULL);
+static std::atomic<unsigned int> version(0);
+
+// Every file found this run, appended to by the walk tasks.
+static std::mutex files_mutex;
+static SymbolFile** files = NULL;
+static unsigned int file_count = 0;
+static unsigned int file_capacity = 0;
+
+// The previous run's files, pointing into cache_data and read-only while
+// the pool runs. Files changed at or after cached_at may have changed
+// again within the same second, so their contents are always checked.
+static char* cache_data = NULL;
+static SymbolFile* cached = NULL;
+static unsigned int cached_count = 0;
+static SymbolFile** cached_table = NULL;
+static unsigned int cached_capacity = 0;
+static long long cached_at = 0;
+static unsigned int cached_symbols = 0;
+static char trie_file[SYMBOLS_PATH_MAX + 8];
+
+static const char* const keywords[] = {
+    "alignas", "alignof", "asm", "auto", "bool", "break", "case", "catch", "char",
+    "class", "const", "constexpr", "const_cast", "continue", "decltype", "default",
+    "delete", "double", "dynamic_cast", "else", "enum", "explicit", "export", "extern",
+    "false", "final", "float", "for", "friend", "goto", "inline", "int", "long",
+    "mutable", "namespace", "new", "noexcept", "nullptr", "operator", "override",
+    "private", "protected", "public", "register", "reinterpret_cast", "restrict",
+    "return", "short", "signed", "sizeof", "static", "static_assert", "static_cast",
+    "struct", "switch", "template", "this", "throw", "true", "try", "typedef", "typeid",
+    "typename", "union", "unsigned", "using", "virtual", "void", "volatile", "wchar_t",
+    "while",
+    NULL
+};
+
+static unsigned long long hash_bytes(const char* s, size_t n) {
+    unsigned long long h = 14695981039346656037ull;
+    for (size_t i = 0; i < n; i++) {
+        h ^= (unsigned char)s[i];
+        h *= 1099511628211ull;
+    }
+    return h;
+}
+
+static unsigned int hash_name(const char* s, int n) {
+    unsigned int h = 2166136261u;
+    for (int i = 0; i < n; i++) {
+        h ^= (unsigned char)s[i];
+        h *= 16777619u;
+    }
+    return h;
+}
+
+static char* copy_string(const char* s) {
+    size_t n = strlen(s) + 1;
+    char* copy = (char*)malloc(n);
+    if (copy) memcpy(copy, s, n);
+    return copy;
+}
+
+static int ident_start(char c) {
+    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c == '_';
+}
+
+static int ident_char(char c) {
+    return ident_start(c) || (c >= '0' && c <= '9');
+}
+
+static int is_word(const char* s, int n, const char* word) {
+    return strncmp(s, word, n) == 0 && word[n] == '\0';
+}
+
+static int fill_keywords(const char** table) {
+    for (int i = 0; keywords[i]; i++) {
+        unsigned int j = hash_name(keywords[i], (int)strlen(keywords[i])) & (KEYWORD_SLOTS - 1);
+        while (table[j]) j = (j + 1) & (KEYWORD_SLOTS - 1);
+        table[j] = keywords[i];
+    }
+    return 1;
+}
+
+// Nearly every identifier outside a function body is looked up, so the
+// keywords go into a hash table the first time.
+static int is_keyword(const char* s, int n) {
+    static const char* table[KEYWORD_SLOTS];
+    static int filled = fill_keywords(table);
+    (void)filled;
+    unsigned int j = hash_name(s, n) & (KEYWORD_SLOTS - 1);
+    while (table[j]) {
+        if (is_word(s, n, table[j])) return 1;
+        j = (j + 1) & (KEYWORD_SLOTS - 1);
+    }
+    return 0;
+}
+
+static int grow_table(NameList* list) {
+    unsigned int capacity = list->table_capacity ? list->table_capacity * 2 : 256;
+    unsigned int* table = (unsigned int*)calloc(capacity, sizeof(unsigned int));
+    if (!table) return -1;
+    for (unsigned int i = 0; i < list->table_capacity; i++) {
+        unsigned int at = list->table[i];
+        if (!at) continue;
+        const char* name = list->names + at - 1;
+        unsigned int j = hash_name(name, (int)strlen(name)) & (capacity - 1);
+        while (table[j]) j = (j + 1) & (capacity - 1);
+        table[j] = at;
+    }
+    free(list->table);
+    list->table = table;
+    list->table_capacity = capacity;
+    return 0;
+}
+
+// Reserved names of the implementation and keywords are never offered.
+static void emit(NameList* list, const char* s, int n) {
+    if (n < SYMBOLS_MIN_LENGTH || n > SYMBOLS_MAX_LENGTH) return;
+    if (s[0] == '_' && (list->system || s[1] == '_' || (s[1] >= 'A' && s[1] <= 'Z'))) return;
+    if (is_keyword(s, n)) return;
+
+    if ((list->count + 1) * 2 > list->table_capacity && grow_table(list) != 0) return;
+    unsigned int mask = list->table_capacity - 1;
+    unsigned int j = hash_name(s, n) & mask;
+    while (list->table[j]) {
+        const char* name = list->names + list->table[j] - 1;
+        if (strncmp(name, s, n) == 0 && name[n] == '\0') return;
+        j = (j + 1) & mask;
+    }
+
+    if (list->length + n + 1 > list->capacity) {
+        unsigned int cap = list->capacity ? list->capacity * 2 : 4096;
+        while (cap < list->length + n + 1) cap *= 2;
+        char* grown = (char*)realloc(list->names, cap);
+        if (!grown) return;
+        list->names = grown;
+        list->capacity = cap;
+    }
+    memcpy(list->names + list->length, s, n);
+    list->names[list->length + n] = '\0';
+    list->table[j] = list->length + 1;
+    list->length += n + 1;
+    list->count++;
+}
+
+static size_t skip_space(const char* text, size_t length, size_t i) {
+    while (i < length && (text[i] == ' ' || text[i] == '\t' || text[i] == '\r')) i++;
+    return i;
+}
+
+// Reads a preprocessor line from just after its '#', keeping the name of a
+// #define, and returns the offset of the newline that ends it.
+static size_t directive(NameList* list, const char* text, size_t length, size_t i) {
+    i = skip_space(text, length, i);
+    size_t start = i;
+    while (i < length && ident_char(text[i])) i++;
+    if (is_word(text + start, (int)(i - start), "define")) {
+        i = skip_space(text, length, i);
+        start = i;
+        while (i < length && ident_char(text[i])) i++;
+        if (i > start && ident_start(text[start])) emit(list, text + start, (int)(i - start));
+    }
+    while (i < length && text[i] != '\n') {
+        if (text[i] == '\\' && i + 1 < length && (text[i + 1] == '\n' || text[i + 1] == '\r')) {
+            i++;
+            if (text[i] == '\r' && i + 1 < length && text[i + 1] == '\n') i++;
+        } else if (text[i] == '/' && i + 1 < length && text[i + 1] == '*') {
+            i += 2;
+            while (i + 1 < length && !(text[i] == '*' && text[i + 1] == '/')) i++;
+            i++;
+        }
+        i++;
+    }
+    return i;
+}
+
+// The name of a declarator that just ended, if it declared anything.
+static void end_declarator(NameList* list, Statement* st) {
+    if (st->declarator) {
+        emit(list, st->declarator, st->declarator_length);
+    } else if (st->last && !st->call) {
+        emit(list, st->last, st->last_length);
+    }
+    st->last = NULL;
+    st->declarator = NULL;
+    st->call = 0;
+}
+
+static void identifier(NameList* list, Statement* st, int kind, const char* s, int n,
+                       char next, char previous) {
+    if (st->bracket || st->angle) return;
+    if (kind == BLOCK_ENUM) {
+        if (st->item && !st->paren) emit(list, s, n);
+        st->item = 0;
+        return;
+    }
+    if (st->paren) {
+        if (!st->declarator && !st->call && st->paren == 1 && previous == '*' &&
+            n <= SYMBOLS_MAX_LENGTH) {
+            st->declarator = s;
+            st->declarator_length = (unsigned char)n;
+        }
+        return;
+    }
+    if (st->assign) return;
+
+    if (is_word(s, n, "struct") || is_word(s, n, "union") || is_word(s, n, "class")) {
+        if (st->tag != TAG_ENUM) st->tag = TAG_RECORD;
+        st->tag_name = 1;
+    } else if (is_word(s, n, "enum")) {
+        st->tag = TAG_ENUM;
+        st->tag_name = 1;
+    } else if (is_word(s, n, "namespace") || is_word(s, n, "extern")) {
+        st->scope = 1;
+    } else if (is_word(s, n, "public") || is_word(s, n, "private") ||
+               is_word(s, n, "protected")) {
+        st->access = 1;
+    } else if (is_keyword(s, n)) {
+        // Type names and qualifiers say nothing about what is declared.
+    } else if (st->tag_name) {
+        emit(list, s, n);
+        st->tag_name = 0;
+        st->last = NULL;
+    } else if (next == '(') {
+        emit(list, s, n);
+        st->call = 1;
+        st->last = NULL;
+    } else {
+        st->last = n <= SYMBOLS_MAX_LENGTH ? s : NULL;
+        st->last_length = (unsigned char)n;
+    }
+}
+
+// Finds the declarations of C and C++ source: #define names, tags,
+// typedefs, functions, globals, members and enum constants. Function
+// bodies and initializers are skipped by brace matching alone.
+static void lex(NameList* list, const char* text, size_t length) {
+    unsigned char blocks[SYMBOLS_BLOCK_DEPTH];
+    Statement saved[SYMBOLS_BLOCK_DEPTH];
+    int depth = 0;
+    int lost = 0;
+    blocks[0] = BLOCK_SCOPE;
+    Statement st;
+    memset(&st, 0, sizeof(st));
+    int line_start = 1;
+    char previous = '\0';
+
+    size_t i = 0;
+    while (i < length) {
+        char c = text[i];
+        if (c == '\n') {
+            line_start = 1;
+            i++;
+            continue;
+        }
+        if (c == ' ' || c == '\t' || c == '\r' || c == '\f' || c == '\v') {
+            i++;
+            continue;
+        }
+        if (c == '#' && line_start) {
+            i = directive(list, text, length, i + 1);
+            continue;
+        }
+        line_start = 0;
+
+        if (c == '/' && i + 1 < length && text[i + 1] == '/') {
+            while (i < length && text[i] != '\n') i++;
+            continue;
+        }
+        if (c == '/' && i + 1 < length && text[i + 1] == '*') {
+            i += 2;
+            while (i + 1 < length && !(text[i] == '*' && text[i + 1] == '/')) i++;
+            i += 2;
+            continue;
+        }
+        if (c == '"' || c == '\'') {
+            i++;
+            while (i < length && text[i] != c && text[i] != '\n') {
+                if (text[i] == '\\' && i + 1 < length) i++;
+                i++;
+            }
+            i++;
+            previous = c;
+            continue;
+        }
+
+        int kind = lost ? (int)BLOCK_CODE : (int)blocks[depth];
+        if (ident_start(c)) {
+            size_t start = i;
+            while (i < length && ident_char(text[i])) i++;
+            if (kind != BLOCK_CODE) {
+                size_t after = skip_space(text, length, i);
+                identifier(list, &st, kind, text + start, (int)(i - start),
+                           after < length ? text[after] : '\0', previous);
+            }
+            previous = 'a';
+            continue;
+        }
+        if (c >= '0' && c <= '9') {
+            while (i < length && (ident_char(text[i]) || text[i] == '.')) i++;
+            previous = '0';
+            continue;
+        }
+        i++;
+        previous = c;
+
+        if (c == '{') {
+            int next = BLOCK_CODE;
+            if (kind == BLOCK_CODE || st.call || st.assign || st.paren || kind == BLOCK_ENUM) {
+                next = BLOCK_CODE;
+            } else if (st.tag == TAG_RECORD) {
+                next = BLOCK_RECORD;
+            } else if (st.tag == TAG_ENUM) {
+                next = BLOCK_ENUM;
+            } else if (st.scope) {
+                next = BLOCK_SCOPE;
+            }
+            if (lost || depth + 1 == SYMBOLS_BLOCK_DEPTH) {
+                lost++;
+                continue;
+            }
+            saved[depth] = st;
+            blocks[++depth] = (unsigned char)next;
+            memset(&st, 0, sizeof(st));
+            st.item = 1;
+            continue;
+        }
+        if (c == '}') {
+            if (lost) {
+                lost--;
+                continue;
+            }
+            if (depth == 0) {
+                memset(&st, 0, sizeof(st));
+                continue;
+            }
+            int closed = blocks[depth--];
+            st = saved[depth];
+            // A function body or a namespace ends its declaration; a record,
+            // an enum or an initializer is followed by the rest of it.
+            if (closed == BLOCK_SCOPE || (closed == BLOCK_CODE && !st.assign)) {
+                memset(&st, 0, sizeof(st));
+            } else {
+                st.tag = TAG_NONE;
+                st.tag_name = 0;
+                st.last = NULL;
+            }
+            continue;
+        }
+        if (kind == BLOCK_CODE) continue;
+
+        switch (c) {
+        case '(':
+            if (st.paren < 255) st.paren++;
+            break;
+        case ')':
+            if (st.paren) st.paren--;
+            break;
+        case '[':
+            if (st.bracket < 255) st.bracket++;
+            break;
+        case ']':
+            if (st.bracket) st.bracket--;
+            break;
+        case '<':
+            // Outside expressions only template arguments use angles.
+            if (kind != BLOCK_ENUM && !st.paren && !st.bracket && !st.assign && st.angle < 255) {
+                st.angle++;
+            }
+            break;
+        case '>':
+            if (st.angle) st.angle--;
+            break;
+        case ':':
+            if (i < length && text[i] == ':') {
+                i++;
+            } else if (kind == BLOCK_RECORD && !st.paren && !st.tag) {
+                // public: and friends, or the width of a bit-field.
+                if (st.access) {
+                    memset(&st, 0, sizeof(st));
+                } else {
+                    end_declarator(list, &st);
+                    st.assign = 1;
+                }
+            }
+            break;
+        case '=':
+            if (kind == BLOCK_ENUM || st.paren || st.bracket || st.angle) break;
+            if (i < length && text[i] == '=') {
+                i++;
+                break;
+            }
+            end_declarator(list, &st);
+            st.assign = 1;
+            break;
+        case ',':
+            if (st.paren || st.bracket) break;
+            if (kind == BLOCK_ENUM) {
+                st.item = 1;
+            } else if (!st.angle) {
+                if (!st.assign) end_declarator(list, &st);
+                st.assign = 0;
+                st.last = NULL;
+                st.declarator = NULL;
+                st.call = 0;
+            }
+            break;
+        case ';':
+            if (!st.assign && !st.paren && !st.bracket) end_declarator(list, &st);
+            memset(&st, 0, sizeof(st));
+            break;
+        }
+    }
+}
+
+static int source_file(const char* name) {
+    static const char* const extensions[] = {
+        ".c", ".h", ".cc", ".cpp", ".cxx", ".hh", ".hpp", ".hxx", NULL
+    };
+    const char* dot = strrchr(name, '.');
+    if (!dot) return 0;
+    for (int i = 0; extensions[i]; i++) {
+        if (strcmp(dot, extensions[i]) == 0) return 1;
+    }
+    return 0;
+}
+
+static const SymbolFile* find_cached(const char* path) {
+    if (!cached_capacity) return NULL;
+    unsigned int mask = cached_capacity - 1;
+    unsigned int j = hash_name(path, (int)strlen(path)) & mask;
+    while (cached_table[j]) {
+        if (strcmp(cached_table[j]->path, path) == 0) return cached_table[j];
+        j = (j + 1) & mask;
+    }
+    return NULL;
+}
+
+static int reuse(SymbolFile* f, const SymbolFile* old) {
+    if (old->names_length) {
+        f->names = (char*)malloc(old->names_length);
+        if (!f->names) return -1;
+        memcpy(f->names, old->names, old->names_length);
+    }
+    f->names_length = old->names_length;
+    f->name_count = old->name_count;
+    f->hash = old->hash;
+    return 0;
+}
+
+static char* read_file(const char* path, size_t limit, size_t* length) {
+    FILE* fp = fopen(path, "rb");
+    if (!fp) return NULL;
+    size_t capacity = 65536;
+    size_t n = 0;
+    char* data = (char*)malloc(capacity);
+    while (data) {
+        n += fread(data + n, 1, capacity - n, fp);
+        if (n < capacity) break;
+        if (capacity >= limit) {
+            free(data);
+            data = NULL;
+            break;
+        }
+        char* grown = (char*)realloc(data, capacity * 2);
+        if (!grown) {
+            free(data);
+            data = NULL;
+            break;
+        }
+        data = grown;
+        capacity *= 2;
+    }
+    fclose(fp);
+    *length = n;
+    return data;
+}
+
+static void lex_task(void* arg) {
+    SymbolFile* f = (SymbolFile*)arg;
+    if (!stopping.load()) {
+        PROFILE_SCOPE(PROFILE_INDEX);
+        size_t length = 0;
+        char* text = read_file(f->path, SYMBOLS_MAX_FILE_SIZE, &length);
+        if (text) {
+            files_read++;
+            f->hash = hash_bytes(text, length);
+            const SymbolFile* old = find_cached(f->path);
+            if (!(old && old->hash == f->hash && old->size == length && reuse(f, old) == 0)) {
+                NameList list;
+                memset(&list, 0, sizeof(list));
+                list.system = f->system;
+                lex(&list, text, length);
+                free(list.table);
+                f->names = list.names;
+                f->names_length = list.length;
+                f->name_count = list.count;
+                files_lexed++;
+            }
+            free(text);
+        }
+    }
+    files_done++;
+}
+
+static int add_file(SymbolFile* f) {
+    std::lock_guard<std::mutex> lock(files_mutex);
+    if (file_count == file_capacity) {
+        unsigned int cap = file_capacity ? file_capacity * 2 : 1024;
+        SymbolFile** grown = (SymbolFile**)realloc(files, cap * sizeof(SymbolFile*));
+        if (!grown) return -1;
+        files = grown;
+        file_capacity = cap;
+    }
+    files[file_count++] = f;
+    return 0;
+}
+
+// Takes what the cache knows when the file's time and size are unchanged,
+// and queues it for reading otherwise.
+static void found_file(const char* path, unsigned long long size, long long mtime, int system) {
+    SymbolFile* f = (SymbolFile*)calloc(1, sizeof(SymbolFile));
+    if (!f) return;
+    f->path = copy_string(path);
+    f->size = size;
+    f->mtime = mtime;
+    f->system = system;
+    if (!f->path || add_file(f) != 0) {
+        free(f->path);
+        free(f);
+        return;
+    }
+    files_found++;
+
+    const SymbolFile* old = find_cached(path);
+    if (old && old->mtime == mtime && old->size == size && mtime < cached_at &&
+        reuse(f, old) == 0) {
+        files_done++;
+        return;
+    }
+    if (size > SYMBOLS_MAX_FILE_SIZE) {
+        files_done++;
+        return;
+    }
+    if (pool_submit(lex_task, f) != 0) lex_task(f);
+}
+
+static void walk_task(void* arg);
+
+static void walk(const char* path, int system) {
+    WalkTask* task = (WalkTask*)malloc(sizeof(WalkTask));
+    if (!task) return;
+    task->path = copy_string(path);
+    task->system = system;
+    if (!task->path || pool_submit(walk_task, task) != 0) {
+        free(task->path);
+        free(task);
+    }
+}
+
+#ifdef _WIN32
+
+static void walk_directory(const char* path, int system) {
+    char pattern[SYMBOLS_PATH_MAX];
+    char child[SYMBOLS_PATH_MAX];
+    if (snprintf(pattern, sizeof(pattern), "%s\\*", path) >= (int)sizeof(pattern)) return;
+    WIN32_FIND_DATAA fd;
+    HANDLE h = FindFirstFileA(pattern, &fd);
+    if (h == INVALID_HANDLE_VALUE) return;
+    do {
+        // Hidden directories hold tools' state, not sources.
+        if (fd.cFileName[0] == '.') continue;
+        if (snprintf(child, sizeof(child), "%s\\%s", path, fd.cFileName) >= (int)sizeof(child)) {
+            continue;
+        }
+        if (fd.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) {
+            if (!(fd.dwFileAttributes & FILE_ATTRIBUTE_REPARSE_POINT)) walk(child, system);
+        } else if (source_file(fd.cFileName)) {
+            unsigned long long size = ((unsigned long long)fd.nFileSizeHigh << 32) | fd.nFileSizeLow;
+            unsigned long long ticks = ((unsigned long long)fd.ftLastWriteTime.dwHighDateTime << 32) |
+                                       fd.ftLastWriteTime.dwLowDateTime;
+            found_file(child, size, (long long)(ticks / 10000000ull) - 11644473600ll, system);
+        }
+    } while (!stopping.load() && FindNextFileA(h, &fd));
+    FindClose(h);
+}
+
+#else
+
+// Symbolic links to directories are not followed, so a link cycle can't
+// make the walk endless.
+static void walk_directory(const char* path, int system) {
+    DIR* dir = opendir(path);
+    if (!dir) return;
+    char child[SYMBOLS_PATH_MAX];
+    struct dirent* e;
+    while (!stopping.load() && (e = readdir(dir)) != NULL) {
+        if (e->d_name[0] == '.') continue;
+        int source = source_file(e->d_name);
+        if (!source && e->d_type != DT_DIR && e->d_type != DT_UNKNOWN) continue;
+        if (snprintf(child, sizeof(child), "%s/%s", path, e->d_name) >= (int)sizeof(child)) {
+            continue;
+        }
+        struct stat st;
+        if (lstat(child, &st) != 0) continue;
+        int link = S_ISLNK(st.st_mode);
+        if (link && (!source || stat(child, &st) != 0)) continue;
+        if (S_ISDIR(st.st_mode)) {
+            if (!link) walk(child, system);
+        } else if (S_ISREG(st.st_mode) && source) {
+            found_file(child, (unsigned long long)st.st_size, (long long)st.st_mtime, system);
+        }
+    }
+    closedir(dir);
+}
+
+#endif
+
+static void walk_task(void* arg) {
+    WalkTask* task = (WalkTask*)arg;
+    if (!stopping.load()) walk_directory(task->path, task->system);
+    free(task->path);
+    free(task);
+}
+
+static void free_cache() {
+    free(cache_data);
+    free(cached);
+    free(cached_table);
+    cache_data = NULL;
+    cached = NULL;
+    cached_table = NULL;
+    cached_count = cached_capacity = 0;
+    cached_at = 0;
+    cached_symbols = 0;
+}
+
+typedef struct {
+    unsigned int magic;
+    unsigned int version;
+    long long saved_at;
+    unsigned long long body_hash;
+    unsigned int count;
+    unsigned int symbols;
+} SymbolCacheHeader;
+
+typedef struct {
+    long long mtime;
+    unsigned long long size;
+    unsigned long long hash;
+    unsigned int path_length;
+    unsigned int names_length;
+    unsigned int name_count;
+    unsigned int reserved;
+} SymbolCacheRecord;
+
+// A cache that is missing, from another version or damaged anywhere is
+// ignored as a whole; the run then lexes everything.
+static void load_cache() {
+    size_t length = 0;
+    cache_data = read_file(cache_file, (size_t)-1 / 2, &length);
+    if (!cache_data) return;
+
+    SymbolCacheHeader header;
+    if (length < sizeof(header)) {
+        free_cache();
+        return;
+    }
+    memcpy(&header, cache_data, sizeof(header));
+    if (header.magic != SYMBOLS_CACHE_MAGIC || header.version != SYMBOLS_CACHE_VERSION ||
+        header.body_hash != hash_bytes(cache_data + sizeof(header), length - sizeof(header)) ||
+        header.count > length / sizeof(SymbolCacheRecord)) {
+        free_cache();
+        return;
+    }
+
+    cached = (SymbolFile*)calloc(header.count + 1, sizeof(SymbolFile));
+    cached_capacity = 16;
+    while (cached_capacity < header.count * 2) cached_capacity *= 2;
+    cached_table = (SymbolFile**)calloc(cached_capacity, sizeof(SymbolFile*));
+    if (!cached || !cached_table) {
+        free_cache();
+        return;
+    }
+
+    size_t at = sizeof(header);
+    for (unsigned int i = 0; i < header.count; i++) {
+        SymbolCacheRecord r;
+        if (length - at < sizeof(r)) break;
+        memcpy(&r, cache_data + at, sizeof(r));
+        at += sizeof(r);
+        if (r.path_length == 0 || r.path_length > length - at ||
+            r.names_length > length - at - r.path_length) {
+            break;
+        }
+        SymbolFile* f = &cached[cached_count];
+        f->path = cache_data + at;
+        f->names = cache_data + at + r.path_length;
+        at += r.path_length + r.names_length;
+        if (f->path[r.path_length - 1] != '\0' ||
+            (r.names_length && f->names[r.names_length - 1] != '\0')) {
+            break;
+        }
+        f->mtime = r.mtime;
+        f->size = r.size;
+        f->hash = r.hash;
+        f->names_length = r.names_length;
+        f->name_count = r.name_count;
+        cached_count++;
+    }
+    if (cached_count != header.count) {
+        free_cache();
+        return;
+    }
+
+    unsigned int mask = cached_capacity - 1;
+    for (unsigned int i = 0; i < cached_count; i++) {
+        unsigned int j = hash_name(cached[i].path, (int)strlen(cached[i].path)) & mask;
+        while (cached_table[j]) j = (j + 1) & mask;
+        cached_table[j] = &cached[i];
+    }
+    cached_at = header.saved_at;
+    cached_symbols = header.symbols;
+}
+
+static int replace_file(const char* from, const char* to) {
+#ifdef _WIN32
+    return MoveFileExA(from, to, MOVEFILE_REPLACE_EXISTING) ? 0 : -1;
+#else
+    return rename(from, to);
+#endif
+}
+
+// Built in memory so the body hash can go into the header, then swapped in
+// whole.
+static void save_cache(long long started, unsigned int symbols) {
+    size_t length = sizeof(SymbolCacheHeader);
+    for (unsigned int i = 0; i < file_count; i++) {
+        length += sizeof(SymbolCacheRecord) + strlen(files[i]->path) + 1 + files[i]->names_length;
+    }
+    char* image = (char*)malloc(length);
+    if (!image) return;
+
+    size_t at = sizeof(SymbolCacheHeader);
+    for (unsigned int i = 0; i < file_count; i++) {
+        const SymbolFile* f = files[i];
+        SymbolCacheRecord r;
+        memset(&r, 0, sizeof(r));
+        r.mtime = f->mtime;
+        r.size = f->size;
+        r.hash = f->hash;
+        r.path_length = (unsigned int)strlen(f->path) + 1;
+        r.names_length = f->names_length;
+        r.name_count = f->name_count;
+        memcpy(image + at, &r, sizeof(r));
+        at += sizeof(r);
+        memcpy(image + at, f->path, r.path_length);
+        at += r.path_length;
+        if (r.names_length) memcpy(image + at, f->names, r.names_length);
+        at += r.names_length;
+    }
+
+    SymbolCacheHeader header;
+    memset(&header, 0, sizeof(header));
+    header.magic = SYMBOLS_CACHE_MAGIC;
+    header.version = SYMBOLS_CACHE_VERSION;
+    header.saved_at = started;
+    header.body_hash = hash_bytes(image + sizeof(header), length - sizeof(header));
+    header.count = file_count;
+    header.symbols = symbols;
+    memcpy(image, &header, sizeof(header));
+
+    char tmp[SYMBOLS_PATH_MAX + 8];
+    snprintf(tmp, sizeof(tmp), "%s.tmp", cache_file);
+    FILE* f = fopen(tmp, "wb");
+    if (!f) {
+        free(image);
+        return;
+    }
+    int ok = fwrite(image, 1, length, f) == length;
+    ok = fclose(f) == 0 && ok;
+    free(image);
+    if (!ok || replace_file(tmp, cache_file) != 0) remove(tmp);
+}
+
+// Files of the project rank above the system's.
+static Trie* merge() {
+    Trie* trie = create_trie();
+    if (!trie) return NULL;
+    for (unsigned int i = 0; i < file_count && !stopping.load(); i++) {
+        const SymbolFile* f = files[i];
+        const char* name = f->names;
+        for (unsigned int k = 0; k < f->name_count; k++) {
+            trie_insert_weighted(trie, name, f->system ? 0 : 1);
+            name += strlen(name) + 1;
+        }
+    }
+    return trie;
+}
+
+static void free_files() {
+    for (unsigned int i = 0; i < file_count; i++) {
+        free(files[i]->path);
+        free(files[i]->names);
+        free(files[i]);
+    }
+    free(files);
+    files = NULL;
+    file_count = file_capacity = 0;
+}
+
+// When every file came out of the cache unchanged, the trie saved with it
+// is still right and is mapped instead of merged again.
+static Trie* load_trie() {
+    if (files_lexed.load() != 0 || file_count != cached_count) return NULL;
+    Trie* trie = trie_map(trie_file);
+    if (trie && (trie->entry_count != cached_symbols || trie_verify(trie) != 0)) {
+        free_trie(trie);
+        trie = NULL;
+    }
+    return trie;
+}
+
+// Written aside and renamed over the old file, which an editor still
+// running may have mapped.
+static void save_trie(const Trie* trie) {
+    char tmp[SYMBOLS_PATH_MAX + 16];
+    snprintf(tmp, sizeof(tmp), "%s.tmp", trie_file);
+    if (trie_save(trie, tmp) != 0 || replace_file(tmp, trie_file) != 0) remove(tmp);
+}
+
+static void index_main() {
+    profile_thread("symbols");
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    long long started = (long long)time(NULL);
+    load_cache();
+
+    // The UI redraws the progress on every wake.
+    if (pool_start(pool_size) == 0) {
+        for (int r = 0; r < root_count; r++) walk(roots[r].path, roots[r].system);
+        while (!pool_wait(SYMBOLS_WAKE_MS)) input_wake();
+        pool_stop();
+    }
+
+    if (!stopping.load()) {
+        state = SYMBOLS_MERGING;
+        input_wake();
+        Trie* trie = load_trie();
+        int merged = 0;
+        if (!trie) {
+            // Saved before it is published; from then on the UI thread
+            // touches it.
+            trie = merge();
+            merged = 1;
+            if (trie && !stopping.load()) save_trie(trie);
+        }
+        // Files read again keep their symbols but get their new times. A
+        // merge also follows files added or deleted, so the cache has to
+        // match the trie just saved or the next start merges again.
+        if (trie && !stopping.load() && (files_read.load() != 0 || merged)) {
+            save_cache(started, trie->entry_count);
+        }
+        if (trie && !stopping.load()) {
+            symbol_count = trie->entry_count;
+            published.store(trie, std::memory_order_release);
+            version.fetch_add(1);
+        } else {
+            free_trie(trie);
+        }
+        elapsed_us = (long long)std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::steady_clock::now() - start).count();
+        state = SYMBOLS_READY;
+        input_wake();
+    }
+    free_files();
+    free_cache();
+}
+
+int symbols_add_root(const char* dir, int system) {
+    if (running || root_count == SYMBOLS_MAX_ROOTS) return -1;
+    if (strlen(dir) >= SYMBOLS_PATH_MAX) return -1;
+    strcpy(roots[root_count].path, dir);
+    roots[root_count].system = system;
+    root_count++;
+    return 0;
+}
+
+void symbols_add_system_roots() {
+#ifdef _WIN32
+    // Set by the Visual Studio developer prompt.
+    const char* include = getenv("INCLUDE");
+    char dir[SYMBOLS_PATH_MAX];
+    while (include && *include) {
+        size_t n = strcspn(include, ";");
+        if (n > 0 && n < sizeof(dir)) {
+            memcpy(dir, include, n);
+            dir[n] = '\0';
+            symbols_add_root(dir, 1);
+        }
+        include += n;
+        if (*include == ';') include++;
+    }
+#else
+    symbols_add_root("/usr/local/include", 1);
+    symbols_add_root("/usr/include", 1);
+#endif
+}
+
+int symbols_start(const char* cache_path, int threads) {
+    if (running || root_count == 0) return -1;
+    if (strlen(cache_path) >= SYMBOLS_PATH_MAX) return -1;
+    strcpy(cache_file, cache_path);
+    snprintf(trie_file, sizeof(trie_file), "%s.trie", cache_path);
+    pool_size = threads;
+    stopping = 0;
+    files_found = files_done = files_lexed = files_read = symbol_count = 0;
+    elapsed_us = 0;
+    state = SYMBOLS_SCANNING;
+    coordinator = std::thread(index_main);
+    running = 1;
+    return 0;
+}
+
+void symbols_stop() {
+    if (running) {
+        stopping = 1;
+        coordinator.join();
+        running = 0;
+    }
+    Trie* trie = published.exchange(NULL);
+    if (trie) {
+        free_trie(trie);
+        version.fetch_add(1);
+    }
+    root_count = 0;
+    state = SYMBOLS_IDLE;
+}
+
+void symbols_progress(SymbolProgress* out) {
+    out->state = state.load();
+    out->files_found = files_found.load();
+    out->files_done = files_done.load();
+    out->files_lexed = files_lexed.load();
+    out->symbols = symbol_count.load();
+    out->elapsed_ms = elapsed_us.load() / 1000.0;
+}
+
+Trie* symbols_trie() {
+    return published.load(std::memory_order_acquire);
+}
+
+unsigned int symbols_version() {
+    return version.load();
+}
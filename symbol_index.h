@@ -0,0 +1,58 @@
+#ifndef SYMBOL_INDEX_H
+#define SYMBOL_INDEX_H
+
+#include "trie.h"
+
+// Project-wide symbol index. A coordinator thread walks the project and the
+// system include directories on the work-stealing pool, lexes every C and
+// C++ source it finds for the functions, macros, types, struct members,
+// enum constants and globals it declares, and publishes one completion trie
+// of them all. What each file declared is kept in a cache file, so the next
+// run lexes only files whose modification time and contents both changed.
+
+#define SYMBOLS_MAX_ROOTS 8
+#define SYMBOLS_MIN_LENGTH 3
+#define SYMBOLS_MAX_LENGTH 64
+#define SYMBOLS_MAX_FILE_SIZE (4 * 1024 * 1024)
+
+enum {
+    SYMBOLS_IDLE,
+    SYMBOLS_SCANNING,
+    SYMBOLS_MERGING,
+    SYMBOLS_READY
+};
+
+typedef struct {
+    int state;
+    unsigned int files_found;
+    unsigned int files_done;
+    unsigned int files_lexed;
+    unsigned int symbols;
+    double elapsed_ms;
+} SymbolProgress;
+
+// Symbols of a project root rank above those of system roots. Call before
+// symbols_start(); returns -1 once SYMBOLS_MAX_ROOTS were added.
+int symbols_add_root(const char* dir, int system);
+
+// The compiler's default include directories.
+void symbols_add_system_roots();
+
+// Indexes the roots in the background, with threads pool workers (0 for
+// the default), reading and rewriting cache_path.
+int symbols_start(const char* cache_path, int threads);
+
+// Cancels indexing, frees the trie and forgets the roots.
+void symbols_stop();
+
+void symbols_progress(SymbolProgress* out);
+
+// NULL until indexing finished. The indexer never changes a published trie,
+// so the one thread reading it (the UI thread in the editor) may also
+// trie_touch() accepted words, until symbols_stop() frees it.
+Trie* symbols_trie();
+
+// Changes when the trie is published or freed.
+unsigned int symbols_version();
+
+#endif
@@ -0,0 +1,547 @@
+#include "text_buffer.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define TB_SSE2 1
+#endif
+
+static size_t sub_length(const PieceNode* n) { return n ? n->sub_length : 0; }
+static size_t sub_lf(const PieceNode* n) { return n ? n->sub_lf : 0; }
+
+static void piece_update(PieceNode* n) {
+    n->sub_length = n->length + sub_length(n->left) + sub_length(n->right);
+    n->sub_lf = n->lf_count + sub_lf(n->left) + sub_lf(n->right);
+}
+
+static unsigned int tb_rand(TextBuffer* tb) {
+    unsigned int x = tb->seed;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    tb->seed = x;
+    return x;
+}
+
+static size_t lower_bound(const size_t* a, size_t n, size_t value) {
+    size_t lo = 0, hi = n;
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (a[mid] < value) lo = mid + 1;
+        else hi = mid;
+    }
+    return lo;
+}
+
+static size_t chunk_newlines(const TextChunk* c, size_t start, size_t end) {
+    return lower_bound(c->newlines, c->newline_count, end) -
+           lower_bound(c->newlines, c->newline_count, start);
+}
+
+static void piece_recount(const TextBuffer* tb, PieceNode* n) {
+    n->lf_count = chunk_newlines(&tb->chunks[n->chunk], n->start, n->start + n->length);
+}
+
+static PieceNode* piece_create(TextBuffer* tb, int chunk, size_t start, size_t length) {
+    PieceNode* n = (PieceNode*)malloc(sizeof(PieceNode));
+    if (!n) return NULL;
+    n->left = n->right = NULL;
+    n->priority = tb_rand(tb);
+    n->chunk = chunk;
+    n->start = start;
+    n->length = length;
+    piece_recount(tb, n);
+    piece_update(n);
+    return n;
+}
+
+static void piece_free(PieceNode* n) {
+    if (!n) return;
+    piece_free(n->left);
+    piece_free(n->right);
+    free(n);
+}
+
+static PieceNode* piece_merge(PieceNode* a, PieceNode* b) {
+    if (!a) return b;
+    if (!b) return a;
+    if (a->priority >= b->priority) {
+        a->right = piece_merge(a->right, b);
+        piece_update(a);
+        return a;
+    }
+    b->left = piece_merge(a, b->left);
+    piece_update(b);
+    return b;
+}
+
+// Splits so that *l holds exactly the first `offset` bytes. A piece straddling
+// the split point is cut in two; the right half inherits its priority so the
+// heap order of both halves stays valid.
+static int piece_split(TextBuffer* tb, PieceNode* n, size_t offset,
+                       PieceNode** l, PieceNode** r) {
+    if (!n) {
+        *l = *r = NULL;
+        return 0;
+    }
+
+    size_t left_len = sub_length(n->left);
+    if (offset <= left_len) {
+        int rc = piece_split(tb, n->left, offset, l, &n->left);
+        piece_update(n);
+        *r = n;
+        return rc;
+    }
+    if (offset >= left_len + n->length) {
+        int rc = piece_split(tb, n->right, offset - left_len - n->length, &n->right, r);
+        piece_update(n);
+        *l = n;
+        return rc;
+    }
+
+    size_t k = offset - left_len;
+    PieceNode* m = (PieceNode*)malloc(sizeof(PieceNode));
+    if (!m) {
+        *l = n;
+        *r = NULL;
+        return -1;
+    }
+    m->left = NULL;
+    m->right = n->right;
+    m->priority = n->priority;
+    m->chunk = n->chunk;
+    m->start = n->start + k;
+    m->length = n->length - k;
+    piece_recount(tb, m);
+    piece_update(m);
+
+    n->right = NULL;
+    n->length = k;
+    piece_recount(tb, n);
+    piece_update(n);
+
+    *l = n;
+    *r = m;
+    return 0;
+}
+
+static int chunk_push_newline(TextChunk* c, size_t pos) {
+    if (c->newline_count == c->newline_capacity) {
+        size_t cap = c->newline_capacity ? c->newline_capacity * 2 : 64;
+        size_t* grown = (size_t*)realloc(c->newlines, cap * sizeof(size_t));
+        if (!grown) return -1;
+        c->newlines = grown;
+        c->newline_capacity = cap;
+    }
+    c->newlines[c->newline_count++] = pos;
+    return 0;
+}
+
+static int lowest_bit(unsigned int mask) {
+#ifdef _MSC_VER
+    unsigned long index;
+    _BitScanForward(&index, mask);
+    return (int)index;
+#else
+    return __builtin_ctz(mask);
+#endif
+}
+
+// Records the position of every '\n' in text[from, to) of the chunk, sixteen
+// bytes per compare where SSE2 is available.
+static int chunk_scan_newlines(TextChunk* c, size_t from, size_t to) {
+    const char* p = c->text;
+    size_t i = from;
+#ifdef TB_SSE2
+    const __m128i nl = _mm_set1_epi8('\n');
+    for (; i + 16 <= to; i += 16) {
+        __m128i bytes = _mm_loadu_si128((const __m128i*)(p + i));
+        unsigned int mask = (unsigned int)_mm_movemask_epi8(_mm_cmpeq_epi8(bytes, nl));
+        while (mask) {
+            if (chunk_push_newline(c, i + lowest_bit(mask)) != 0) return -1;
+            mask &= mask - 1;
+        }
+    }
+#endif
+    for (; i < to; i++) {
+        if (p[i] == '\n' && chunk_push_newline(c, i) != 0) return -1;
+    }
+    return 0;
+}
+
+static int tb_new_chunk(TextBuffer* tb, size_t capacity) {
+    if (tb->chunk_count == tb->chunk_capacity) {
+        int cap = tb->chunk_capacity ? tb->chunk_capacity * 2 : 8;
+        TextChunk* grown = (TextChunk*)realloc(tb->chunks, cap * sizeof(TextChunk));
+        if (!grown) return -1;
+        tb->chunks = grown;
+        tb->chunk_capacity = cap;
+    }
+
+    TextChunk* c = &tb->chunks[tb->chunk_count];
+    memset(c, 0, sizeof(*c));
+    if (capacity) {
+        c->text = (char*)malloc(capacity);
+        if (!c->text) return -1;
+        c->capacity = capacity;
+    }
+    return tb->chunk_count++;
+}
+
+// Appends to the newest add chunk, opening a fresh one when the text does not
+// fit. Pieces never span chunks.
+static int tb_append(TextBuffer* tb, const char* text, size_t length,
+                     int* chunk, size_t* start) {
+    int last = tb->chunk_count - 1;
+    if (last < 1 || tb->chunks[last].capacity - tb->chunks[last].length < length) {
+        last = tb_new_chunk(tb, length > TB_CHUNK_SIZE ? length : TB_CHUNK_SIZE);
+        if (last < 0) return -1;
+    }
+
+    TextChunk* c = &tb->chunks[last];
+    *chunk = last;
+    *start = c->length;
+    memcpy(c->text + c->length, text, length);
+    if (chunk_scan_newlines(c, c->length, c->length + length) != 0) return -1;
+    c->length += length;
+    return 0;
+}
+
+// Grows the rightmost piece in place when it already ends where the new text
+// was appended, which keeps ordinary typing to one piece per run.
+static int extend_rightmost(PieceNode* n, int chunk, size_t start, size_t length, size_t lf) {
+    if (!n) return 0;
+    if (n->right) {
+        if (!extend_rightmost(n->right, chunk, start, length, lf)) return 0;
+    } else {
+        if (n->chunk != chunk || n->start + n->length != start) return 0;
+        n->length += length;
+        n->lf_count += lf;
+    }
+    n->sub_length += length;
+    n->sub_lf += lf;
+    return 1;
+}
+
+int tb_init(TextBuffer* tb) {
+    memset(tb, 0, sizeof(*tb));
+    tb->seed = 2463534242u;
+    return tb_new_chunk(tb, 0) == 0 ? 0 : -1;
+}
+
+static int map_file(TextBuffer* tb, const char* path) {
+    TextChunk* c = &tb->chunks[0];
+#ifdef _WIN32
+    HANDLE file = CreateFileA(path, GENERIC_READ,
+                              FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+                              NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (file == INVALID_HANDLE_VALUE) return -1;
+
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(file, &size)) {
+        CloseHandle(file);
+        return -1;
+    }
+    tb->map_file = file;
+    if (size.QuadPart == 0) return 0;
+
+    HANDLE mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+    if (!mapping) return -1;
+    tb->map_handle = mapping;
+
+    void* view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    if (!view) return -1;
+    c->text = (char*)view;
+    c->length = (size_t)size.QuadPart;
+#else
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) return -1;
+
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        close(fd);
+        return -1;
+    }
+    if (st.st_size == 0) {
+        close(fd);
+        return 0;
+    }
+
+    void* view = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (view == MAP_FAILED) return -1;
+    madvise(view, (size_t)st.st_size, MADV_SEQUENTIAL);
+    c->text = (char*)view;
+    c->length = (size_t)st.st_size;
+#endif
+    tb->mapped = 1;
+    return 0;
+}
+
+static void unmap_file(TextBuffer* tb) {
+#ifdef _WIN32
+    if (tb->mapped) UnmapViewOfFile(tb->chunks[0].text);
+    if (tb->map_handle) CloseHandle((HANDLE)tb->map_handle);
+    if (tb->map_file) CloseHandle((HANDLE)tb->map_file);
+#else
+    if (tb->mapped) munmap(tb->chunks[0].text, tb->chunks[0].length);
+#endif
+    tb->chunks[0].text = NULL;
+    tb->mapped = 0;
+}
+
+int tb_open(TextBuffer* tb, const char* path) {
+    if (tb_init(tb) != 0) return -1;
+    if (map_file(tb, path) != 0) {
+        tb_free(tb);
+        tb_init(tb);
+        return -1;
+    }
+    tb_index_more(tb, TB_INDEX_STEP);
+    return 0;
+}
+
+int tb_is_complete(const TextBuffer* tb) {
+    return tb->pending >= tb->chunks[0].length;
+}
+
+// Indexes roughly budget more bytes of the mapped file, rounded to a line
+// end, and appends them to the document. Returns 1 while more remains.
+int tb_index_more(TextBuffer* tb, size_t budget) {
+    TextChunk* c = &tb->chunks[0];
+    size_t from = tb->pending;
+    if (from >= c->length) return 0;
+    if (budget == 0) budget = TB_INDEX_STEP;
+
+    size_t before = c->newline_count;
+    size_t end = from;
+    size_t cut = from;
+    while (cut == from) {
+        size_t next = c->length - end > budget ? end + budget : c->length;
+        if (chunk_scan_newlines(c, end, next) != 0) return -1;
+        end = next;
+        if (end == c->length) cut = end;
+        else if (c->newline_count > before) cut = c->newlines[c->newline_count - 1] + 1;
+    }
+
+    size_t lf = c->newline_count - before;
+    if (!extend_rightmost(tb->root, 0, from, cut - from, lf)) {
+        PieceNode* n = piece_create(tb, 0, from, cut - from);
+        if (!n) return -1;
+        tb->root = piece_merge(tb->root, n);
+    }
+    tb->pending = cut;
+    return cut < c->length;
+}
+
+void tb_ensure_line(TextBuffer* tb, int line) {
+    while (!tb_is_complete(tb) && tb_line_count(tb) - 1 <= line) {
+        if (tb_index_more(tb, TB_INDEX_STEP) < 0) return;
+    }
+}
+
+void tb_index_all(TextBuffer* tb) {
+    while (tb_index_more(tb, TB_INDEX_STEP) > 0) {}
+}
+
+void tb_free(TextBuffer* tb) {
+    piece_free(tb->root);
+    if (tb->chunk_count > 0) unmap_file(tb);
+    for (int i = 0; i < tb->chunk_count; i++) {
+        free(tb->chunks[i].text);
+        free(tb->chunks[i].newlines);
+    }
+    free(tb->chunks);
+    memset(tb, 0, sizeof(*tb));
+}
+
+size_t tb_length(const TextBuffer* tb) {
+    return sub_length(tb->root);
+}
+
+int tb_line_count(const TextBuffer* tb) {
+    return (int)sub_lf(tb->root) + 1;
+}
+
+size_t tb_line_start(const TextBuffer* tb, int line) {
+    if (line <= 0) return 0;
+    if ((size_t)line > sub_lf(tb->root)) return tb_length(tb);
+
+    size_t k = (size_t)line;
+    size_t base = 0;
+    const PieceNode* n = tb->root;
+    while (n) {
+        size_t left_lf = sub_lf(n->left);
+        if (k <= left_lf) {
+            n = n->left;
+            continue;
+        }
+        k -= left_lf;
+        base += sub_length(n->left);
+        if (k <= n->lf_count) {
+            const TextChunk* c = &tb->chunks[n->chunk];
+            size_t first = lower_bound(c->newlines, c->newline_count, n->start);
+            return base + (c->newlines[first + k - 1] - n->start) + 1;
+        }
+        k -= n->lf_count;
+        base += n->length;
+        n = n->right;
+    }
+    return tb_length(tb);
+}
+
+size_t tb_line_length(const TextBuffer* tb, int line) {
+    size_t start = tb_line_start(tb, line);
+    if (line + 1 >= tb_line_count(tb)) return tb_length(tb) - start;
+    return tb_line_start(tb, line + 1) - 1 - start;
+}
+
+int tb_line_of_offset(const TextBuffer* tb, size_t offset) {
+    size_t count = 0;
+    const PieceNode* n = tb->root;
+    while (n) {
+        size_t left_len = sub_length(n->left);
+        if (offset <= left_len) {
+            n = n->left;
+            continue;
+        }
+        offset -= left_len;
+        count += sub_lf(n->left);
+        if (offset <= n->length) {
+            count += chunk_newlines(&tb->chunks[n->chunk], n->start, n->start + offset);
+            break;
+        }
+        offset -= n->length;
+        count += n->lf_count;
+        n = n->right;
+    }
+    return (int)count;
+}
+
+static int piece_visit(const TextBuffer* tb, const PieceNode* n, size_t from, size_t to,
+                       TbSpanFn fn, void* ctx) {
+    if (!n || from >= to) return 0;
+
+    size_t left_len = sub_length(n->left);
+    if (from < left_len) {
+        int rc = piece_visit(tb, n->left, from, to < left_len ? to : left_len, fn, ctx);
+        if (rc) return rc;
+    }
+
+    size_t piece_end = left_len + n->length;
+    size_t s = from > left_len ? from : left_len;
+    size_t e = to < piece_end ? to : piece_end;
+    if (s < e) {
+        int rc = fn(tb->chunks[n->chunk].text + n->start + (s - left_len), e - s, ctx);
+        if (rc) return rc;
+    }
+
+    if (to > piece_end) {
+        return piece_visit(tb, n->right, from > piece_end ? from - piece_end : 0,
+                           to - piece_end, fn, ctx);
+    }
+    return 0;
+}
+
+int tb_for_each_span(const TextBuffer* tb, size_t offset, size_t length,
+                     TbSpanFn fn, void* ctx) {
+    size_t total = tb_length(tb);
+    if (offset >= total) return 0;
+    if (length > total - offset) length = total - offset;
+    return piece_visit(tb, tb->root, offset, offset + length, fn, ctx);
+}
+
+static int copy_span(const char* text, size_t length, void* ctx) {
+    char** out = (char**)ctx;
+    memcpy(*out, text, length);
+    *out += length;
+    return 0;
+}
+
+size_t tb_read(const TextBuffer* tb, size_t offset, size_t length, char* out) {
+    char* p = out;
+    tb_for_each_span(tb, offset, length, copy_span, &p);
+    return (size_t)(p - out);
+}
+
+char tb_char_at(const TextBuffer* tb, size_t offset) {
+    const PieceNode* n = tb->root;
+    while (n) {
+        size_t left_len = sub_length(n->left);
+        if (offset < left_len) {
+            n = n->left;
+        } else if (offset < left_len + n->length) {
+            return tb->chunks[n->chunk].text[n->start + offset - left_len];
+        } else {
+            offset -= left_len + n->length;
+            n = n->right;
+        }
+    }
+    return '\0';
+}
+
+size_t tb_get_line(const TextBuffer* tb, int line, char* out, size_t out_size) {
+    size_t length = tb_line_length(tb, line);
+    if (out_size == 0) return length;
+    size_t n = length < out_size - 1 ? length : out_size - 1;
+    out[tb_read(tb, tb_line_start(tb, line), n, out)] = '\0';
+    return length;
+}
+
+int tb_insert(TextBuffer* tb, size_t offset, const char* text, size_t length) {
+    if (length == 0) return 0;
+    if (offset > tb_length(tb)) offset = tb_length(tb);
+
+    int chunk;
+    size_t start;
+    if (tb_append(tb, text, length, &chunk, &start) != 0) return -1;
+
+    PieceNode *l, *r;
+    if (piece_split(tb, tb->root, offset, &l, &r) != 0) {
+        tb->root = piece_merge(l, r);
+        return -1;
+    }
+
+    size_t lf = chunk_newlines(&tb->chunks[chunk], start, start + length);
+    if (!extend_rightmost(l, chunk, start, length, lf)) {
+        PieceNode* n = piece_create(tb, chunk, start, length);
+        if (!n) {
+            tb->root = piece_merge(l, r);
+            return -1;
+        }
+        l = piece_merge(l, n);
+    }
+    tb->root = piece_merge(l, r);
+    return 0;
+}
+
+void tb_delete(TextBuffer* tb, size_t offset, size_t length) {
+    size_t total = tb_length(tb);
+    if (offset >= total || length == 0) return;
+    if (length > total - offset) length = total - offset;
+
+    PieceNode *l, *m, *r;
+    piece_split(tb, tb->root, offset, &l, &r);
+    piece_split(tb, r, length, &m, &r);
+    piece_free(m);
+    tb->root = piece_merge(l, r);
+}
+
+static int write_span(const char* text, size_t length, void* ctx) {
+    return fwrite(text, 1, length, (FILE*)ctx) == length ? 0 : -1;
+}
+
+int tb_write(const TextBuffer* tb, FILE* f) {
+    return tb_for_each_span(tb, 0, tb_length(tb), write_span, f);
+}
@@ -0,0 +1,79 @@
+#ifndef TEXT_BUFFER_H
+#define TEXT_BUFFER_H
+
+#include <stddef.h>
+#include <stdio.h>
+
+#define TB_CHUNK_SIZE 65536
+#define TB_INDEX_STEP (4 * 1024 * 1024)
+
+// Piece table whose pieces live in a treap ordered by document position.
+// Every node carries the byte length and newline count of its subtree, so
+// offset and line lookups, inserts and deletes are all O(log pieces).
+
+typedef struct PieceNode {
+    struct PieceNode* left;
+    struct PieceNode* right;
+    unsigned int priority;
+    int chunk;
+    size_t start;
+    size_t length;
+    size_t lf_count;
+    size_t sub_length;
+    size_t sub_lf;
+} PieceNode;
+
+// Chunk 0 is the read-only original text, later chunks are append-only add
+// buffers. Chunk text is never moved once allocated. An opened file is
+// mapped as chunk 0 and its newlines are indexed on demand, so until
+// tb_is_complete() the buffer only holds the indexed prefix of the file.
+typedef struct {
+    char* text;
+    size_t length;
+    size_t capacity;
+    size_t* newlines;
+    size_t newline_count;
+    size_t newline_capacity;
+} TextChunk;
+
+typedef struct {
+    TextChunk* chunks;
+    int chunk_count;
+    int chunk_capacity;
+    PieceNode* root;
+    unsigned int seed;
+    size_t pending;
+    int mapped;
+    void* map_file;
+    void* map_handle;
+} TextBuffer;
+
+typedef int (*TbSpanFn)(const char* text, size_t length, void* ctx);
+
+int tb_init(TextBuffer* tb);
+int tb_open(TextBuffer* tb, const char* path);
+void tb_free(TextBuffer* tb);
+
+int tb_is_complete(const TextBuffer* tb);
+int tb_index_more(TextBuffer* tb, size_t budget);
+void tb_ensure_line(TextBuffer* tb, int line);
+void tb_index_all(TextBuffer* tb);
+
+size_t tb_length(const TextBuffer* tb);
+int tb_line_count(const TextBuffer* tb);
+size_t tb_line_start(const TextBuffer* tb, int line);
+size_t tb_line_length(const TextBuffer* tb, int line);
+int tb_line_of_offset(const TextBuffer* tb, size_t offset);
+
+char tb_char_at(const TextBuffer* tb, size_t offset);
+size_t tb_read(const TextBuffer* tb, size_t offset, size_t length, char* out);
+size_t tb_get_line(const TextBuffer* tb, int line, char* out, size_t out_size);
+int tb_for_each_span(const TextBuffer* tb, size_t offset, size_t length,
+                     TbSpanFn fn, void* ctx);
+
+int tb_insert(TextBuffer* tb, size_t offset, const char* text, size_t length);
+void tb_delete(TextBuffer* tb, size_t offset, size_t length);
+
+int tb_write(const TextBuffer* tb, FILE* f);
+
+#endif
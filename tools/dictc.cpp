@@ -0,0 +1,74 @@
+// Compiles word lists into a completion dictionary for the editor's --dict
+// option.
+//
+//   g++ -O2 -I.. dictc.cpp ../trie.cpp -o dictc
+//   ./dictc out.dict words.txt [more.txt ...]
+//
+// Lists have one word per line. A tab and a number after the word ranks it
+// above words with a lower number; blank lines are skipped.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "trie.h"
+
+static int add_list(Trie* trie, const char* path, unsigned int* count) {
+    FILE* f = fopen(path, "rb");
+    if (!f) {
+        fprintf(stderr, "dictc: cannot open %s\n", path);
+        return -1;
+    }
+    char line[4096];
+    int number = 0;
+    while (fgets(line, sizeof(line), f)) {
+        number++;
+        size_t length = strcspn(line, "\r\n");
+        if (line[length] == '\0' && !feof(f)) {
+            fprintf(stderr, "dictc: %s:%d: line too long\n", path, number);
+            fclose(f);
+            return -1;
+        }
+        line[length] = '\0';
+        if (length == 0) continue;
+
+        unsigned int priority = 0;
+        char* tab = strchr(line, '\t');
+        if (tab) {
+            *tab = '\0';
+            priority = (unsigned int)strtoul(tab + 1, NULL, 10);
+        }
+        if (line[0] == '\0') continue;
+        trie_insert_weighted(trie, line, priority);
+        (*count)++;
+    }
+    fclose(f);
+    return 0;
+}
+
+int main(int argc, char** argv) {
+    if (argc < 3) {
+        fprintf(stderr, "usage: dictc out.dict words.txt [more.txt ...]\n");
+        return 2;
+    }
+    Trie* trie = create_trie();
+    if (!trie) return 1;
+
+    unsigned int count = 0;
+    for (int i = 2; i < argc; i++) {
+        if (add_list(trie, argv[i], &count) != 0) {
+            free_trie(trie);
+            return 1;
+        }
+    }
+
+    if (trie_save(trie, argv[1]) != 0) {
+        fprintf(stderr, "dictc: cannot write %s\n", argv[1]);
+        free_trie(trie);
+        return 1;
+    }
+    printf("%s: %u lines, %u words, %u nodes\n", argv[1], count, trie->entry_count,
+           trie->node_count);
+    free_trie(trie);
+    return 0;
+}
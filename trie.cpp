@@ -0,0 +1,719 @@
+#include "trie.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#define TRIE_MAX_LABEL 0xFFFF
+#define TRIE_MAX_DEPTH 4096
+#define TRIE_FILE_ALIGN 64
+
+enum {
+    SECTION_NODES,
+    SECTION_LABELS,
+    SECTION_CHILDREN,
+    SECTION_BEST,
+    SECTION_ENTRIES,
+    SECTION_WORDS,
+    SECTION_COUNT
+};
+
+// header_checksum covers the header with that field zeroed; body_checksum
+// covers the rest of the file.
+typedef struct {
+    unsigned int magic;
+    unsigned int version;
+    unsigned int header_checksum;
+    unsigned int clock;
+    unsigned long long body_checksum;
+    unsigned long long file_size;
+    unsigned int lengths[SECTION_COUNT];
+    unsigned long long offsets[SECTION_COUNT];
+} TrieFileHeader;
+
+static int grow(void** data, unsigned int* capacity, unsigned int needed, size_t elem) {
+    if (needed <= *capacity) return 0;
+    unsigned int cap = *capacity ? *capacity : 64;
+    while (cap < needed) cap *= 2;
+    void* grown = realloc(*data, (size_t)cap * elem);
+    if (!grown) return -1;
+    *data = grown;
+    *capacity = cap;
+    return 0;
+}
+
+// Child and best lists are sized to the next power of two of their length, so
+// a list is full exactly when its length is zero or a power of two.
+static int list_full(unsigned int count) {
+    return (count & (count - 1)) == 0;
+}
+
+// Grows a list by moving it to the end of its arena; the old run is
+// abandoned, which bounds waste to the live size.
+static int list_grow(unsigned int** arena, unsigned int* length, unsigned int* capacity,
+                     unsigned int* list, unsigned int count) {
+    unsigned int cap = count ? count * 2 : 1;
+    if (grow((void**)arena, capacity, *length + cap, sizeof(unsigned int)) != 0) return -1;
+    memcpy(*arena + *length, *arena + *list, count * sizeof(unsigned int));
+    *list = *length;
+    *length += cap;
+    return 0;
+}
+
+static int new_node(Trie* t, unsigned int label, unsigned int label_len) {
+    if (grow((void**)&t->nodes, &t->node_capacity, t->node_count + 1, sizeof(TrieNode)) != 0) {
+        return -1;
+    }
+    TrieNode* n = &t->nodes[t->node_count];
+    memset(n, 0, sizeof(*n));
+    n->label = label;
+    n->label_len = (unsigned short)label_len;
+    n->first = label_len ? (unsigned char)t->labels[label] : 0;
+    n->entry = TRIE_NO_ENTRY;
+    return (int)t->node_count++;
+}
+
+static int find_child(const Trie* t, const TrieNode* n, unsigned char c, unsigned int* slot) {
+    const unsigned int* kids = t->child_slots + n->children;
+    unsigned int lo = 0, hi = n->child_count;
+    while (lo < hi) {
+        unsigned int mid = (lo + hi) / 2;
+        unsigned char f = t->nodes[kids[mid]].first;
+        if (f == c) {
+            *slot = mid;
+            return (int)kids[mid];
+        }
+        if (f < c) lo = mid + 1;
+        else hi = mid;
+    }
+    *slot = lo;
+    return -1;
+}
+
+static int add_child(Trie* t, unsigned int parent, unsigned int slot, unsigned int child) {
+    TrieNode* p = &t->nodes[parent];
+    if (list_full(p->child_count) &&
+        list_grow(&t->child_slots, &t->child_length, &t->child_capacity,
+                  &p->children, p->child_count) != 0) {
+        return -1;
+    }
+
+    unsigned int* kids = t->child_slots + p->children;
+    memmove(kids + slot + 1, kids + slot, (p->child_count - slot) * sizeof(unsigned int));
+    kids[slot] = child;
+    p->child_count++;
+    return 0;
+}
+
+static unsigned long long entry_score(const TrieEntry* e) {
+    return e->priority * TRIE_PRIORITY_WEIGHT + e->uses * TRIE_USE_WEIGHT + e->last_used;
+}
+
+static int ranks_before(const Trie* t, unsigned int a, unsigned int b) {
+    const TrieEntry* ea = &t->entries[a];
+    const TrieEntry* eb = &t->entries[b];
+    if (ea->score != eb->score) return ea->score > eb->score;
+    return strcmp(t->words + ea->word, t->words + eb->word) < 0;
+}
+
+// Scores only ever rise, so a word can enter or climb a node's list but never
+// needs to be demoted below words it was not compared against.
+static int offer(Trie* t, unsigned int node, unsigned int entry) {
+    TrieNode* n = &t->nodes[node];
+    unsigned int* best = t->best_slots + n->best;
+    int pos = -1;
+    for (int i = 0; i < n->best_count; i++) {
+        if (best[i] == entry) {
+            pos = i;
+            break;
+        }
+    }
+
+    if (pos < 0) {
+        if (n->best_count < TRIE_TOP_K) {
+            if (list_full(n->best_count) &&
+                list_grow(&t->best_slots, &t->best_length, &t->best_capacity,
+                          &n->best, n->best_count) != 0) {
+                return -1;
+            }
+            best = t->best_slots + n->best;
+            pos = n->best_count++;
+        } else if (ranks_before(t, entry, best[TRIE_TOP_K - 1])) {
+            pos = TRIE_TOP_K - 1;
+        } else {
+            return 0;
+        }
+        best[pos] = entry;
+    }
+
+    while (pos > 0 && ranks_before(t, entry, best[pos - 1])) {
+        best[pos] = best[pos - 1];
+        best[--pos] = entry;
+    }
+    return 0;
+}
+
+static int copy_best(Trie* t, unsigned int dst, unsigned int src) {
+    unsigned int count = t->nodes[src].best_count;
+    unsigned int cap = 1;
+    while (cap < count) cap *= 2;
+    if (grow((void**)&t->best_slots, &t->best_capacity, t->best_length + cap,
+             sizeof(unsigned int)) != 0) {
+        return -1;
+    }
+    memcpy(t->best_slots + t->best_length, t->best_slots + t->nodes[src].best,
+           count * sizeof(unsigned int));
+    t->nodes[dst].best = t->best_length;
+    t->nodes[dst].best_count = (unsigned char)count;
+    t->best_length += cap;
+    return 0;
+}
+
+static int new_entry(Trie* t, const char* key, size_t len) {
+    if (grow((void**)&t->entries, &t->entry_capacity, t->entry_count + 1, sizeof(TrieEntry)) != 0 ||
+        grow((void**)&t->words, &t->word_capacity, t->word_length + (unsigned int)len + 1, 1) != 0) {
+        return -1;
+    }
+    TrieEntry* e = &t->entries[t->entry_count];
+    memset(e, 0, sizeof(*e));
+    e->word = t->word_length;
+    memcpy(t->words + t->word_length, key, len + 1);
+    t->word_length += (unsigned int)len + 1;
+    return (int)t->entry_count++;
+}
+
+// Walks key from the root, filling path with every node visited. Returns the
+// path length, or 0 when key is not stored as a word.
+static int find_path(const Trie* t, const char* key, unsigned int* path) {
+    unsigned int node = 0;
+    int depth = 0;
+    size_t i = 0;
+    path[depth++] = 0;
+    while (key[i]) {
+        unsigned int slot;
+        int child = find_child(t, &t->nodes[node], (unsigned char)key[i], &slot);
+        if (child < 0 || depth >= TRIE_MAX_DEPTH) return 0;
+        const TrieNode* c = &t->nodes[child];
+        if (strncmp(t->labels + c->label, key + i, c->label_len) != 0) return 0;
+        i += c->label_len;
+        node = child;
+        path[depth++] = node;
+    }
+    return t->nodes[node].entry == TRIE_NO_ENTRY ? 0 : depth;
+}
+
+Trie* create_trie() {
+    Trie* t = (Trie*)calloc(1, sizeof(Trie));
+    if (!t) return NULL;
+    if (new_node(t, 0, 0) != 0) {
+        free(t);
+        return NULL;
+    }
+    return t;
+}
+
+static void unmap_view(void* view, size_t size) {
+#ifdef _WIN32
+    (void)size;
+    UnmapViewOfFile(view);
+#else
+    munmap(view, size);
+#endif
+}
+
+void free_trie(Trie* trie) {
+    if (!trie) return;
+    if (trie->mapping) {
+        unmap_view(trie->mapping, trie->mapping_size);
+        free(trie);
+        return;
+    }
+    free(trie->nodes);
+    free(trie->labels);
+    free(trie->child_slots);
+    free(trie->best_slots);
+    free(trie->entries);
+    free(trie->words);
+    free(trie);
+}
+
+void trie_insert(Trie* trie, const char* key) {
+    trie_insert_weighted(trie, key, 0);
+}
+
+void trie_insert_weighted(Trie* trie, const char* key, unsigned int priority) {
+    if (!trie || !key || !key[0] || trie->mapping) return;
+
+    size_t key_len = strlen(key);
+    if (key_len >= TRIE_MAX_DEPTH) return;
+
+    unsigned int path[TRIE_MAX_DEPTH];
+    int depth = 0;
+    unsigned int node = 0;
+    size_t i = 0;
+    path[depth++] = 0;
+
+    while (key[i]) {
+        unsigned int slot;
+        int child = find_child(trie, &trie->nodes[node], (unsigned char)key[i], &slot);
+
+        if (child < 0) {
+            size_t rest = key_len - i;
+            unsigned int len = rest > TRIE_MAX_LABEL ? TRIE_MAX_LABEL : (unsigned int)rest;
+            if (grow((void**)&trie->labels, &trie->label_capacity, trie->label_length + len, 1) != 0) {
+                return;
+            }
+            memcpy(trie->labels + trie->label_length, key + i, len);
+            int leaf = new_node(trie, trie->label_length, len);
+            if (leaf < 0) return;
+            trie->label_length += len;
+            if (add_child(trie, node, slot, leaf) != 0) return;
+            node = leaf;
+            path[depth++] = node;
+            i += len;
+            continue;
+        }
+
+        TrieNode* c = &trie->nodes[child];
+        const char* label = trie->labels + c->label;
+        unsigned int j = 0;
+        while (j < c->label_len && key[i + j] == label[j]) j++;
+
+        if (j < c->label_len) {
+            int mid = new_node(trie, c->label, j);
+            if (mid < 0 || copy_best(trie, mid, child) != 0) return;
+            c = &trie->nodes[child];
+            c->label += j;
+            c->label_len -= j;
+            c->first = (unsigned char)trie->labels[c->label];
+            trie->child_slots[trie->nodes[node].children + slot] = mid;
+            if (add_child(trie, mid, 0, child) != 0) return;
+            child = mid;
+        }
+
+        node = child;
+        path[depth++] = node;
+        i += j;
+    }
+
+    unsigned int entry = trie->nodes[node].entry;
+    if (entry == TRIE_NO_ENTRY) {
+        int e = new_entry(trie, key, key_len);
+        if (e < 0) return;
+        entry = (unsigned int)e;
+        trie->nodes[node].entry = entry;
+    } else if (trie->entries[entry].priority >= priority) {
+        return;
+    }
+
+    trie->entries[entry].priority = priority;
+    trie->entries[entry].score = entry_score(&trie->entries[entry]);
+    for (int d = 0; d < depth; d++) offer(trie, path[d], entry);
+}
+
+void trie_touch(Trie* trie, const char* word) {
+    if (!trie || !word || strlen(word) >= TRIE_MAX_DEPTH) return;
+
+    unsigned int path[TRIE_MAX_DEPTH];
+    int depth = find_path(trie, word, path);
+    if (depth == 0) return;
+
+    unsigned int entry = trie->nodes[path[depth - 1]].entry;
+    TrieEntry* e = &trie->entries[entry];
+    e->uses++;
+    e->last_used = ++trie->clock;
+    e->score = entry_score(e);
+    for (int d = 0; d < depth; d++) offer(trie, path[d], entry);
+}
+
+// Inserts entry into the sorted list top if it ranks among its first
+// TRIE_TOP_K words.
+static void rank_into(const Trie* t, unsigned int* top, int* count, unsigned int entry) {
+    int pos = *count;
+    if (pos == TRIE_TOP_K) {
+        if (!ranks_before(t, entry, top[TRIE_TOP_K - 1])) return;
+        pos--;
+    } else {
+        (*count)++;
+    }
+    while (pos > 0 && ranks_before(t, entry, top[pos - 1])) {
+        top[pos] = top[pos - 1];
+        pos--;
+    }
+    top[pos] = entry;
+}
+
+// A node's ranked list is the best of its own word and its children's lists.
+// The result never outgrows the list it replaces, so it is written in place.
+static void rebuild_best(Trie* t, unsigned int node) {
+    TrieNode* n = &t->nodes[node];
+    unsigned int top[TRIE_TOP_K];
+    int count = 0;
+
+    if (n->entry != TRIE_NO_ENTRY) rank_into(t, top, &count, n->entry);
+    const unsigned int* kids = t->child_slots + n->children;
+    for (int i = 0; i < n->child_count; i++) {
+        const TrieNode* c = &t->nodes[kids[i]];
+        const unsigned int* best = t->best_slots + c->best;
+        for (int j = 0; j < c->best_count; j++) rank_into(t, top, &count, best[j]);
+    }
+
+    memcpy(t->best_slots + n->best, top, count * sizeof(unsigned int));
+    n->best_count = (unsigned char)count;
+}
+
+static int best_contains(const Trie* t, unsigned int node, unsigned int entry) {
+    const TrieNode* n = &t->nodes[node];
+    const unsigned int* best = t->best_slots + n->best;
+    for (int i = 0; i < n->best_count; i++) {
+        if (best[i] == entry) return 1;
+    }
+    return 0;
+}
+
+void trie_remove(Trie* trie, const char* word) {
+    if (!trie || !word || trie->mapping || strlen(word) >= TRIE_MAX_DEPTH) return;
+
+    unsigned int path[TRIE_MAX_DEPTH];
+    int depth = find_path(trie, word, path);
+    if (depth == 0) return;
+
+    unsigned int entry = trie->nodes[path[depth - 1]].entry;
+    trie->nodes[path[depth - 1]].entry = TRIE_NO_ENTRY;
+
+    // A list can only hold the word if the list below it on the path did.
+    for (int d = depth - 1; d >= 0 && best_contains(trie, path[d], entry); d--) {
+        rebuild_best(trie, path[d]);
+    }
+}
+
+static int clone_array(void** dst, unsigned int* capacity, const void* src,
+                       unsigned int length, size_t elem) {
+    *capacity = 0;
+    *dst = NULL;
+    if (length == 0) return 0;
+    *dst = malloc((size_t)length * elem);
+    if (!*dst) return -1;
+    memcpy(*dst, src, (size_t)length * elem);
+    *capacity = length;
+    return 0;
+}
+
+Trie* trie_clone(const Trie* trie) {
+    if (!trie) return NULL;
+    Trie* t = (Trie*)malloc(sizeof(Trie));
+    if (!t) return NULL;
+    *t = *trie;
+    t->mapping = NULL;
+    t->mapping_size = 0;
+
+    int failed = 0;
+    failed |= clone_array((void**)&t->nodes, &t->node_capacity, trie->nodes,
+                          trie->node_count, sizeof(TrieNode));
+    failed |= clone_array((void**)&t->labels, &t->label_capacity, trie->labels,
+                          trie->label_length, 1);
+    failed |= clone_array((void**)&t->child_slots, &t->child_capacity, trie->child_slots,
+                          trie->child_length, sizeof(unsigned int));
+    failed |= clone_array((void**)&t->best_slots, &t->best_capacity, trie->best_slots,
+                          trie->best_length, sizeof(unsigned int));
+    failed |= clone_array((void**)&t->entries, &t->entry_capacity, trie->entries,
+                          trie->entry_count, sizeof(TrieEntry));
+    failed |= clone_array((void**)&t->words, &t->word_capacity, trie->words,
+                          trie->word_length, 1);
+    if (failed) {
+        free_trie(t);
+        return NULL;
+    }
+    return t;
+}
+
+int trie_complete(const Trie* trie, const char* prefix, TrieWordFn fn, void* ctx) {
+    if (!trie || !prefix) return 0;
+
+    size_t plen = strlen(prefix);
+    size_t len = 0;
+    unsigned int node = 0;
+
+    while (len < plen) {
+        unsigned int slot;
+        int child = find_child(trie, &trie->nodes[node], (unsigned char)prefix[len], &slot);
+        if (child < 0) return 0;
+
+        const TrieNode* c = &trie->nodes[child];
+        const char* label = trie->labels + c->label;
+        unsigned int j = 0;
+        while (j < c->label_len && len + j < plen && prefix[len + j] == label[j]) j++;
+        if (j < c->label_len && len + j < plen) return 0;
+
+        len += c->label_len;
+        node = child;
+    }
+
+    const TrieNode* n = &trie->nodes[node];
+    const unsigned int* best = trie->best_slots + n->best;
+    int count = 0;
+    for (int i = 0; i < n->best_count; i++) {
+        count++;
+        if (fn(trie->words + trie->entries[best[i]].word, ctx)) break;
+    }
+    return count;
+}
+
+void trie_cursor_reset(TrieCursor* cursor, const Trie* trie) {
+    cursor->trie = trie;
+    cursor->depth = 0;
+    cursor->dead = 0;
+}
+
+void trie_cursor_push(TrieCursor* cursor, char c) {
+    const Trie* t = cursor->trie;
+    if (!t || cursor->dead || cursor->depth >= TRIE_CURSOR_DEPTH) {
+        cursor->dead++;
+        return;
+    }
+
+    unsigned int node = cursor->depth ? cursor->nodes[cursor->depth - 1] : 0;
+    unsigned int offset = cursor->depth ? cursor->offsets[cursor->depth - 1] : 0;
+    const TrieNode* n = &t->nodes[node];
+
+    if (offset < n->label_len) {
+        if (t->labels[n->label + offset] != c) {
+            cursor->dead++;
+            return;
+        }
+        offset++;
+    } else {
+        unsigned int slot;
+        int child = find_child(t, n, (unsigned char)c, &slot);
+        if (child < 0) {
+            cursor->dead++;
+            return;
+        }
+        node = (unsigned int)child;
+        offset = 1;
+    }
+
+    cursor->nodes[cursor->depth] = node;
+    cursor->offsets[cursor->depth] = (unsigned short)offset;
+    cursor->depth++;
+}
+
+void trie_cursor_pop(TrieCursor* cursor) {
+    if (cursor->dead > 0) cursor->dead--;
+    else if (cursor->depth > 0) cursor->depth--;
+}
+
+int trie_cursor_length(const TrieCursor* cursor) {
+    return cursor->depth + cursor->dead;
+}
+
+int trie_cursor_suggest(const TrieCursor* cursor, const char** out, int max) {
+    const Trie* t = cursor->trie;
+    if (!t || cursor->dead) return 0;
+
+    const TrieNode* n = &t->nodes[cursor->depth ? cursor->nodes[cursor->depth - 1] : 0];
+    const unsigned int* best = t->best_slots + n->best;
+    int count = n->best_count < max ? n->best_count : max;
+    for (int i = 0; i < count; i++) {
+        out[i] = t->words + t->entries[best[i]].word;
+    }
+    return count;
+}
+
+size_t trie_memory(const Trie* trie) {
+    if (!trie) return 0;
+    return sizeof(Trie) +
+           (size_t)trie->node_capacity * sizeof(TrieNode) +
+           trie->label_capacity +
+           (size_t)trie->child_capacity * sizeof(unsigned int) +
+           (size_t)trie->best_capacity * sizeof(unsigned int) +
+           (size_t)trie->entry_capacity * sizeof(TrieEntry) +
+           trie->word_capacity;
+}
+
+static unsigned int fnv1a(const void* data, size_t length) {
+    const unsigned char* p = (const unsigned char*)data;
+    unsigned int h = 2166136261u;
+    for (size_t i = 0; i < length; i++) {
+        h ^= p[i];
+        h *= 16777619u;
+    }
+    return h;
+}
+
+// Four independent multiply-rotate lanes over 8-byte words, so the body of
+// a large dictionary is checked near memory speed.
+static unsigned long long body_hash(const char* data, size_t length) {
+    const unsigned long long prime = 0x9E3779B185EBCA87ull;
+    unsigned long long lanes[4] = {1, 2, 3, 4};
+    size_t i = 0;
+    for (; i + 32 <= length; i += 32) {
+        for (int k = 0; k < 4; k++) {
+            unsigned long long w;
+            memcpy(&w, data + i + k * 8, 8);
+            lanes[k] = (lanes[k] ^ w) * prime;
+            lanes[k] = (lanes[k] << 31) | (lanes[k] >> 33);
+        }
+    }
+    unsigned long long h = length;
+    for (int k = 0; k < 4; k++) h = (h ^ lanes[k]) * prime;
+    for (; i < length; i++) h = (h ^ (unsigned char)data[i]) * prime;
+    return h ^ (h >> 29);
+}
+
+static unsigned int header_checksum(const TrieFileHeader* h) {
+    TrieFileHeader copy = *h;
+    copy.header_checksum = 0;
+    return fnv1a(&copy, sizeof(copy));
+}
+
+static size_t align_up(size_t n) {
+    return (n + TRIE_FILE_ALIGN - 1) & ~(size_t)(TRIE_FILE_ALIGN - 1);
+}
+
+static const size_t section_elem[SECTION_COUNT] = {
+    sizeof(TrieNode), 1, sizeof(unsigned int), sizeof(unsigned int), sizeof(TrieEntry), 1
+};
+
+static void section_data(const Trie* t, const void** data, unsigned int* lengths) {
+    data[SECTION_NODES] = t->nodes;
+    data[SECTION_LABELS] = t->labels;
+    data[SECTION_CHILDREN] = t->child_slots;
+    data[SECTION_BEST] = t->best_slots;
+    data[SECTION_ENTRIES] = t->entries;
+    data[SECTION_WORDS] = t->words;
+    lengths[SECTION_NODES] = t->node_count;
+    lengths[SECTION_LABELS] = t->label_length;
+    lengths[SECTION_CHILDREN] = t->child_length;
+    lengths[SECTION_BEST] = t->best_length;
+    lengths[SECTION_ENTRIES] = t->entry_count;
+    lengths[SECTION_WORDS] = t->word_length;
+}
+
+// Sections follow the header in order, each starting on a TRIE_FILE_ALIGN
+// boundary. The file is assembled in memory so the checksum covers the
+// zeroed padding as well.
+int trie_save(const Trie* trie, const char* path) {
+    if (!trie) return -1;
+    TrieFileHeader h;
+    memset(&h, 0, sizeof(h));
+    h.magic = TRIE_FILE_MAGIC;
+    h.version = TRIE_FILE_VERSION;
+    h.clock = trie->clock;
+
+    const void* data[SECTION_COUNT];
+    section_data(trie, data, h.lengths);
+    size_t at = align_up(sizeof(h));
+    for (int i = 0; i < SECTION_COUNT; i++) {
+        h.offsets[i] = at;
+        at = align_up(at + h.lengths[i] * section_elem[i]);
+    }
+    h.file_size = at;
+
+    char* image = (char*)calloc(1, h.file_size);
+    if (!image) return -1;
+    for (int i = 0; i < SECTION_COUNT; i++) {
+        if (h.lengths[i]) memcpy(image + h.offsets[i], data[i], h.lengths[i] * section_elem[i]);
+    }
+    h.body_checksum = body_hash(image + sizeof(h), h.file_size - sizeof(h));
+    h.header_checksum = header_checksum(&h);
+    memcpy(image, &h, sizeof(h));
+
+    FILE* f = fopen(path, "wb");
+    int ok = f && fwrite(image, 1, h.file_size, f) == h.file_size;
+    if (f && fclose(f) != 0) ok = 0;
+    free(image);
+    if (!ok) remove(path);
+    return ok ? 0 : -1;
+}
+
+static void* map_file(const char* path, size_t* size) {
+#ifdef _WIN32
+    HANDLE file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING,
+                              FILE_ATTRIBUTE_NORMAL, NULL);
+    if (file == INVALID_HANDLE_VALUE) return NULL;
+    LARGE_INTEGER length;
+    if (!GetFileSizeEx(file, &length) || length.QuadPart < (LONGLONG)sizeof(TrieFileHeader)) {
+        CloseHandle(file);
+        return NULL;
+    }
+    HANDLE mapping = CreateFileMappingA(file, NULL, PAGE_WRITECOPY, 0, 0, NULL);
+    CloseHandle(file);
+    if (!mapping) return NULL;
+    void* view = MapViewOfFile(mapping, FILE_MAP_COPY, 0, 0, 0);
+    CloseHandle(mapping);
+    if (!view) return NULL;
+    *size = (size_t)length.QuadPart;
+    return view;
+#else
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) return NULL;
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size < (off_t)sizeof(TrieFileHeader)) {
+        close(fd);
+        return NULL;
+    }
+    void* view = mmap(NULL, (size_t)st.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (view == MAP_FAILED) return NULL;
+    *size = (size_t)st.st_size;
+    return view;
+#endif
+}
+
+static int header_valid(const TrieFileHeader* h, size_t size) {
+    if (h->magic != TRIE_FILE_MAGIC || h->version != TRIE_FILE_VERSION) return 0;
+    if (h->file_size != size || h->header_checksum != header_checksum(h)) return 0;
+    if (h->lengths[SECTION_NODES] == 0) return 0;
+    for (int i = 0; i < SECTION_COUNT; i++) {
+        if (h->offsets[i] % TRIE_FILE_ALIGN != 0 || h->offsets[i] > size) return 0;
+        if (h->lengths[i] > (size - h->offsets[i]) / section_elem[i]) return 0;
+    }
+    return 1;
+}
+
+Trie* trie_map(const char* path) {
+    size_t size;
+    void* view = map_file(path, &size);
+    if (!view) return NULL;
+    const TrieFileHeader* h = (const TrieFileHeader*)view;
+    Trie* t = header_valid(h, size) ? (Trie*)calloc(1, sizeof(Trie)) : NULL;
+    if (!t) {
+        unmap_view(view, size);
+        return NULL;
+    }
+
+    char* base = (char*)view;
+    t->nodes = (TrieNode*)(base + h->offsets[SECTION_NODES]);
+    t->labels = base + h->offsets[SECTION_LABELS];
+    t->child_slots = (unsigned int*)(base + h->offsets[SECTION_CHILDREN]);
+    t->best_slots = (unsigned int*)(base + h->offsets[SECTION_BEST]);
+    t->entries = (TrieEntry*)(base + h->offsets[SECTION_ENTRIES]);
+    t->words = base + h->offsets[SECTION_WORDS];
+    t->node_count = t->node_capacity = h->lengths[SECTION_NODES];
+    t->label_length = t->label_capacity = h->lengths[SECTION_LABELS];
+    t->child_length = t->child_capacity = h->lengths[SECTION_CHILDREN];
+    t->best_length = t->best_capacity = h->lengths[SECTION_BEST];
+    t->entry_count = t->entry_capacity = h->lengths[SECTION_ENTRIES];
+    t->word_length = t->word_capacity = h->lengths[SECTION_WORDS];
+    t->clock = h->clock;
+    t->mapping = view;
+    t->mapping_size = size;
+    return t;
+}
+
+int trie_verify(const Trie* trie) {
+    if (!trie || !trie->mapping) return 0;
+    const TrieFileHeader* h = (const TrieFileHeader*)trie->mapping;
+    const char* body = (const char*)trie->mapping + sizeof(*h);
+    return body_hash(body, trie->mapping_size - sizeof(*h)) == h->body_checksum ? 0 : -1;
+}
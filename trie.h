@@ -0,0 +1,124 @@
+#ifndef TRIE_H
+#define TRIE_H
+
+#include <stddef.h>
+
+// Radix tree kept in flat arenas. Nodes refer to their label, their sorted
+// child list and their ranked completion list by index, so the whole
+// structure is pointer-free and is released with a handful of frees.
+//
+// Every node caches the TRIE_TOP_K highest-scoring words below it, which
+// makes a prefix query O(prefix length + K) regardless of subtree size.
+//
+// Because nothing in the arenas is a pointer, trie_save() writes them out
+// as they are and trie_map() maps such a file copy-on-write and points the
+// arenas into it, so loading costs the same for ten words or a million.
+
+#define TRIE_TOP_K 15
+#define TRIE_NO_ENTRY 0xFFFFFFFFu
+
+#define TRIE_CURSOR_DEPTH 512
+
+#define TRIE_FILE_MAGIC 0x45495254u
+#define TRIE_FILE_VERSION 1
+
+#define TRIE_PRIORITY_WEIGHT 4096ull
+#define TRIE_USE_WEIGHT 64ull
+
+typedef struct {
+    unsigned int label;
+    unsigned int children;
+    unsigned int best;
+    unsigned int entry;
+    unsigned short label_len;
+    unsigned short child_count;
+    unsigned char first;
+    unsigned char best_count;
+} TrieNode;
+
+typedef struct {
+    unsigned long long score;
+    unsigned int word;
+    unsigned int uses;
+    unsigned int last_used;
+    unsigned int priority;
+} TrieEntry;
+
+typedef struct {
+    TrieNode* nodes;
+    unsigned int node_count;
+    unsigned int node_capacity;
+    char* labels;
+    unsigned int label_length;
+    unsigned int label_capacity;
+    unsigned int* child_slots;
+    unsigned int child_length;
+    unsigned int child_capacity;
+    unsigned int* best_slots;
+    unsigned int best_length;
+    unsigned int best_capacity;
+    TrieEntry* entries;
+    unsigned int entry_count;
+    unsigned int entry_capacity;
+    char* words;
+    unsigned int word_length;
+    unsigned int word_capacity;
+    unsigned int clock;
+    void* mapping;
+    size_t mapping_size;
+} Trie;
+
+// Position of a prefix inside the trie, kept one entry per typed character so
+// appending a character steps one edge and deleting one pops back.
+typedef struct {
+    const Trie* trie;
+    unsigned int nodes[TRIE_CURSOR_DEPTH];
+    unsigned short offsets[TRIE_CURSOR_DEPTH];
+    int depth;
+    int dead;
+} TrieCursor;
+
+typedef int (*TrieWordFn)(const char* word, void* ctx);
+
+Trie* create_trie();
+
+// A mapped trie ignores new words and removals; trie_touch() works, its
+// changes staying in memory.
+void trie_insert(Trie* trie, const char* key);
+void trie_insert_weighted(Trie* trie, const char* key, unsigned int priority);
+void free_trie(Trie* trie);
+
+// Records that word was accepted, raising its usage and recency score.
+void trie_touch(Trie* trie, const char* word);
+
+// Drops word from the trie and refills the ranked lists that held it. Its
+// node, label and entry stay allocated, so a trie with heavy churn should be
+// rebuilt from time to time.
+void trie_remove(Trie* trie, const char* word);
+
+// Copies the trie into arenas sized to its contents.
+Trie* trie_clone(const Trie* trie);
+
+// Calls fn for the best-ranked words starting with prefix, highest score
+// first, until fn returns nonzero or TRIE_TOP_K words have been reported.
+int trie_complete(const Trie* trie, const char* prefix, TrieWordFn fn, void* ctx);
+
+void trie_cursor_reset(TrieCursor* cursor, const Trie* trie);
+void trie_cursor_push(TrieCursor* cursor, char c);
+void trie_cursor_pop(TrieCursor* cursor);
+int trie_cursor_length(const TrieCursor* cursor);
+
+// Fills out with the ranked completions of the cursor's prefix. The strings
+// stay valid until the trie gains a new word.
+int trie_cursor_suggest(const TrieCursor* cursor, const char** out, int max);
+
+size_t trie_memory(const Trie* trie);
+
+// The file has a versioned header with its own checksum and a checksum of
+// everything after it. trie_map() checks only the header, so opening never
+// reads the body; call trie_verify() before trusting the contents.
+int trie_save(const Trie* trie, const char* path);
+Trie* trie_map(const char* path);
+int trie_verify(const Trie* trie);
+
+#endif
@@ -0,0 +1,174 @@
+#include "undo.h"
+
+#include <limits.h>
+#include <stdlib.h>
+#include <string.h>
+
+static size_t record_size(size_t length) {
+    return (sizeof(UndoRecord) + length + 7) & ~(size_t)7;
+}
+
+static UndoRecord* record_at(const UndoLog* u, size_t pos) {
+    return (UndoRecord*)(u->arena + pos);
+}
+
+static char* record_text(UndoRecord* r) {
+    return (char*)(r + 1);
+}
+
+int undo_init(UndoLog* u, size_t budget) {
+    memset(u, 0, sizeof(*u));
+    u->budget = budget;
+    return 0;
+}
+
+void undo_free(UndoLog* u) {
+    free(u->arena);
+    memset(u, 0, sizeof(*u));
+}
+
+static int reserve(UndoLog* u, size_t size) {
+    if (size <= u->capacity) return 0;
+    size_t cap = u->capacity ? u->capacity : 4096;
+    while (cap < size) cap *= 2;
+    if (cap > u->budget) cap = u->budget;
+    char* grown = (char*)realloc(u->arena, cap);
+    if (!grown) return -1;
+    u->arena = grown;
+    u->capacity = cap;
+    return 0;
+}
+
+static void clear(UndoLog* u) {
+    u->end = u->top = u->last_size = 0;
+}
+
+// Drops whole steps from the front until need more bytes fit. Going down to
+// three quarters of the budget keeps the memmove rare.
+static void trim(UndoLog* u, size_t need) {
+    size_t target = u->budget - need;
+    if (target > u->budget - u->budget / 4) target = u->budget - u->budget / 4;
+
+    size_t drop = 0;
+    while (drop < u->end && u->end - drop > target) {
+        drop += record_size(record_at(u, drop)->length);
+        while (drop < u->end && record_at(u, drop)->joined) {
+            drop += record_size(record_at(u, drop)->length);
+        }
+    }
+    if (drop == 0) return;
+
+    memmove(u->arena, u->arena + drop, u->end - drop);
+    u->end -= drop;
+    u->top = u->end;
+    if (u->end == 0) u->last_size = 0;
+    else record_at(u, 0)->prev_size = 0;
+}
+
+// Extends the last record when the edit continues it: typing right after
+// it, backspacing just before it or deleting forward at its offset.
+static int try_merge(UndoLog* u, int type, size_t offset, const char* text, size_t length) {
+    if (u->sealed || u->grouping || u->end == 0) return 0;
+    if (memchr(text, '\n', length)) return 0;
+
+    size_t pos = u->end - u->last_size;
+    UndoRecord* r = record_at(u, pos);
+    if (!r->mergeable || r->type != type || r->length + length > UNDO_MERGE_MAX) return 0;
+
+    int append;
+    if (type == UNDO_INSERT && offset == r->offset + r->length) append = 1;
+    else if (type == UNDO_DELETE && offset == r->offset) append = 1;
+    else if (type == UNDO_DELETE && offset + length == r->offset) append = 0;
+    else return 0;
+
+    size_t size = record_size(r->length + length);
+    if (pos + size > u->budget || reserve(u, pos + size) != 0) return 0;
+    r = record_at(u, pos);
+    char* t = record_text(r);
+    if (append) {
+        memcpy(t + r->length, text, length);
+    } else {
+        memmove(t + length, t, r->length);
+        memcpy(t, text, length);
+        r->offset = offset;
+    }
+    r->length += (unsigned int)length;
+    u->last_size = size;
+    u->end = u->top = pos + size;
+    return 1;
+}
+
+void undo_record(UndoLog* u, int type, size_t offset, const char* text, size_t length) {
+    if (length == 0) return;
+    u->top = u->end;
+    if (try_merge(u, type, offset, text, length)) return;
+
+    // An edit too big to keep also cuts off everything before it.
+    size_t size = record_size(length);
+    if (length > UINT_MAX || size > u->budget) {
+        clear(u);
+        return;
+    }
+    if (u->end + size > u->budget) trim(u, size);
+    if (reserve(u, u->end + size) != 0) {
+        clear(u);
+        return;
+    }
+
+    UndoRecord* r = record_at(u, u->end);
+    r->offset = offset;
+    r->length = (unsigned int)length;
+    r->prev_size = (unsigned int)u->last_size;
+    r->type = (unsigned char)type;
+    r->joined = u->grouping && u->group_started;
+    r->mergeable = !u->grouping && !memchr(text, '\n', length);
+    memcpy(record_text(r), text, length);
+
+    u->group_started = u->grouping;
+    u->last_size = size;
+    u->end = u->top = u->end + size;
+    u->sealed = u->grouping;
+}
+
+void undo_seal(UndoLog* u) {
+    u->sealed = 1;
+}
+
+void undo_begin(UndoLog* u) {
+    u->grouping = 1;
+    u->group_started = 0;
+}
+
+void undo_end(UndoLog* u) {
+    u->grouping = 0;
+    u->sealed = 1;
+}
+
+int undo_undo(UndoLog* u, UndoApplyFn apply, void* ctx) {
+    if (u->end == 0) return 0;
+    int joined;
+    do {
+        size_t pos = u->end - u->last_size;
+        UndoRecord* r = record_at(u, pos);
+        joined = r->joined;
+        apply(r->type == UNDO_INSERT ? UNDO_DELETE : UNDO_INSERT,
+              r->offset, record_text(r), r->length, ctx);
+        u->end = pos;
+        u->last_size = r->prev_size;
+    } while (joined && u->end > 0);
+    u->sealed = 1;
+    return 1;
+}
+
+int undo_redo(UndoLog* u, UndoApplyFn apply, void* ctx) {
+    if (u->end == u->top) return 0;
+    do {
+        UndoRecord* r = record_at(u, u->end);
+        size_t size = record_size(r->length);
+        apply(r->type, r->offset, record_text(r), r->length, ctx);
+        u->last_size = size;
+        u->end += size;
+    } while (u->end < u->top && record_at(u, u->end)->joined);
+    u->sealed = 1;
+    return 1;
+}
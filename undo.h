@@ -0,0 +1,62 @@
+#ifndef UNDO_H
+#define UNDO_H
+
+#include <stddef.h>
+
+// Undo and redo as a log of primitive edits. Each record is an insert or a
+// delete together with its text, packed back to back in one arena and
+// linked to its predecessor by size, so stepping in either direction costs
+// as much as the edit itself. Consecutive typing and backspacing extend the
+// last record instead of adding one. When the arena would outgrow its
+// budget the oldest steps are dropped.
+
+#define UNDO_MERGE_MAX 1024
+
+enum {
+    UNDO_INSERT,
+    UNDO_DELETE
+};
+
+typedef struct {
+    size_t offset;
+    unsigned int length;
+    unsigned int prev_size;
+    unsigned char type;
+    unsigned char joined;
+    unsigned char mergeable;
+} UndoRecord;
+
+typedef struct {
+    char* arena;
+    size_t capacity;
+    size_t budget;
+    size_t end;
+    size_t top;
+    size_t last_size;
+    int sealed;
+    int grouping;
+    int group_started;
+} UndoLog;
+
+// Called with the edit to apply: the inverse of each record when undoing,
+// the record itself when redoing.
+typedef void (*UndoApplyFn)(int type, size_t offset, const char* text, size_t length, void* ctx);
+
+int undo_init(UndoLog* u, size_t budget);
+void undo_free(UndoLog* u);
+
+// Records an edit about to be made. Discards everything that could be redone.
+void undo_record(UndoLog* u, int type, size_t offset, const char* text, size_t length);
+
+// Stops the next edit from merging into the last record.
+void undo_seal(UndoLog* u);
+
+// Edits recorded between undo_begin() and undo_end() form a single step.
+void undo_begin(UndoLog* u);
+void undo_end(UndoLog* u);
+
+// Return 1 when a step was applied, 0 when there was none.
+int undo_undo(UndoLog* u, UndoApplyFn apply, void* ctx);
+int undo_redo(UndoLog* u, UndoApplyFn apply, void* ctx);
+
+#endif